@@ -0,0 +1,184 @@
+// Times the number parsing of the OBJ loader on real files: the fast path
+// (tryParseRealFast, which tries Clinger's exact fast path and falls back
+// to std::from_chars, straight to float; direct index scanning) against the
+// original one (tryParseDouble then narrowing, atoi plus strcspn).
+//
+// Usage: A1_parsebench <mesh.obj> [more.obj ...]
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "tiny_obj_loader.h"
+
+using namespace std;
+
+namespace {
+
+struct Token {
+	const char *begin, *end;
+};
+
+// The index parsing the loader used before, kept here for comparison
+tinyobj::vertex_index_t legacyRawTriple(const char **token)
+{
+	tinyobj::vertex_index_t vi(0);
+	vi.v_idx = atoi((*token));
+	(*token) += strcspn((*token), "/ \t\r");
+	if((*token)[0] != '/') {
+		return vi;
+	}
+	(*token)++;
+	if((*token)[0] == '/') {
+		(*token)++;
+		vi.vn_idx = atoi((*token));
+		(*token) += strcspn((*token), "/ \t\r");
+		return vi;
+	}
+	vi.vt_idx = atoi((*token));
+	(*token) += strcspn((*token), "/ \t\r");
+	if((*token)[0] != '/') {
+		return vi;
+	}
+	(*token)++;
+	vi.vn_idx = atoi((*token));
+	(*token) += strcspn((*token), "/ \t\r");
+	return vi;
+}
+
+// Runs fn over and over for at least 200 ms and returns ns per call
+template<class F>
+double timeIt(F fn)
+{
+	typedef chrono::steady_clock Clock;
+	int reps = 0;
+	Clock::time_point t0 = Clock::now();
+	double elapsed = 0.0;
+	do {
+		fn();
+		reps++;
+		elapsed = chrono::duration<double, nano>(Clock::now() - t0).count();
+	} while(elapsed < 2e8);
+	return elapsed / reps;
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	if(argc < 2) {
+		cerr << "Usage: A1_parsebench <mesh.obj> [more.obj ...]" << endl;
+		return 1;
+	}
+	for(int a = 1; a < argc; a++) {
+		ifstream in(argv[a], ios::binary);
+		if(!in) {
+			cerr << "Cannot open " << argv[a] << endl;
+			return 1;
+		}
+		stringstream ss;
+		ss << in.rdbuf();
+		// One NUL terminated copy per line, like the loader sees them
+		vector<string> lines;
+		string line;
+		while(getline(ss, line)) {
+			if(!line.empty() && line[line.size() - 1] == '\r') {
+				line.erase(line.size() - 1);
+			}
+			lines.push_back(line);
+		}
+		vector<Token> reals, corners;
+		for(const string &l : lines) {
+			const char *p = l.c_str();
+			bool face = p[0] == 'f' && (p[1] == ' ' || p[1] == '\t');
+			bool vertex = p[0] == 'v' && (p[1] == ' ' || p[1] == '\t' ||
+				((p[1] == 'n' || p[1] == 't') && (p[2] == ' ' || p[2] == '\t')));
+			if(!face && !vertex) {
+				continue;
+			}
+			p += strcspn(p, " \t");
+			while(*p) {
+				p += strspn(p, " \t");
+				const char *e = p + strcspn(p, " \t");
+				if(e > p) {
+					(face ? corners : reals).push_back({ p, e });
+				}
+				p = e;
+			}
+		}
+
+		// Both float parsers must agree before their speed means anything
+		size_t mismatches = 0;
+		for(const Token &t : reals) {
+			double d = 0.0;
+			tinyobj::tryParseDouble(t.begin, t.end, &d);
+			float slow = static_cast<float>(d);
+			float fast = 0.0f;
+			if(!tinyobj::tryParseRealFast(t.begin, t.end, &fast)) {
+				fast = slow;
+			}
+			mismatches += memcmp(&slow, &fast, sizeof(float)) != 0;
+		}
+
+		volatile float sinkF = 0.0f;
+		volatile int sinkI = 0;
+		double legacyReal = timeIt([&]() {
+			float sum = 0.0f;
+			for(const Token &t : reals) {
+				double d = 0.0;
+				tinyobj::tryParseDouble(t.begin, t.end, &d);
+				sum += static_cast<float>(d);
+			}
+			sinkF = sum;
+		});
+		double fastReal = timeIt([&]() {
+			float sum = 0.0f;
+			for(const Token &t : reals) {
+				float f = 0.0f;
+				tinyobj::tryParseRealFast(t.begin, t.end, &f);
+				sum += f;
+			}
+			sinkF = sum;
+		});
+		double legacyIndex = timeIt([&]() {
+			int sum = 0;
+			for(const Token &t : corners) {
+				const char *p = t.begin;
+				tinyobj::vertex_index_t vi = legacyRawTriple(&p);
+				sum += vi.v_idx + vi.vn_idx + vi.vt_idx;
+			}
+			sinkI = sum;
+		});
+		double fastIndex = timeIt([&]() {
+			int sum = 0;
+			for(const Token &t : corners) {
+				const char *p = t.begin;
+				tinyobj::vertex_index_t vi = tinyobj::parseRawTriple(&p);
+				sum += vi.v_idx + vi.vn_idx + vi.vt_idx;
+			}
+			sinkI = sum;
+		});
+		double load = timeIt([&]() {
+			tinyobj::attrib_t attrib;
+			vector<tinyobj::shape_t> shapes;
+			vector<tinyobj::material_t> materials;
+			string warn, err;
+			tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, argv[a]);
+		});
+
+		size_t nr = max<size_t>(reals.size(), 1);
+		size_t nc = max<size_t>(corners.size(), 1);
+		cout << argv[a] << ": " << reals.size() << " reals, " << corners.size() << " face corners" << endl;
+		cout << "  reals:   original " << legacyReal / nr << " ns, fast " << fastReal / nr
+			<< " ns (" << legacyReal / fastReal << "x), " << mismatches << " results differ" << endl;
+		cout << "  indices: original " << legacyIndex / nc << " ns, fast " << fastIndex / nc
+			<< " ns (" << legacyIndex / fastIndex << "x)" << endl;
+		cout << "  LoadObj: " << load / 1e6 << " ms" << endl;
+	}
+	return 0;
+}
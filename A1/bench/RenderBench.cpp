@@ -0,0 +1,413 @@
+// Times whole frames of the renderer: every task over the shipped meshes at
+// a range of image sizes and thread counts. A frame is what renderFrame does
+// (clearing the buffers, transform, setup, rasterization and resolve); the
+// mesh is loaded and framed once per benchmark, outside the timing, and no
+// image is encoded.
+//
+// It works like Google Benchmark: each benchmark is first run until it
+// takes --min-time to find an iteration count, then that many iterations
+// are timed --repetitions times, and the mean, median and standard
+// deviation of the repetitions are reported. --out writes the same JSON
+// Google Benchmark does, so its compare.py can diff two builds.
+//
+// Meshes are the shipped ones by name, OBJ files by path, or generated
+// stress meshes by gen: name, e.g. --meshes gen:sphere:1M,gen:stack:10M.
+//
+// Usage: A1_bench [--meshes tri,sphere,teapot,bunny] [--tasks 1,...,8]
+//     [--sizes 256x256,...,7680x4320] [--threads 1,N] [--repetitions 5]
+//     [--min-time 0.1] [--filter regex] [--out results.json]
+//     [--simd scalar|sse2|avx2] [--msaa 1|2|4|8] [--tiled] [--fixed-point]
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Mesh.h"
+#include "MeshGenerator.h"
+#include "MeshLoader.h"
+#include "RenderJob.h"
+#include "Stopwatch.h"
+#include "ThreadPool.h"
+
+#ifndef A1_RESOURCES
+#define A1_RESOURCES "resources"
+#endif
+
+using namespace std;
+
+namespace {
+
+struct Size {
+	int width, height;
+};
+
+struct Benchmark {
+	string name;
+	const Mesh *mesh;
+	int task;
+	Size size;
+	int threads;
+};
+
+// Times of one repetition, per iteration
+struct Repetition {
+	double realMs;
+	double cpuMs;
+};
+
+struct Result {
+	long long iterations;
+	vector<Repetition> repetitions;
+	double trianglesPerFrame;
+	double pixelsPerFrame;
+};
+
+vector<string> splitList(const string &s)
+{
+	vector<string> items;
+	stringstream ss(s);
+	string item;
+	while(getline(ss, item, ',')) {
+		if(!item.empty()) {
+			items.push_back(item);
+		}
+	}
+	return items;
+}
+
+bool parseInts(const string &s, vector<int> &values)
+{
+	values.clear();
+	for(const string &item : splitList(s)) {
+		int v = atoi(item.c_str());
+		if(v <= 0) {
+			return false;
+		}
+		values.push_back(v);
+	}
+	return !values.empty();
+}
+
+// WxH, or a single number for a square
+bool parseSizes(const string &s, vector<Size> &sizes)
+{
+	sizes.clear();
+	for(const string &item : splitList(s)) {
+		size_t x = item.find('x');
+		Size size;
+		size.width = atoi(item.substr(0, x).c_str());
+		size.height = x == string::npos ? size.width : atoi(item.substr(x + 1).c_str());
+		if(size.width <= 0 || size.height <= 0) {
+			return false;
+		}
+		sizes.push_back(size);
+	}
+	return !sizes.empty();
+}
+
+// 1, 2, 4, ... up to the hardware threads, and the hardware threads
+vector<int> defaultThreadCounts()
+{
+	int hw = ThreadPool::defaultThreadCount();
+	vector<int> counts;
+	for(int n = 1; n < hw; n *= 2) {
+		counts.push_back(n);
+	}
+	counts.push_back(hw);
+	return counts;
+}
+
+// Runs iterations frames of b and returns the time per frame
+Repetition runFrames(const Benchmark &b, const RasterParams &params, const RenderOptions &options,
+	long long iterations, FrameBuffers &buffers, RasterStats &stats)
+{
+	Stopwatch timer;
+	for(long long i = 0; i < iterations; i++) {
+		renderFrame(*b.mesh, params, b.size.width, b.size.height, defaultRotation(b.task),
+			options, b.threads, buffers, stats);
+	}
+	StageTime t = timer.elapsed();
+	return { t.wallMs / iterations, t.cpuMs / iterations };
+}
+
+Result runBenchmark(const Benchmark &b, const RenderOptions &options, int repetitions, double minTimeMs)
+{
+	RasterParams params = frameMesh(*b.mesh, b.size.width, b.size.height, b.task);
+	FrameBuffers buffers;
+	RasterStats stats;
+	Result result;
+	// The first frame allocates the buffers and starts the threads
+	runFrames(b, params, options, 1, buffers, stats);
+	// Grow the iteration count until a repetition takes minTimeMs, aiming a
+	// little past it the way Google Benchmark does
+	long long iterations = 1;
+	for(;;) {
+		Repetition r = runFrames(b, params, options, iterations, buffers, stats);
+		double total = r.realMs * iterations;
+		if(total >= minTimeMs || iterations >= 1000000000) {
+			break;
+		}
+		double grow = total > 0.0 ? 1.4 * minTimeMs / total : 10.0;
+		iterations = max(iterations + 1, (long long)ceil(iterations * min(grow, 10.0)));
+	}
+	result.iterations = iterations;
+	for(int rep = 0; rep < repetitions; rep++) {
+		result.repetitions.push_back(runFrames(b, params, options, iterations, buffers, stats));
+	}
+	result.trianglesPerFrame = (double)stats.trianglesIn;
+	result.pixelsPerFrame = (double)b.size.width * b.size.height;
+	return result;
+}
+
+double mean(const vector<double> &v)
+{
+	double sum = 0.0;
+	for(double x : v) {
+		sum += x;
+	}
+	return sum / v.size();
+}
+
+double median(vector<double> v)
+{
+	sort(v.begin(), v.end());
+	size_t n = v.size();
+	return n % 2 ? v[n / 2] : 0.5 * (v[n / 2 - 1] + v[n / 2]);
+}
+
+double stddev(const vector<double> &v)
+{
+	if(v.size() < 2) {
+		return 0.0;
+	}
+	double m = mean(v), sum = 0.0;
+	for(double x : v) {
+		sum += (x - m) * (x - m);
+	}
+	return sqrt(sum / (v.size() - 1));
+}
+
+string jsonString(const string &s)
+{
+	string q = "\"";
+	for(char c : s) {
+		if(c == '"' || c == '\\') {
+			q += '\\';
+		}
+		q += c;
+	}
+	return q + "\"";
+}
+
+// One entry of the "benchmarks" array, in Google Benchmark's format
+void writeEntry(ostream &out, const Benchmark &b, const Result &r, int repetitions, int index,
+	const string &aggregate, double realMs, double cpuMs, bool last)
+{
+	char buf[64];
+	out << "    {\n";
+	out << "      \"name\": " << jsonString(aggregate.empty() ? b.name : b.name + "_" + aggregate) << ",\n";
+	out << "      \"run_name\": " << jsonString(b.name) << ",\n";
+	out << "      \"run_type\": \"" << (aggregate.empty() ? "iteration" : "aggregate") << "\",\n";
+	out << "      \"repetitions\": " << repetitions << ",\n";
+	if(aggregate.empty()) {
+		out << "      \"repetition_index\": " << index << ",\n";
+	} else {
+		out << "      \"aggregate_name\": \"" << aggregate << "\",\n";
+	}
+	out << "      \"threads\": " << b.threads << ",\n";
+	out << "      \"iterations\": " << (aggregate.empty() ? r.iterations : (long long)repetitions) << ",\n";
+	snprintf(buf, sizeof(buf), "%.6f", realMs);
+	out << "      \"real_time\": " << buf << ",\n";
+	snprintf(buf, sizeof(buf), "%.6f", cpuMs);
+	out << "      \"cpu_time\": " << buf << ",\n";
+	out << "      \"time_unit\": \"ms\"";
+	// Rates make no sense of a spread
+	if(aggregate != "stddev" && realMs > 0.0) {
+		snprintf(buf, sizeof(buf), "%.1f", r.trianglesPerFrame * 1000.0 / realMs);
+		out << ",\n      \"triangles_per_second\": " << buf;
+		snprintf(buf, sizeof(buf), "%.3f", r.pixelsPerFrame / 1000.0 / realMs);
+		out << ",\n      \"megapixels_per_second\": " << buf;
+	}
+	out << "\n    }" << (last ? "" : ",") << "\n";
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	vector<string> meshNames = { "tri", "sphere", "teapot", "bunny" };
+	vector<int> tasks = { 1, 2, 3, 4, 5, 6, 7, 8 };
+	vector<Size> sizes = { { 256, 256 }, { 1024, 1024 }, { 2048, 2048 }, { 3840, 2160 }, { 7680, 4320 } };
+	vector<int> threadCounts = defaultThreadCounts();
+	int repetitions = 5;
+	double minTime = 0.1;
+	string filter, outName;
+	RenderOptions options = RenderOptions();
+	options.simd = detectSimdLevel();
+	options.hiz = true;
+	options.samples = 1;
+	options.depthFormat = DepthFormat::Float32;
+	options.cull = CullMode::Back;
+
+	for(int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		bool ok = true;
+		if(arg == "--meshes" && i + 1 < argc) {
+			meshNames = splitList(argv[++i]);
+			ok = !meshNames.empty();
+		} else if(arg == "--tasks" && i + 1 < argc) {
+			ok = parseInts(argv[++i], tasks);
+		} else if(arg == "--sizes" && i + 1 < argc) {
+			ok = parseSizes(argv[++i], sizes);
+		} else if(arg == "--threads" && i + 1 < argc) {
+			ok = parseInts(argv[++i], threadCounts);
+		} else if(arg == "--repetitions" && i + 1 < argc) {
+			repetitions = atoi(argv[++i]);
+			ok = repetitions > 0;
+		} else if(arg == "--min-time" && i + 1 < argc) {
+			minTime = atof(argv[++i]);
+			ok = minTime >= 0.0;
+		} else if(arg == "--filter" && i + 1 < argc) {
+			filter = argv[++i];
+		} else if(arg == "--out" && i + 1 < argc) {
+			outName = argv[++i];
+		} else if(arg == "--simd" && i + 1 < argc) {
+			ok = parseSimdLevel(argv[++i], options.simd);
+		} else if(arg == "--msaa" && i + 1 < argc) {
+			options.samples = atoi(argv[++i]);
+			ok = options.samples == 1 || options.samples == 2 || options.samples == 4 || options.samples == 8;
+		} else if(arg == "--tiled") {
+			options.tiled = true;
+		} else if(arg == "--fixed-point") {
+			options.fixedPoint = true;
+		} else {
+			ok = false;
+		}
+		if(!ok) {
+			cerr << "Bad argument " << arg << endl;
+			cerr << "Usage: A1_bench [--meshes tri,sphere,teapot,bunny] [--tasks 1,...,8] [--sizes 256x256,...,7680x4320]"
+				<< " [--threads 1,N] [--repetitions 5] [--min-time 0.1] [--filter regex] [--out results.json]"
+				<< " [--simd scalar|sse2|avx2] [--msaa 1|2|4|8] [--tiled] [--fixed-point]" << endl;
+			return 1;
+		}
+	}
+
+	// A mesh name without a slash is one of the shipped meshes, unless it
+	// is a generated one (gen:..., see MeshGenerator.h)
+	vector<unique_ptr<Mesh> > meshes;
+	for(string &name : meshNames) {
+		bool shipped = name.find('/') == string::npos && !isStressMeshName(name);
+		string path = shipped ? string(A1_RESOURCES) + "/" + name + ".obj" : name;
+		meshes.emplace_back(new Mesh());
+		string warn, err;
+		if(!loadObjMesh(path, *meshes.back(), warn, err, 0, false)) {
+			cerr << err << endl;
+			return 1;
+		}
+		size_t slash = name.find_last_of('/');
+		name = name.substr(slash == string::npos ? 0 : slash + 1);
+		if(name.size() > 4 && name.substr(name.size() - 4) == ".obj") {
+			name.erase(name.size() - 4);
+		}
+	}
+
+	vector<Benchmark> benchmarks;
+	regex pattern;
+	try {
+		pattern = regex(filter);
+	} catch(const regex_error &) {
+		cerr << "Bad filter " << filter << endl;
+		return 1;
+	}
+	for(size_t m = 0; m < meshes.size(); m++) {
+		for(int task : tasks) {
+			for(const Size &size : sizes) {
+				for(int threads : threadCounts) {
+					Benchmark b;
+					b.name = "BM_Render/" + meshNames[m] + "/task:" + to_string(task) + "/" +
+						to_string(size.width) + "x" + to_string(size.height) + "/threads:" + to_string(threads);
+					b.mesh = meshes[m].get();
+					b.task = task;
+					b.size = size;
+					b.threads = threads;
+					if(filter.empty() || regex_search(b.name, pattern)) {
+						benchmarks.push_back(b);
+					}
+				}
+			}
+		}
+	}
+
+	time_t now = time(nullptr);
+	char date[64];
+	strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+	cout << date << endl;
+	cout << "Running " << benchmarks.size() << " benchmarks, " << repetitions << " repetitions of at least "
+		<< minTime << " s each, SIMD " << simdLevelName(min(options.simd, detectSimdLevel())) << endl;
+	printf("%-52s %12s %12s %10s %14s %10s\n", "Benchmark", "Time", "CPU", "Iterations", "Triangles/s", "MP/s");
+
+	vector<Result> results;
+	for(const Benchmark &b : benchmarks) {
+		Result r = runBenchmark(b, options, repetitions, minTime * 1000.0);
+		vector<double> real, cpu;
+		for(const Repetition &rep : r.repetitions) {
+			real.push_back(rep.realMs);
+			cpu.push_back(rep.cpuMs);
+		}
+		double t = median(real);
+		printf("%-52s %9.3f ms %9.3f ms %10lld %14.4g %10.2f\n", (b.name + "_median").c_str(), t, median(cpu),
+			r.iterations, r.trianglesPerFrame * 1000.0 / t, r.pixelsPerFrame / 1000.0 / t);
+		printf("%-52s %9.3f ms %9.3f ms\n", (b.name + "_stddev").c_str(), stddev(real), stddev(cpu));
+		fflush(stdout);
+		results.push_back(r);
+	}
+
+	if(!outName.empty()) {
+		ofstream out(outName.c_str());
+		out << "{\n";
+		out << "  \"context\": {\n";
+		out << "    \"date\": \"" << date << "\",\n";
+		out << "    \"executable\": " << jsonString(argv[0]) << ",\n";
+		out << "    \"num_cpus\": " << ThreadPool::defaultThreadCount() << ",\n";
+		out << "    \"simd\": \"" << simdLevelName(min(options.simd, detectSimdLevel())) << "\",\n";
+		out << "    \"samples\": " << options.samples << ",\n";
+		out << "    \"tiled\": " << (options.tiled ? "true" : "false") << ",\n";
+		out << "    \"fixed_point\": " << (options.fixedPoint ? "true" : "false") << ",\n";
+#ifdef NDEBUG
+		out << "    \"library_build_type\": \"release\"\n";
+#else
+		out << "    \"library_build_type\": \"debug\"\n";
+#endif
+		out << "  },\n";
+		out << "  \"benchmarks\": [\n";
+		for(size_t i = 0; i < benchmarks.size(); i++) {
+			const Benchmark &b = benchmarks[i];
+			const Result &r = results[i];
+			vector<double> real, cpu;
+			for(int rep = 0; rep < repetitions; rep++) {
+				real.push_back(r.repetitions[rep].realMs);
+				cpu.push_back(r.repetitions[rep].cpuMs);
+				writeEntry(out, b, r, repetitions, rep, "", real.back(), cpu.back(), false);
+			}
+			writeEntry(out, b, r, repetitions, 0, "mean", mean(real), mean(cpu), false);
+			writeEntry(out, b, r, repetitions, 0, "median", median(real), median(cpu), false);
+			writeEntry(out, b, r, repetitions, 0, "stddev", stddev(real), stddev(cpu), i + 1 == benchmarks.size());
+		}
+		out << "  ]\n";
+		out << "}\n";
+		if(!out) {
+			cerr << "Failed to write " << outName << endl;
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#ifndef _ALIGNEDALLOCATOR_H_
+#define _ALIGNEDALLOCATOR_H_
+
+#include <cstddef>
+#include <new>
+
+/**
+ * std::vector allocator that starts every array on an Alignment byte
+ * boundary, so that vector loads over it never split a cache line.
+ */
+template<class T, size_t Alignment>
+struct AlignedAllocator {
+	typedef T value_type;
+	template<class U> struct rebind { typedef AlignedAllocator<U, Alignment> other; };
+
+	AlignedAllocator() {}
+	template<class U> AlignedAllocator(const AlignedAllocator<U, Alignment> &) {}
+
+	T *allocate(size_t n)
+	{
+		return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+	}
+	void deallocate(T *p, size_t)
+	{
+		::operator delete(p, std::align_val_t(Alignment));
+	}
+	template<class U> bool operator==(const AlignedAllocator<U, Alignment> &) const { return true; }
+	template<class U> bool operator!=(const AlignedAllocator<U, Alignment> &) const { return false; }
+};
+
+#endif
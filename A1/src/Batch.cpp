@@ -0,0 +1,255 @@
+#include "Batch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+#include "ImageEncoder.h"
+#include "Mesh.h"
+#include "MeshGenerator.h"
+#include "MeshLoader.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+namespace {
+
+// Keeps console lines of concurrent jobs apart
+mutex logMutex;
+
+double millisecondsSince(chrono::steady_clock::time_point start)
+{
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * The meshes of a batch, each loaded the first time a job asks for it and
+ * dropped once every job that uses it has released it. Jobs that want a
+ * mesh that is still loading wait for it instead of loading it again.
+ */
+class MeshLibrary
+{
+public:
+	MeshLibrary(const vector<RenderJob> &jobs, int loadThreads, bool useCache);
+	// Returns the mesh, or null (with err set) if it cannot be loaded.
+	shared_ptr<const Mesh> acquire(const string &name, string &err);
+	void release(const string &name);
+
+private:
+	struct Entry {
+		mutex mtx;
+		shared_ptr<Mesh> mesh;
+		bool loaded;
+		bool failed;
+		string err;
+		int remaining; // jobs that have not released the mesh yet
+	};
+
+	// Every entry exists from the start, so the map itself is read only
+	// while jobs run and only the entries need locking.
+	map<string, unique_ptr<Entry> > entries;
+	int loadThreads;
+	bool useCache;
+};
+
+MeshLibrary::MeshLibrary(const vector<RenderJob> &jobs, int loadThreads, bool useCache) :
+	loadThreads(loadThreads),
+	useCache(useCache)
+{
+	for(const RenderJob &job : jobs) {
+		unique_ptr<Entry> &entry = entries[job.meshName];
+		if(!entry) {
+			entry.reset(new Entry());
+			entry->loaded = false;
+			entry->failed = false;
+			entry->remaining = 0;
+		}
+		entry->remaining++;
+	}
+}
+
+shared_ptr<const Mesh> MeshLibrary::acquire(const string &name, string &err)
+{
+	Entry &entry = *entries.at(name);
+	lock_guard<mutex> lock(entry.mtx);
+	if(!entry.loaded) {
+		entry.loaded = true;
+		entry.mesh = make_shared<Mesh>();
+		string warn;
+		if(!loadObjMesh(name, *entry.mesh, warn, entry.err, loadThreads, useCache)) {
+			entry.failed = true;
+			entry.mesh.reset();
+		}
+		if(!warn.empty()) {
+			lock_guard<mutex> logLock(logMutex);
+			cerr << name << ": " << warn;
+		}
+	}
+	if(entry.failed) {
+		err = entry.err;
+	}
+	return entry.mesh;
+}
+
+void MeshLibrary::release(const string &name)
+{
+	Entry &entry = *entries.at(name);
+	lock_guard<mutex> lock(entry.mtx);
+	if(--entry.remaining == 0) {
+		entry.mesh.reset();
+	}
+}
+
+}
+
+bool parseBatchScheduler(const string &name, BatchScheduler &scheduler)
+{
+	if(name == "throughput") {
+		scheduler = BatchScheduler::Throughput;
+	} else if(name == "latency") {
+		scheduler = BatchScheduler::Latency;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+bool readManifest(const string &filename, vector<RenderJob> &jobs, string &err)
+{
+	ifstream in(filename.c_str());
+	if(!in) {
+		err = "Cannot open manifest [" + filename + "]";
+		return false;
+	}
+	string line;
+	for(int lineNumber = 1; getline(in, line); lineNumber++) {
+		istringstream fields(line);
+		RenderJob job;
+		if(!(fields >> job.meshName) || job.meshName[0] == '#') {
+			continue;
+		}
+		if(!(fields >> job.outputName >> job.width >> job.height >> job.task) ||
+			job.width <= 0 || job.height <= 0) {
+			err = filename + ":" + to_string(lineNumber) +
+				": expected <mesh.obj> <output.png> <width> <height> <task> [rotation]";
+			return false;
+		}
+		if(job.outputName == "-") {
+			// Images finish in no particular order, and the progress
+			// report goes to stdout too
+			err = filename + ":" + to_string(lineNumber) + ": a batch cannot write to stdout";
+			return false;
+		}
+		StressSpec spec;
+		string genErr;
+		if(isStressMeshName(job.meshName) && !parseStressMeshName(job.meshName, spec, genErr)) {
+			err = filename + ":" + to_string(lineNumber) + ": " + genErr;
+			return false;
+		}
+		string rotation, extra;
+		if(!(fields >> rotation)) {
+			job.rotation = defaultRotation(job.task);
+		} else {
+			// The whole token has to be the number, and nothing may follow it
+			char *end = nullptr;
+			job.rotation = strtof(rotation.c_str(), &end);
+			if(*end != '\0' || !isfinite(job.rotation) || fields >> extra) {
+				err = filename + ":" + to_string(lineNumber) + ": bad rotation";
+				return false;
+			}
+		}
+		job.format = formatFromFilename(job.outputName);
+		jobs.push_back(job);
+	}
+	return true;
+}
+
+int runBatch(const vector<RenderJob> &jobs, const RenderOptions &options,
+	BatchScheduler scheduler, int nThreads, int nEncoders, PngLevel pngLevel, bool useCache)
+{
+	auto batchStart = chrono::steady_clock::now();
+	int cores = nThreads > 0 ? nThreads : ThreadPool::defaultThreadCount();
+	bool throughput = scheduler == BatchScheduler::Throughput;
+	// Concurrent jobs, and threads for each job's loading and rasterizing
+	int concurrent = throughput ? cores : 1;
+	int perJob = throughput ? 1 : cores;
+	MeshLibrary library(jobs, perJob, useCache);
+	atomic<int> failed(0);
+	atomic<int> finished(0);
+	double latencySum = 0.0, latencyMax = 0.0;
+	// Buffers per worker, reused from job to job
+	vector<FrameBuffers> buffers(concurrent);
+
+	// Counts the job and reports it once its image is written
+	auto jobDone = [&](int i, bool ok, const string &err, chrono::steady_clock::time_point jobStart) {
+		double ms = millisecondsSince(jobStart);
+		lock_guard<mutex> lock(logMutex);
+		int n = ++finished;
+		if(ok) {
+			latencySum += ms;
+			latencyMax = max(latencyMax, ms);
+			cout << "[" << n << "/" << jobs.size() << "] " << jobs[i].outputName << ": "
+				<< fixed << setprecision(1) << ms << " ms" << endl;
+		} else {
+			failed++;
+			cerr << "[" << n << "/" << jobs.size() << "] " << jobs[i].outputName << " failed: " << err << endl;
+		}
+	};
+
+	// Declared after jobDone, which its callbacks use
+	ImageEncoder encoder(nEncoders, 0, pngLevel);
+
+	auto runJob = [&](int i, int worker) {
+		auto jobStart = chrono::steady_clock::now();
+		const RenderJob &job = jobs[i];
+		string err;
+		shared_ptr<const Mesh> mesh = library.acquire(job.meshName, err);
+		if(!mesh) {
+			library.release(job.meshName);
+			jobDone(i, false, err.empty() ? "Cannot load " + job.meshName : err, jobStart);
+			return;
+		}
+		RasterStats stats;
+		renderJob(*mesh, job, options, perJob, buffers[worker], stats);
+		mesh.reset();
+		library.release(job.meshName);
+		// The encoder writes the image while this worker goes on with the
+		// next job, which renders into a recycled buffer.
+		encoder.submit(job.outputName, job.format, job.width, job.height, buffers[worker].image,
+			[&jobDone, i, jobStart](bool written) {
+				jobDone(i, written, "Failed to write output file", jobStart);
+			});
+		encoder.recycle(buffers[worker].image);
+	};
+
+	if(throughput) {
+		ThreadPool pool(concurrent);
+		pool.parallelFor((int)jobs.size(), runJob);
+	} else {
+		for(int i = 0; i < (int)jobs.size(); i++) {
+			runJob(i, 0);
+		}
+	}
+	encoder.finish();
+
+	double seconds = millisecondsSince(batchStart) / 1000.0;
+	int done = (int)jobs.size() - failed;
+	cout << "Batch: " << done << " of " << jobs.size() << " images in " << fixed << setprecision(2)
+		<< seconds << " s (" << (seconds > 0.0 ? done / seconds : 0.0) << " images/s, "
+		<< (throughput ? "throughput" : "latency") << " scheduler, " << cores << " threads, "
+		<< encoder.getThreadCount() << " encoders)" << endl;
+	if(done > 0) {
+		cout << "Job latency: " << setprecision(1) << latencySum / done << " ms mean, "
+			<< latencyMax << " ms max" << endl;
+	}
+	return failed;
+}
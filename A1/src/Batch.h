@@ -0,0 +1,41 @@
+#pragma once
+#ifndef _BATCH_H_
+#define _BATCH_H_
+
+#include <string>
+#include <vector>
+
+#include "PngWriter.h"
+#include "RenderJob.h"
+
+/**
+ * How a batch spreads its jobs over the cores.
+ * Throughput renders one job per core at a time, each on a single thread,
+ * which finishes the whole batch soonest. Latency renders the jobs one after
+ * the other with every core on the current image, which gets each image out
+ * soonest.
+ */
+enum class BatchScheduler { Throughput, Latency };
+
+// Accepts "throughput" and "latency". Returns false on anything else.
+bool parseBatchScheduler(const std::string &name, BatchScheduler &scheduler);
+
+// Reads a job manifest: one job per line as
+//   <mesh.obj> <output.png> <width> <height> <task> [rotation]
+// separated by whitespace, with rotation in radians (defaultRotation(task)
+// if left out). The output format follows the extension of the output name.
+// Blank lines and lines starting with # are skipped. Returns false and sets
+// err on a malformed line, which includes a gen: mesh name that does not
+// parse and a rotation that is not a number or has anything after it.
+bool readManifest(const std::string &filename, std::vector<RenderJob> &jobs, std::string &err);
+
+// Renders every job and writes its image, loading each mesh only once and
+// keeping it until the last job that uses it is done. nThreads (<= 0: one
+// per hardware thread) is the number of cores to use for rendering. Images
+// are encoded in each job's format on nEncoders threads of their own (<= 0:
+// the ImageEncoder default), PNGs at pngLevel, while the next jobs render.
+// Returns the number of jobs that failed.
+int runBatch(const std::vector<RenderJob> &jobs, const RenderOptions &options,
+	BatchScheduler scheduler, int nThreads, int nEncoders, PngLevel pngLevel, bool useCache);
+
+#endif
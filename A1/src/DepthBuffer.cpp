@@ -0,0 +1,84 @@
+#include "DepthBuffer.h"
+
+#include <cmath>
+#include <limits>
+
+using namespace std;
+
+bool parseDepthFormat(const string &name, DepthFormat &format)
+{
+	if(name == "float") {
+		format = DepthFormat::Float32;
+	} else if(name == "unorm24") {
+		format = DepthFormat::Unorm24;
+	} else if(name == "unorm16") {
+		format = DepthFormat::Unorm16;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+DepthBuffer::DepthBuffer() :
+	format(DepthFormat::Float32),
+	samples(1),
+	quantMinZ(0.0f),
+	quantScale(0.0f),
+	quantMax(0.0f)
+{
+}
+
+DepthBuffer::~DepthBuffer()
+{
+}
+
+void DepthBuffer::reset(const FrameLayout &l, DepthFormat f, float minZ, float maxZ, int n)
+{
+	if(f != format) {
+		// Let go of the storage of the previous format
+		decltype(floats)().swap(floats);
+		decltype(words)().swap(words);
+		decltype(shorts)().swap(shorts);
+	}
+	layout = l;
+	format = f;
+	samples = n;
+	size_t values = l.size() * n;
+	int bits = f == DepthFormat::Unorm16 ? 16 : 24;
+	uint32_t cleared = (1u << bits) - 1;
+	quantMinZ = minZ;
+	quantMax = (float)(cleared - 1);
+	// A flat range puts everything at 0, where the first pixel drawn wins
+	quantScale = maxZ > minZ ? quantMax / (maxZ - minZ) : 0.0f;
+	switch(f) {
+	case DepthFormat::Float32:
+		floats.assign(values, numeric_limits<float>::max());
+		break;
+	case DepthFormat::Unorm24:
+		words.assign(values, cleared);
+		break;
+	case DepthFormat::Unorm16:
+		shorts.assign(values, (uint16_t)cleared);
+		break;
+	}
+}
+
+void *DepthBuffer::pixel(size_t i)
+{
+	switch(format) {
+	case DepthFormat::Unorm24:
+		return words.data() + i;
+	case DepthFormat::Unorm16:
+		return shorts.data() + i;
+	default:
+		return floats.data() + i;
+	}
+}
+
+float DepthBuffer::storedBound(float z) const
+{
+	if(format == DepthFormat::Float32 || std::isnan(z)) {
+		return z;
+	}
+	return (float)quantize(z);
+}
@@ -0,0 +1,82 @@
+#pragma once
+#ifndef _DEPTHBUFFER_H_
+#define _DEPTHBUFFER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "AlignedAllocator.h"
+#include "FrameLayout.h"
+
+/**
+ * How depths are stored.
+ * Float32 keeps z as it is. The unorm formats map the depth range of the
+ * frame linearly onto 0 .. 2^bits - 2 and round, which leaves 2^bits - 1,
+ * the cleared value, behind anything that gets drawn. Unorm16 halves the
+ * memory traffic of the depth test. Unorm24 sits in the low bits of 32 bit
+ * words, so it saves no memory but is a much finer step for the same
+ * integer compare.
+ */
+enum class DepthFormat { Float32, Unorm24, Unorm16 };
+
+// Accepts "float", "unorm24" and "unorm16". Returns false on anything else.
+bool parseDepthFormat(const std::string &name, DepthFormat &format);
+
+/**
+ * A depth buffer in one of the DepthFormats, stored in a FrameLayout. Smaller
+ * values are nearer in every
+ * format, and quantizing never swaps the order of two depths, so a bound on
+ * depths also bounds the stored values (see storedBound).
+ */
+class DepthBuffer
+{
+public:
+	DepthBuffer();
+	virtual ~DepthBuffer();
+	// Sizes the buffer for layout and clears it. The unorm formats quantize
+	// [minZ, maxZ]; depths outside it are clamped. Float32 ignores the range.
+	// A multisampled buffer has samples planes of layout.size() values.
+	void reset(const FrameLayout &layout, DepthFormat format, float minZ, float maxZ,
+		int samples = 1);
+	DepthFormat getFormat() const { return format; }
+	const FrameLayout &getLayout() const { return layout; }
+	int getSamples() const { return samples; }
+	// The value at storage position i (see FrameLayout::index, plus the
+	// plane times layout.size()), in the buffer's format
+	void *pixel(size_t i);
+	const float *getFloats() const { return floats.data(); }
+	const uint32_t *getWords() const { return words.data(); }
+	const uint16_t *getShorts() const { return shorts.data(); }
+
+	// The unorm value of z. The span kernels do exactly these operations, in
+	// this order, so every SIMD level stores the same values.
+	int quantize(float z) const
+	{
+		float t = (z - quantMinZ) * quantScale;
+		t = t > 0.0f ? t : 0.0f;
+		t = t < quantMax ? t : quantMax;
+		return static_cast<int>(t + 0.5f);
+	}
+	float getQuantMinZ() const { return quantMinZ; }
+	float getQuantScale() const { return quantScale; }
+	float getQuantMax() const { return quantMax; }
+	// A lower bound on the values stored for depths of at least z, in the
+	// units the Hi-Z keeps (floats, which hold every unorm value exactly).
+	// NaN stays NaN, which never rejects anything.
+	float storedBound(float z) const;
+
+private:
+	FrameLayout layout;
+	DepthFormat format;
+	int samples;
+	float quantMinZ;
+	float quantScale;
+	float quantMax;
+	// Only the one for the current format is in use
+	std::vector<float, AlignedAllocator<float, 64> > floats;
+	std::vector<uint32_t, AlignedAllocator<uint32_t, 64> > words;
+	std::vector<uint16_t, AlignedAllocator<uint16_t, 64> > shorts;
+};
+
+#endif
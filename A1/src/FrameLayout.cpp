@@ -0,0 +1,88 @@
+#include "FrameLayout.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+// Pixels per band of the linear layout, so that resolving a band is worth
+// handing to a worker
+const int BAND_PIXELS = 1 << 14;
+
+FrameLayout::FrameLayout(int w, int h, int t) :
+	width(w),
+	height(h),
+	tileSize(t),
+	tilesX(t > 0 ? (w + t - 1) / t : 1),
+	tilesY(t > 0 ? (h + t - 1) / t : 1),
+	bandRows(max(1, BAND_PIXELS / max(w, 1)))
+{
+}
+
+size_t FrameLayout::size() const
+{
+	if(!tileSize) {
+		return (size_t)width * height;
+	}
+	return (size_t)tilesX * tilesY * tileSize * tileSize;
+}
+
+void FrameLayout::resolveBlock(int b, int comp, int samples, const unsigned char *framebuffer,
+	unsigned char *image) const
+{
+	int x0, y0, x1, y1;
+	if(tileSize) {
+		x0 = (b % tilesX) * tileSize;
+		y0 = (b / tilesX) * tileSize;
+		x1 = min(x0 + tileSize, width);
+		y1 = min(y0 + tileSize, height);
+	} else {
+		x0 = 0;
+		y0 = b * bandRows;
+		x1 = width;
+		y1 = min(y0 + bandRows, height);
+	}
+	size_t rowBytes = (size_t)(x1 - x0) * comp;
+	if(!tileSize && samples == 1) {
+		// Same rows in the same order: the band is one block of memory
+		size_t at = (size_t)(height - y1) * rowBytes;
+		memcpy(image + at, framebuffer + at, (size_t)(y1 - y0) * rowBytes);
+		return;
+	}
+	if(samples == 1) {
+		for(int y = y0; y < y1; y++) {
+			// The y flip happens here, one tile row at a time
+			memcpy(image + ((size_t)(height - 1 - y) * width + x0) * comp,
+				framebuffer + index(x0, y) * comp, rowBytes);
+		}
+		return;
+	}
+
+	// Sums of up to 8 bytes fit in 16 bits, which keeps the loops below
+	// simple enough for the compiler to vectorize.
+	int shift = 0;
+	while((1 << shift) < samples) {
+		shift++;
+	}
+	size_t planeBytes = size() * comp;
+	vector<uint16_t> sum(rowBytes);
+	for(int y = y0; y < y1; y++) {
+		const unsigned char *row = framebuffer + index(x0, y) * comp;
+		for(size_t i = 0; i < rowBytes; i++) {
+			sum[i] = row[i];
+		}
+		for(int s = 1; s < samples; s++) {
+			const unsigned char *plane = row + s * planeBytes;
+			for(size_t i = 0; i < rowBytes; i++) {
+				sum[i] += plane[i];
+			}
+		}
+		unsigned char *out = image + ((size_t)(height - 1 - y) * width + x0) * comp;
+		uint16_t half = (uint16_t)(samples >> 1);
+		for(size_t i = 0; i < rowBytes; i++) {
+			out[i] = (unsigned char)((sum[i] + half) >> shift);
+		}
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+#ifndef _FRAMELAYOUT_H_
+#define _FRAMELAYOUT_H_
+
+#include <cstddef>
+
+/**
+ * Where each pixel of a width x height framebuffer is stored. Positions are
+ * raster coordinates (y up), which is what the rasterizer works in.
+ *
+ * Linear is the layout of the image files: rows from the top down, so the
+ * rasterizer walks backwards through memory as it goes up the rows.
+ * Tiled keeps each tileSize x tileSize tile in one block of memory, tiles
+ * from the bottom left row by row, and rows inside a tile from the bottom
+ * up. A worker drawing a tile then touches one contiguous block per buffer
+ * instead of tileSize rows spread over the whole image, and never shares a
+ * cache line with the worker of another tile. Tiles at the right and top
+ * edges are padded to full size, so tile t always starts at pixel
+ * t * tileSize^2. Rows within a tile stay linear, which keeps every span of
+ * a tile contiguous for the span kernels.
+ */
+class FrameLayout
+{
+public:
+	// tileSize 0 is the linear layout
+	FrameLayout(int width = 0, int height = 0, int tileSize = 0);
+	bool isTiled() const { return tileSize > 0; }
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
+	int getTileSize() const { return tileSize; }
+	int getTileCount() const { return tilesX * tilesY; }
+	// Pixels of storage the layout needs, padding included
+	size_t size() const;
+	// Storage position of pixel (x, y). The pixels after it up to the end of
+	// its row (of the tile, if tiled) follow it directly.
+	size_t index(int x, int y) const
+	{
+		if(!tileSize) {
+			return (size_t)(height - 1 - y) * width + x;
+		}
+		size_t tile = (size_t)(y / tileSize) * tilesX + x / tileSize;
+		return tile * tileSize * tileSize + (y % tileSize) * tileSize + x % tileSize;
+	}
+	// Blocks resolveBlock() works in: the tiles, or in the linear layout
+	// bands of whole rows, about 16K pixels each.
+	int getBlockCount() const { return tileSize ? tilesX * tilesY : (height + bandRows - 1) / bandRows; }
+	// Copies the part of framebuffer (in this layout, comp bytes per pixel)
+	// that block b covers into image, which is linear with the first row at
+	// the top. A multisampled framebuffer holds samples planes of size()
+	// pixels one after the other, and each pixel of image gets the rounded
+	// mean of its samples (a box filter); samples is a power of two. Blocks
+	// can be resolved in any order and at the same time.
+	void resolveBlock(int b, int comp, int samples, const unsigned char *framebuffer, unsigned char *image) const;
+
+private:
+	int width;
+	int height;
+	int tileSize;
+	int tilesX;
+	int tilesY;
+	int bandRows; // rows per block of the linear layout
+};
+
+#endif
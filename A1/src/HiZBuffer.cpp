@@ -0,0 +1,115 @@
+#include "HiZBuffer.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+
+HiZBuffer::HiZBuffer() :
+	depth(nullptr),
+	width(0),
+	height(0),
+	tileBlocks(1),
+	blocksX(0),
+	blocksY(0),
+	tilesX(0)
+{
+}
+
+HiZBuffer::~HiZBuffer()
+{
+}
+
+void HiZBuffer::reset(const DepthBuffer &d, int tileSize)
+{
+	depth = &d;
+	int w = d.getLayout().getWidth();
+	int h = d.getLayout().getHeight();
+	width = w;
+	height = h;
+	tileBlocks = tileSize / BLOCK_SIZE;
+	blocksX = (w + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	blocksY = (h + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	tilesX = (blocksX + tileBlocks - 1) / tileBlocks;
+	int tilesY = (blocksY + tileBlocks - 1) / tileBlocks;
+	// Nothing is known about the buffer yet
+	blockFar.assign(blocksX * blocksY, numeric_limits<float>::infinity());
+	blockDirty.assign(blocksX * blocksY, 1);
+	tileFar.assign(tilesX * tilesY, numeric_limits<float>::infinity());
+	tileDirty.assign(tilesX * tilesY, 1);
+}
+
+bool HiZBuffer::tileOccluded(int tx, int ty, float zNear)
+{
+	int t = ty * tilesX + tx;
+	if(zNear < tileFar[t] && tileDirty[t]) {
+		// Rebuild from the block bounds, stale or not. Rescanning the
+		// whole tile here would cost more than it could save.
+		float far = -numeric_limits<float>::infinity();
+		int bx1 = min((tx + 1) * tileBlocks, blocksX);
+		int by1 = min((ty + 1) * tileBlocks, blocksY);
+		for(int by = ty * tileBlocks; by < by1; by++) {
+			for(int bx = tx * tileBlocks; bx < bx1; bx++) {
+				far = max(far, blockFar[by * blocksX + bx]);
+			}
+		}
+		tileFar[t] = far;
+		tileDirty[t] = 0;
+	}
+	return zNear >= tileFar[t];
+}
+
+bool HiZBuffer::blockOccluded(int bx, int by, float zNear)
+{
+	int b = by * blocksX + bx;
+	if(zNear < blockFar[b] && blockDirty[b]) {
+		refreshBlock(bx, by);
+	}
+	return zNear >= blockFar[b];
+}
+
+void HiZBuffer::touchBlock(int bx, int by)
+{
+	blockDirty[by * blocksX + bx] = 1;
+	tileDirty[(by / tileBlocks) * tilesX + bx / tileBlocks] = 1;
+}
+
+void HiZBuffer::refreshBlock(int bx, int by)
+{
+	int x0 = bx * BLOCK_SIZE;
+	int x1 = min(x0 + BLOCK_SIZE, width);
+	int y0 = by * BLOCK_SIZE;
+	int y1 = min(y0 + BLOCK_SIZE, height);
+	float far;
+	switch(depth->getFormat()) {
+	case DepthFormat::Unorm24:
+		far = blockMax(depth->getWords(), x0, x1, y0, y1);
+		break;
+	case DepthFormat::Unorm16:
+		far = blockMax(depth->getShorts(), x0, x1, y0, y1);
+		break;
+	default:
+		far = blockMax(depth->getFloats(), x0, x1, y0, y1);
+		break;
+	}
+	int b = by * blocksX + bx;
+	blockFar[b] = far;
+	blockDirty[b] = 0;
+	// The tile bound may be able to tighten now
+	tileDirty[(by / tileBlocks) * tilesX + bx / tileBlocks] = 1;
+}
+
+template<class T>
+float HiZBuffer::blockMax(const T *values, int x0, int x1, int y0, int y1) const
+{
+	// Blocks never straddle a tile, so each block row is contiguous
+	const FrameLayout &layout = depth->getLayout();
+	float far = -numeric_limits<float>::infinity();
+	for(int y = y0; y < y1; y++) {
+		const T *row = values + layout.index(x0, y);
+		for(int x = 0; x < x1 - x0; x++) {
+			far = max(far, (float)row[x]);
+		}
+	}
+	return far;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#ifndef _HIZBUFFER_H_
+#define _HIZBUFFER_H_
+
+#include <vector>
+
+#include "DepthBuffer.h"
+
+/**
+ * Coarse depth bounds over a depth buffer, for occlusion rejection.
+ * For every BLOCK_SIZE x BLOCK_SIZE block and every tile it keeps an upper
+ * bound on the values stored there. Anything whose nearest possible stored
+ * value (DepthBuffer::storedBound) is at or beyond that bound would fail the
+ * depth test on every pixel and can be skipped. Bounds are kept as floats
+ * whatever the format, which holds unorm values exactly.
+ *
+ * Bounds are allowed to go stale: drawing only ever lowers depths, so an old
+ * bound is still an upper bound. Drawing into a block just marks it dirty and
+ * the exact bound is recomputed from the depth buffer the next time a query
+ * might be answered differently. Blocks and tiles use raster coordinates
+ * (y up). All state of a tile is only touched by the thread that owns it.
+ */
+class HiZBuffer
+{
+public:
+	static const int BLOCK_SIZE = 8;
+
+	HiZBuffer();
+	virtual ~HiZBuffer();
+	// Starts tracking depth split into tiles of tileSize pixels, a multiple
+	// of BLOCK_SIZE.
+	void reset(const DepthBuffer &depth, int tileSize);
+	bool tileOccluded(int tx, int ty, float zNear);
+	bool blockOccluded(int bx, int by, float zNear);
+	// Depths in the block (and so in its tile) may have changed.
+	void touchBlock(int bx, int by);
+
+private:
+	void refreshBlock(int bx, int by);
+	template<class T>
+	float blockMax(const T *values, int x0, int x1, int y0, int y1) const;
+
+	const DepthBuffer *depth;
+	int width;
+	int height;
+	int tileBlocks; // blocks per tile side
+	int blocksX;
+	int blocksY;
+	int tilesX;
+	std::vector<float> blockFar;
+	std::vector<unsigned char> blockDirty;
+	std::vector<float> tileFar;
+	std::vector<unsigned char> tileDirty;
+};
+
+#endif
@@ -59,3 +59,20 @@ void Image::writeToFile(const string &filename)
 		cout << "Couldn't write to " << filename << endl;
 	}
 }
+
+void Image::writeToFile(const string &filename, PngLevel level, int nThreads)
+{
+	writeToFile(filename, ImageFormat::Png, level, nThreads);
+}
+
+void Image::writeToFile(const string &filename, ImageFormat format, PngLevel level, int nThreads)
+{
+	int stride_in_bytes = width*comp*sizeof(unsigned char);
+	bool rc = writeImage(filename, format, width, height, comp, &pixels[0], stride_in_bytes, level, nThreads);
+	ostream &log = filename == "-" ? cerr : cout;
+	if(rc) {
+		log << "Wrote to " << filename << endl;
+	} else {
+		log << "Couldn't write to " << filename << endl;
+	}
+}
@@ -5,6 +5,8 @@
 #include <string>
 #include <vector>
 
+#include "ImageWriter.h"
+
 class Image
 {
 public:
@@ -12,6 +14,12 @@ public:
 	virtual ~Image();
 	void setPixel(int x, int y, unsigned char r, unsigned char g, unsigned char b);
 	void writeToFile(const std::string &filename);
+	// Same, with a choice of PNG encoder (see PngWriter.h)
+	void writeToFile(const std::string &filename, PngLevel level, int nThreads = 0);
+	// In any format (see ImageWriter.h). "-" writes to stdout, and the
+	// message then goes to stderr.
+	void writeToFile(const std::string &filename, ImageFormat format,
+		PngLevel level = PngLevel::Stb, int nThreads = 0);
 	int getWidth() const { return width; }
 	int getHeight() const { return height; }
 
@@ -0,0 +1,104 @@
+#include "ImageEncoder.h"
+
+#include <algorithm>
+
+#include "ThreadPool.h"
+
+using namespace std;
+
+ImageEncoder::ImageEncoder(int nThreads, int maxQueued, PngLevel level) :
+	level(level),
+	busy(0),
+	stopping(false)
+{
+	if(nThreads <= 0) {
+		nThreads = max(1, ThreadPool::defaultThreadCount() / 2);
+	}
+	this->maxQueued = maxQueued > 0 ? maxQueued : 2 * nThreads;
+	// Enough for every image that can be in flight
+	maxFree = this->maxQueued + nThreads;
+	// The hardware threads shared out between the encoders
+	bandThreads = max(1, ThreadPool::defaultThreadCount() / nThreads);
+	for(int i = 0; i < nThreads; i++) {
+		threads.emplace_back(&ImageEncoder::encoderLoop, this);
+	}
+}
+
+ImageEncoder::~ImageEncoder()
+{
+	{
+		lock_guard<mutex> lock(mtx);
+		stopping = true;
+	}
+	queued.notify_all();
+	for(auto &t : threads) {
+		t.join();
+	}
+}
+
+void ImageEncoder::submit(const string &filename, ImageFormat format, int width, int height,
+	vector<unsigned char> &pixels, const Callback &done)
+{
+	Task task;
+	task.filename = filename;
+	task.format = format;
+	task.width = width;
+	task.height = height;
+	task.pixels.swap(pixels);
+	task.done = done;
+	{
+		unique_lock<mutex> lock(mtx);
+		dequeued.wait(lock, [this] { return queue.size() < maxQueued; });
+		queue.push_back(move(task));
+	}
+	queued.notify_one();
+}
+
+void ImageEncoder::recycle(vector<unsigned char> &pixels)
+{
+	lock_guard<mutex> lock(mtx);
+	if(!freeBuffers.empty()) {
+		pixels.swap(freeBuffers.back());
+		freeBuffers.pop_back();
+	}
+}
+
+void ImageEncoder::finish()
+{
+	unique_lock<mutex> lock(mtx);
+	dequeued.wait(lock, [this] { return queue.empty() && busy == 0; });
+}
+
+void ImageEncoder::encoderLoop()
+{
+	for(;;) {
+		Task task;
+		{
+			unique_lock<mutex> lock(mtx);
+			// Whatever is queued still gets written when stopping
+			queued.wait(lock, [this] { return stopping || !queue.empty(); });
+			if(queue.empty()) {
+				return;
+			}
+			task = move(queue.front());
+			queue.pop_front();
+			busy++;
+		}
+		dequeued.notify_all();
+
+		bool written = writeImage(task.filename, task.format, task.width, task.height, 3,
+			task.pixels.data(), task.width * 3, level, bandThreads);
+		if(task.done) {
+			task.done(written);
+		}
+
+		{
+			lock_guard<mutex> lock(mtx);
+			busy--;
+			if(freeBuffers.size() < maxFree) {
+				freeBuffers.push_back(move(task.pixels));
+			}
+		}
+		dequeued.notify_all();
+	}
+}
@@ -0,0 +1,80 @@
+#pragma once
+#ifndef _IMAGEENCODER_H_
+#define _IMAGEENCODER_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ImageWriter.h"
+
+/**
+ * Background image output stage. Finished framebuffers are handed over
+ * with submit() and encoded and written on encoder threads while the caller
+ * goes on rendering the next image. The files are exactly what writeImage
+ * writes when called directly. PNGs at a level other than Stb are also split
+ * over a few threads of their own, so that one large image does not have to
+ * wait on a single encoder.
+ *
+ * At most maxQueued images wait for an encoder; submit() blocks while the
+ * queue is full, so a renderer that outpaces the encoders is held back
+ * instead of piling up framebuffers. Buffers whose image has been written
+ * are kept and handed out again by recycle(), so a steady stream of frames
+ * does not allocate.
+ */
+class ImageEncoder
+{
+public:
+	// Called on an encoder thread once the image is written (or failed to be)
+	typedef std::function<void(bool written)> Callback;
+
+	// nThreads encoder threads (<= 0: half the hardware threads, at least
+	// one), maxQueued images waiting (<= 0: twice the threads).
+	ImageEncoder(int nThreads = 0, int maxQueued = 0, PngLevel level = PngLevel::Stb);
+	// Finishes everything still queued.
+	virtual ~ImageEncoder();
+	int getThreadCount() const { return (int)threads.size(); }
+	// Queues pixels (RGB8, first row at the top) to be written in format.
+	// pixels is taken over and left empty.
+	void submit(const std::string &filename, ImageFormat format, int width, int height,
+		std::vector<unsigned char> &pixels, const Callback &done = Callback());
+	// Swaps a buffer from an already written image into pixels, if there is
+	// one, so its storage gets reused. The contents are unspecified.
+	void recycle(std::vector<unsigned char> &pixels);
+	// Waits until every submitted image has been written.
+	void finish();
+
+private:
+	ImageEncoder(const ImageEncoder &) = delete;
+	ImageEncoder &operator=(const ImageEncoder &) = delete;
+
+	struct Task {
+		std::string filename;
+		ImageFormat format;
+		int width;
+		int height;
+		std::vector<unsigned char> pixels;
+		Callback done;
+	};
+
+	void encoderLoop();
+
+	std::vector<std::thread> threads;
+	size_t maxQueued;
+	size_t maxFree; // spare buffers kept for recycle()
+	PngLevel level;
+	int bandThreads; // threads per image for the parallel encoder
+	std::mutex mtx;
+	std::condition_variable queued;  // a task arrived, or stopping
+	std::condition_variable dequeued; // room in the queue, or a task finished
+	std::deque<Task> queue;
+	std::vector<std::vector<unsigned char> > freeBuffers;
+	int busy; // tasks taken off the queue and not finished yet
+	bool stopping;
+};
+
+#endif
@@ -0,0 +1,309 @@
+#include "ImageWriter.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+// Whole images at a time on stdout
+mutex stdoutMutex;
+
+bool hasSuffix(const string &s, const string &suffix)
+{
+	return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+void putLE(vector<unsigned char> &out, uint32_t v, int bytes)
+{
+	for(int i = 0; i < bytes; i++) {
+		out.push_back((unsigned char)(v >> (8 * i)));
+	}
+}
+
+void putBE32(vector<unsigned char> &out, uint32_t v)
+{
+	out.push_back((unsigned char)(v >> 24));
+	out.push_back((unsigned char)(v >> 16));
+	out.push_back((unsigned char)(v >> 8));
+	out.push_back((unsigned char)v);
+}
+
+void putText(vector<unsigned char> &out, const string &text)
+{
+	out.insert(out.end(), text.begin(), text.end());
+}
+
+// Whether the format stores the rows exactly as they are after its header
+bool rowsAsTheyAre(ImageFormat format, int comp)
+{
+	switch(format) {
+	case ImageFormat::Ppm:
+		return comp == 1 || comp == 3;
+	case ImageFormat::Pam:
+	case ImageFormat::Raw:
+	case ImageFormat::Rgb:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// The header of the formats that have a plain one
+void writeHeader(vector<unsigned char> &out, ImageFormat format, int width, int height, int comp)
+{
+	static const char *const TUPLE_TYPE[5] = { "", "GRAYSCALE", "GRAYSCALE_ALPHA", "RGB", "RGB_ALPHA" };
+	string size = to_string(width) + " " + to_string(height);
+	switch(format) {
+	case ImageFormat::Ppm:
+		putText(out, (comp < 3 ? "P5\n" : "P6\n") + size + "\n255\n");
+		break;
+	case ImageFormat::Pam:
+		putText(out, "P7\nWIDTH " + to_string(width) + "\nHEIGHT " + to_string(height) +
+			"\nDEPTH " + to_string(comp) + "\nMAXVAL 255\nTUPLTYPE " + TUPLE_TYPE[comp] + "\nENDHDR\n");
+		break;
+	case ImageFormat::Raw:
+	case ImageFormat::Float:
+		putText(out, "A1PX");
+		putLE(out, (uint32_t)width, 4);
+		putLE(out, (uint32_t)height, 4);
+		putLE(out, (uint32_t)comp, 2);
+		putLE(out, format == ImageFormat::Float ? 4 : 1, 2);
+		break;
+	default:
+		break;
+	}
+}
+
+// QOI as in the specification at qoiformat.org. Gray images are written as
+// RGB, since QOI has nothing smaller.
+void encodeQoi(vector<unsigned char> &out, int width, int height, int comp,
+	const unsigned char *pixels, int stride)
+{
+	const unsigned char OP_INDEX = 0x00, OP_DIFF = 0x40, OP_LUMA = 0x80, OP_RUN = 0xC0;
+	const unsigned char OP_RGB = 0xFE, OP_RGBA = 0xFF;
+	bool alpha = comp == 2 || comp == 4;
+	// Worst case is one OP_RGBA per pixel
+	out.reserve(out.size() + 14 + (size_t)width * height * (alpha ? 5 : 4) + 8);
+	putText(out, "qoif");
+	putBE32(out, (uint32_t)width);
+	putBE32(out, (uint32_t)height);
+	out.push_back(alpha ? 4 : 3);
+	out.push_back(0); // sRGB with linear alpha
+
+	// Pixels are packed as r | g << 8 | b << 16 | a << 24
+	uint32_t index[64] = {};
+	uint32_t prev = 0xFF000000u;
+	int run = 0;
+	for(int y = 0; y < height; y++) {
+		const unsigned char *row = pixels + (size_t)y * stride;
+		for(int x = 0; x < width; x++) {
+			const unsigned char *p = row + x * comp;
+			uint32_t r = p[0], g = comp >= 3 ? p[1] : p[0], b = comp >= 3 ? p[2] : p[0];
+			uint32_t a = alpha ? p[comp - 1] : 255;
+			uint32_t px = r | g << 8 | b << 16 | a << 24;
+			if(px == prev) {
+				if(++run == 62) {
+					out.push_back(OP_RUN | (run - 1));
+					run = 0;
+				}
+				continue;
+			}
+			if(run > 0) {
+				out.push_back(OP_RUN | (run - 1));
+				run = 0;
+			}
+			int slot = (r * 3 + g * 5 + b * 7 + a * 11) % 64;
+			if(index[slot] == px) {
+				out.push_back(OP_INDEX | slot);
+			} else {
+				index[slot] = px;
+				if(a == prev >> 24) {
+					int dr = (signed char)(r - (prev & 0xFF));
+					int dg = (signed char)(g - (prev >> 8 & 0xFF));
+					int db = (signed char)(b - (prev >> 16 & 0xFF));
+					int drg = dr - dg, dbg = db - dg;
+					if(dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+						out.push_back(OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+					} else if(dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 && dbg >= -8 && dbg <= 7) {
+						out.push_back(OP_LUMA | (dg + 32));
+						out.push_back((unsigned char)((drg + 8) << 4 | (dbg + 8)));
+					} else {
+						out.insert(out.end(), { OP_RGB, (unsigned char)r, (unsigned char)g, (unsigned char)b });
+					}
+				} else {
+					out.insert(out.end(), { OP_RGBA, (unsigned char)r, (unsigned char)g, (unsigned char)b, (unsigned char)a });
+				}
+			}
+			prev = px;
+		}
+	}
+	if(run > 0) {
+		out.push_back(OP_RUN | (run - 1));
+	}
+	out.insert(out.end(), { 0, 0, 0, 0, 0, 0, 0, 1 });
+}
+
+// Opens the output, or hands back stdout (switched to binary) for "-"
+FILE *openOutput(const string &filename)
+{
+	if(filename == "-") {
+#ifdef _WIN32
+		_setmode(_fileno(stdout), _O_BINARY);
+#endif
+		return stdout;
+	}
+	return fopen(filename.c_str(), "wb");
+}
+
+bool closeOutput(FILE *f, bool ok)
+{
+	if(f == stdout) {
+		return fflush(f) == 0 && ok;
+	}
+	return fclose(f) == 0 && ok;
+}
+
+}
+
+bool parseImageFormat(const string &name, ImageFormat &format)
+{
+	if(name == "png") {
+		format = ImageFormat::Png;
+	} else if(name == "ppm") {
+		format = ImageFormat::Ppm;
+	} else if(name == "pam") {
+		format = ImageFormat::Pam;
+	} else if(name == "qoi") {
+		format = ImageFormat::Qoi;
+	} else if(name == "raw") {
+		format = ImageFormat::Raw;
+	} else if(name == "float") {
+		format = ImageFormat::Float;
+	} else if(name == "rgb") {
+		format = ImageFormat::Rgb;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+ImageFormat formatFromFilename(const string &filename)
+{
+	if(hasSuffix(filename, ".ppm") || hasSuffix(filename, ".pgm")) {
+		return ImageFormat::Ppm;
+	} else if(hasSuffix(filename, ".pam")) {
+		return ImageFormat::Pam;
+	} else if(hasSuffix(filename, ".qoi")) {
+		return ImageFormat::Qoi;
+	} else if(hasSuffix(filename, ".raw")) {
+		return ImageFormat::Raw;
+	} else if(hasSuffix(filename, ".f32")) {
+		return ImageFormat::Float;
+	} else if(hasSuffix(filename, ".rgb")) {
+		return ImageFormat::Rgb;
+	}
+	return ImageFormat::Png;
+}
+
+void encodeImage(vector<unsigned char> &out, ImageFormat format, int width, int height,
+	int comp, const unsigned char *pixels, int stride, PngLevel level, int nThreads)
+{
+	out.clear();
+	size_t rowBytes = (size_t)width * comp;
+	switch(format) {
+	case ImageFormat::Png:
+		encodePng(out, width, height, comp, pixels, stride, level, nThreads);
+		break;
+	case ImageFormat::Qoi:
+		encodeQoi(out, width, height, comp, pixels, stride);
+		break;
+	case ImageFormat::Float:
+	{
+		writeHeader(out, format, width, height, comp);
+		size_t at = out.size();
+		out.resize(at + rowBytes * height * 4);
+		unsigned char *dst = out.data() + at;
+		for(int y = 0; y < height; y++) {
+			const unsigned char *row = pixels + (size_t)y * stride;
+			for(size_t i = 0; i < rowBytes; i++, dst += 4) {
+				float f = row[i] / 255.0f;
+				uint32_t bits;
+				memcpy(&bits, &f, sizeof(bits));
+				dst[0] = (unsigned char)bits;
+				dst[1] = (unsigned char)(bits >> 8);
+				dst[2] = (unsigned char)(bits >> 16);
+				dst[3] = (unsigned char)(bits >> 24);
+			}
+		}
+		break;
+	}
+	default:
+		writeHeader(out, format, width, height, comp);
+		if(rowsAsTheyAre(format, comp)) {
+			out.reserve(out.size() + rowBytes * height);
+			for(int y = 0; y < height; y++) {
+				const unsigned char *row = pixels + (size_t)y * stride;
+				out.insert(out.end(), row, row + rowBytes);
+			}
+		} else {
+			// PPM of an image with alpha: the color only
+			int colors = comp - 1;
+			for(int y = 0; y < height; y++) {
+				const unsigned char *row = pixels + (size_t)y * stride;
+				for(int x = 0; x < width; x++) {
+					out.insert(out.end(), row + x * comp, row + x * comp + colors);
+				}
+			}
+		}
+		break;
+	}
+}
+
+bool writeImage(const string &filename, ImageFormat format, int width, int height,
+	int comp, const unsigned char *pixels, int stride, PngLevel level, int nThreads)
+{
+	bool toStdout = filename == "-";
+	if(format == ImageFormat::Png && !toStdout) {
+		return writePng(filename, width, height, comp, pixels, stride, level, nThreads);
+	}
+
+	// Formats that keep the rows as they are get them written straight from
+	// pixels, the rest are encoded first.
+	vector<unsigned char> data;
+	bool direct = rowsAsTheyAre(format, comp);
+	if(direct) {
+		writeHeader(data, format, width, height, comp);
+	} else {
+		encodeImage(data, format, width, height, comp, pixels, stride, level, nThreads);
+	}
+
+	unique_lock<mutex> lock(stdoutMutex, defer_lock);
+	if(toStdout) {
+		lock.lock();
+	}
+	FILE *f = openOutput(filename);
+	if(!f) {
+		return false;
+	}
+	bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+	if(direct) {
+		size_t rowBytes = (size_t)width * comp;
+		if(stride == (int)rowBytes) {
+			ok = ok && fwrite(pixels, 1, rowBytes * height, f) == rowBytes * height;
+		} else {
+			for(int y = 0; y < height && ok; y++) {
+				ok = fwrite(pixels + (size_t)y * stride, 1, rowBytes, f) == rowBytes;
+			}
+		}
+	}
+	return closeOutput(f, ok);
+}
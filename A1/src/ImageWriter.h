@@ -0,0 +1,52 @@
+#pragma once
+#ifndef _IMAGEWRITER_H_
+#define _IMAGEWRITER_H_
+
+#include <string>
+#include <vector>
+
+#include "PngWriter.h"
+
+/**
+ * The formats an image can be written in. Only Png compresses with deflate;
+ * the rest are for handing frames to another program that is going to
+ * decode them straight away anyway.
+ *
+ *   Png    PNG, compressed at a PngLevel (see PngWriter.h)
+ *   Ppm    binary PPM (P6), or PGM (P5) for one component. Alpha is dropped.
+ *   Pam    PAM (P7) with the matching TUPLTYPE, alpha included
+ *   Qoi    QOI, lossless and several times quicker to write than a PNG
+ *   Raw    the pixels as bytes after a 16 byte header (below)
+ *   Float  the same with every component a float from 0 to 1
+ *   Rgb    the pixels with no header at all, as a raw video frame
+ *
+ * The Raw and Float header is the magic "A1PX" followed by the width and
+ * height as 32 bit and the number of components and the bytes per component
+ * (1 or 4) as 16 bit integers, all little endian. Rows follow top to bottom
+ * with no padding; floats are little endian too.
+ */
+enum class ImageFormat { Png, Ppm, Pam, Qoi, Raw, Float, Rgb };
+
+// Accepts "png", "ppm", "pam", "qoi", "raw", "float" and "rgb". Returns
+// false on anything else.
+bool parseImageFormat(const std::string &name, ImageFormat &format);
+
+// The format a file name's extension asks for: .ppm and .pgm, .pam, .qoi,
+// .raw, .f32 and .rgb. Anything else, "-" included, is a PNG.
+ImageFormat formatFromFilename(const std::string &filename);
+
+// Encodes an image into out. pixels has comp (1 to 4) bytes per pixel, rows
+// stride bytes apart, the first row at the top. level and nThreads only
+// matter for Png.
+void encodeImage(std::vector<unsigned char> &out, ImageFormat format, int width, int height,
+	int comp, const unsigned char *pixels, int stride, PngLevel level = PngLevel::Stb,
+	int nThreads = 0);
+
+// Encodes and writes the image to a file, or to stdout if filename is "-".
+// Images written to stdout by several threads at once come out whole, one
+// after the other. Returns false if the image cannot be written.
+bool writeImage(const std::string &filename, ImageFormat format, int width, int height,
+	int comp, const unsigned char *pixels, int stride, PngLevel level = PngLevel::Stb,
+	int nThreads = 0);
+
+#endif
@@ -0,0 +1,76 @@
+#include "MappedFile.h"
+
+#include <fstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+MappedFile::MappedFile() :
+	bytes(nullptr),
+	length(0),
+	mapped(false)
+{
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::open(const string &filename)
+{
+	close();
+#ifndef _WIN32
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if(fd < 0) {
+		return false;
+	}
+	struct stat st;
+	if(fstat(fd, &st) != 0 || st.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+	void *p = mmap(nullptr, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if(p == MAP_FAILED) {
+		return false;
+	}
+	bytes = static_cast<char *>(p);
+	length = (size_t)st.st_size;
+	mapped = true;
+	return true;
+#else
+	ifstream in(filename.c_str(), ios::binary | ios::ate);
+	if(!in || in.tellg() <= 0) {
+		return false;
+	}
+	buffer.resize((size_t)in.tellg());
+	in.seekg(0);
+	if(!in.read(buffer.data(), buffer.size())) {
+		buffer.clear();
+		return false;
+	}
+	bytes = buffer.data();
+	length = buffer.size();
+	return true;
+#endif
+}
+
+void MappedFile::close()
+{
+#ifndef _WIN32
+	if(mapped) {
+		munmap(bytes, length);
+	}
+#endif
+	vector<char>().swap(buffer);
+	bytes = nullptr;
+	length = 0;
+	mapped = false;
+}
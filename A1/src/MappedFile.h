@@ -0,0 +1,37 @@
+#pragma once
+#ifndef _MAPPEDFILE_H_
+#define _MAPPEDFILE_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * A whole file mapped into memory, copy on write: the contents can be
+ * modified in place without the changes ever reaching the file. Where mmap
+ * is not available the file is read into memory instead, so callers see the
+ * same thing either way.
+ */
+class MappedFile
+{
+public:
+	MappedFile();
+	virtual ~MappedFile();
+	// Returns false if the file cannot be opened or mapped.
+	bool open(const std::string &filename);
+	char *data() { return bytes; }
+	const char *data() const { return bytes; }
+	size_t size() const { return length; }
+
+private:
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+	void close();
+
+	char *bytes;
+	size_t length;
+	bool mapped;
+	std::vector<char> buffer; // used instead of a mapping on Windows
+};
+
+#endif
@@ -0,0 +1,145 @@
+#include "Mesh.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+using namespace std;
+
+// Bits of a float, so that -0 and 0 stay apart and NaNs still match themselves
+static uint32_t floatBits(float f)
+{
+	uint32_t bits;
+	memcpy(&bits, &f, sizeof(bits));
+	return bits;
+}
+
+Mesh::Mesh() :
+	lookup(0, VertexHash{ this }, VertexEqual{ this }),
+	px(nullptr), py(nullptr), pz(nullptr),
+	pnx(nullptr), pny(nullptr), pnz(nullptr),
+	pindices(nullptr),
+	nVerts(0),
+	nIndices(0),
+	boundsMin{ 0.0f, 0.0f, 0.0f },
+	boundsMax{ 0.0f, 0.0f, 0.0f }
+{
+}
+
+Mesh::~Mesh()
+{
+}
+
+void Mesh::addCorner(const Vertex &v)
+{
+	// Store the vertex tentatively so the lookup can compare against it,
+	// and take it back out if an identical one is already there.
+	uint32_t index = (uint32_t)x.size();
+	x.push_back(v.x);
+	y.push_back(v.y);
+	z.push_back(v.z);
+	nx.push_back(v.nx);
+	ny.push_back(v.ny);
+	nz.push_back(v.nz);
+	auto it = lookup.insert(index);
+	if(!it.second) {
+		x.pop_back();
+		y.pop_back();
+		z.pop_back();
+		nx.pop_back();
+		ny.pop_back();
+		nz.pop_back();
+		index = *it.first;
+	}
+	indices.push_back(index);
+}
+
+void Mesh::reserve(size_t vertexCount, size_t cornerCount)
+{
+	x.reserve(vertexCount);
+	y.reserve(vertexCount);
+	z.reserve(vertexCount);
+	nx.reserve(vertexCount);
+	ny.reserve(vertexCount);
+	nz.reserve(vertexCount);
+	indices.reserve(cornerCount);
+	lookup.reserve(vertexCount);
+}
+
+void Mesh::finishLoading()
+{
+	unordered_set<uint32_t, VertexHash, VertexEqual>(0, VertexHash{ this }, VertexEqual{ this }).swap(lookup);
+	x.shrink_to_fit();
+	y.shrink_to_fit();
+	z.shrink_to_fit();
+	nx.shrink_to_fit();
+	ny.shrink_to_fit();
+	nz.shrink_to_fit();
+	indices.shrink_to_fit();
+	px = x.data();
+	py = y.data();
+	pz = z.data();
+	pnx = nx.data();
+	pny = ny.data();
+	pnz = nz.data();
+	pindices = indices.data();
+	nVerts = x.size();
+	nIndices = indices.size();
+}
+
+void Mesh::computeBounds()
+{
+	const float *components[3] = { px, py, pz };
+	for(int c = 0; c < 3; c++) {
+		boundsMin[c] = numeric_limits<float>::max();
+		boundsMax[c] = numeric_limits<float>::lowest();
+		for(size_t i = 0; i < nVerts; i++) {
+			boundsMin[c] = min(boundsMin[c], components[c][i]);
+			boundsMax[c] = max(boundsMax[c], components[c][i]);
+		}
+	}
+}
+
+void Mesh::setExternal(shared_ptr<void> owner, float *const components[6],
+	const uint32_t *indices, size_t vertexCount, size_t indexCount,
+	const float boundsMin[3], const float boundsMax[3])
+{
+	this->owner = owner;
+	px = components[0];
+	py = components[1];
+	pz = components[2];
+	pnx = components[3];
+	pny = components[4];
+	pnz = components[5];
+	pindices = indices;
+	nVerts = vertexCount;
+	nIndices = indexCount;
+	for(int c = 0; c < 3; c++) {
+		this->boundsMin[c] = boundsMin[c];
+		this->boundsMax[c] = boundsMax[c];
+	}
+}
+
+size_t Mesh::VertexHash::operator()(uint32_t v) const
+{
+	// Runs while loading, before the accessors are set up
+	const float *components[6] = { mesh->x.data(), mesh->y.data(), mesh->z.data(),
+		mesh->nx.data(), mesh->ny.data(), mesh->nz.data() };
+	uint64_t h = 14695981039346656037ull;
+	for(int i = 0; i < 6; i++) {
+		h = (h ^ floatBits(components[i][v])) * 1099511628211ull;
+	}
+	return (size_t)h;
+}
+
+bool Mesh::VertexEqual::operator()(uint32_t a, uint32_t b) const
+{
+	const float *components[6] = { mesh->x.data(), mesh->y.data(), mesh->z.data(),
+		mesh->nx.data(), mesh->ny.data(), mesh->nz.data() };
+	for(int i = 0; i < 6; i++) {
+		if(floatBits(components[i][a]) != floatBits(components[i][b])) {
+			return false;
+		}
+	}
+	return true;
+}
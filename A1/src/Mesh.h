@@ -0,0 +1,105 @@
+#pragma once
+#ifndef _MESH_H_
+#define _MESH_H_
+
+#include <cstdint>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+#include "AlignedAllocator.h"
+#include "Vertex.h"
+
+/**
+ * Indexed triangle mesh. Every distinct position/normal pair is stored once
+ * and triangles refer to their corners through a uint32_t index buffer, three
+ * indices per triangle. This lets per-vertex work (the task 8 rotation,
+ * projection) run once per unique vertex instead of once per triangle corner.
+ *
+ * Vertices are kept as a structure of arrays: one 64 byte aligned array per
+ * component (x, y, z, nx, ny, nz), so a pass that only needs positions
+ * streams through exactly the data it uses. This is the only copy of the
+ * geometry the program keeps.
+ *
+ * The arrays are either built by addCorner and owned by the mesh, or handed
+ * over ready made with setExternal (a memory mapped mesh cache) and used in
+ * place. Accessors only work once finishLoading or setExternal has run.
+ */
+class Mesh
+{
+public:
+	typedef std::vector<float, AlignedAllocator<float, 64> > FloatArray;
+
+	Mesh();
+	virtual ~Mesh();
+	// Appends one triangle corner. A vertex that is bitwise identical to one
+	// already in the mesh is shared instead of stored again.
+	void addCorner(const Vertex &v);
+	// Makes room for this many unique vertices and triangle corners.
+	void reserve(size_t vertexCount, size_t cornerCount);
+	// Frees the lookup table used by addCorner once loading is done.
+	void finishLoading();
+	// Sets the bounds from the vertices. Loaders call it after
+	// finishLoading.
+	void computeBounds();
+	// Uses arrays that live elsewhere instead of the mesh's own: components
+	// holds x, y, z, nx, ny, nz with vertexCount floats each. owner keeps them
+	// alive for as long as the mesh needs them.
+	void setExternal(std::shared_ptr<void> owner, float *const components[6],
+		const uint32_t *indices, size_t vertexCount, size_t indexCount,
+		const float boundsMin[3], const float boundsMax[3]);
+	int getVertexCount() const { return (int)nVerts; }
+	int getTriangleCount() const { return (int)(nIndices / 3); }
+	size_t getIndexCount() const { return nIndices; }
+	// Three vertex indices per triangle
+	const uint32_t *getIndices() const { return pindices; }
+	// Component arrays, getVertexCount() floats each
+	float *getX() { return px; }
+	float *getY() { return py; }
+	float *getZ() { return pz; }
+	float *getNX() { return pnx; }
+	float *getNY() { return pny; }
+	float *getNZ() { return pnz; }
+	const float *getX() const { return px; }
+	const float *getY() const { return py; }
+	const float *getZ() const { return pz; }
+	const float *getNX() const { return pnx; }
+	const float *getNY() const { return pny; }
+	const float *getNZ() const { return pnz; }
+	// Smallest and largest x, y and z of the vertices as loaded. Changing
+	// the vertices afterwards does not update them.
+	const float *getBoundsMin() const { return boundsMin; }
+	const float *getBoundsMax() const { return boundsMax; }
+
+private:
+	// The lookup refers back to the arrays of this mesh
+	Mesh(const Mesh &) = delete;
+	Mesh &operator=(const Mesh &) = delete;
+
+	// Hash and equality of vertex indices by the bits of their components
+	struct VertexHash {
+		const Mesh *mesh;
+		size_t operator()(uint32_t v) const;
+	};
+	struct VertexEqual {
+		const Mesh *mesh;
+		bool operator()(uint32_t a, uint32_t b) const;
+	};
+
+	FloatArray x, y, z;
+	FloatArray nx, ny, nz;
+	std::vector<uint32_t> indices;
+	std::unordered_set<uint32_t, VertexHash, VertexEqual> lookup;
+
+	// What the accessors return: the arrays above or external ones
+	float *px, *py, *pz;
+	float *pnx, *pny, *pnz;
+	const uint32_t *pindices;
+	size_t nVerts;
+	size_t nIndices;
+	float boundsMin[3];
+	float boundsMax[3];
+	std::shared_ptr<void> owner;
+};
+
+#endif
@@ -0,0 +1,203 @@
+#include "MeshCache.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+
+#include "MappedFile.h"
+#include "Mesh.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace {
+
+const char CACHE_MAGIC[8] = { 'A', '1', 'M', 'E', 'S', 'H', '\0', '\0' };
+const uint32_t CACHE_VERSION = 1;
+// Reads back as something else on a machine with the other byte order
+const uint32_t CACHE_BYTE_ORDER = 0x01020304;
+const uint64_t CACHE_ALIGNMENT = 64;
+// x, y, z, nx, ny, nz, indices
+const int CACHE_ARRAYS = 7;
+
+struct CacheHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t byteOrder;
+	uint64_t vertexCount;
+	uint64_t indexCount;
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	uint64_t pathHash;
+	float boundsMin[3];
+	float boundsMax[3];
+	uint64_t offsets[CACHE_ARRAYS];
+};
+
+string cacheName(const string &objName)
+{
+	return objName + ".meshcache";
+}
+
+uint64_t alignUp(uint64_t n)
+{
+	return (n + CACHE_ALIGNMENT - 1) / CACHE_ALIGNMENT * CACHE_ALIGNMENT;
+}
+
+// FNV-1a of the absolute path of the source file
+uint64_t hashPath(const string &objName)
+{
+	error_code ec;
+	string path = fs::absolute(objName, ec).lexically_normal().string();
+	if(ec) {
+		path = objName;
+	}
+	uint64_t h = 14695981039346656037ull;
+	for(char c : path) {
+		h = (h ^ (unsigned char)c) * 1099511628211ull;
+	}
+	return h;
+}
+
+// Size and modification time of the source file
+bool sourceStamp(const string &objName, uint64_t &size, int64_t &time)
+{
+	error_code ec;
+	size = fs::file_size(objName, ec);
+	if(ec) {
+		return false;
+	}
+	auto t = fs::last_write_time(objName, ec);
+	if(ec) {
+		return false;
+	}
+	time = (int64_t)t.time_since_epoch().count();
+	return true;
+}
+
+// Bytes of array k, for a mesh with this many vertices and indices
+uint64_t arrayBytes(int k, uint64_t vertexCount, uint64_t indexCount)
+{
+	return k < 6 ? vertexCount * sizeof(float) : indexCount * sizeof(uint32_t);
+}
+
+}
+
+bool loadMeshCache(const string &objName, Mesh &mesh)
+{
+	uint64_t size;
+	int64_t time;
+	if(!sourceStamp(objName, size, time)) {
+		return false;
+	}
+	shared_ptr<MappedFile> file = make_shared<MappedFile>();
+	if(!file->open(cacheName(objName)) || file->size() < sizeof(CacheHeader)) {
+		return false;
+	}
+	CacheHeader header;
+	memcpy(&header, file->data(), sizeof(header));
+	if(memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+		header.version != CACHE_VERSION ||
+		header.byteOrder != CACHE_BYTE_ORDER ||
+		header.sourceSize != size ||
+		header.sourceTime != time ||
+		header.pathHash != hashPath(objName) ||
+		header.vertexCount > UINT32_MAX ||
+		header.indexCount % 3 != 0) {
+		return false;
+	}
+	// Every array has to be aligned and lie completely inside the file
+	for(int k = 0; k < CACHE_ARRAYS; k++) {
+		uint64_t offset = header.offsets[k];
+		uint64_t bytes = arrayBytes(k, header.vertexCount, header.indexCount);
+		if(offset % CACHE_ALIGNMENT != 0 || offset > file->size() || bytes > file->size() - offset) {
+			return false;
+		}
+	}
+	float *components[6];
+	for(int k = 0; k < 6; k++) {
+		components[k] = reinterpret_cast<float *>(file->data() + header.offsets[k]);
+	}
+	const uint32_t *indices = reinterpret_cast<const uint32_t *>(file->data() + header.offsets[6]);
+	// The rasterizer indexes the vertex arrays with these unchecked, so a
+	// damaged index makes the whole cache a miss
+	uint32_t maxIndex = 0;
+	for(uint64_t i = 0; i < header.indexCount; i++) {
+		maxIndex = max(maxIndex, indices[i]);
+	}
+	if(header.indexCount > 0 && maxIndex >= header.vertexCount) {
+		return false;
+	}
+	mesh.setExternal(file, components, indices, header.vertexCount, header.indexCount,
+		header.boundsMin, header.boundsMax);
+	return true;
+}
+
+bool saveMeshCache(const string &objName, const Mesh &mesh)
+{
+	CacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	header.version = CACHE_VERSION;
+	header.byteOrder = CACHE_BYTE_ORDER;
+	header.vertexCount = mesh.getVertexCount();
+	header.indexCount = mesh.getIndexCount();
+	if(!sourceStamp(objName, header.sourceSize, header.sourceTime)) {
+		return false;
+	}
+	header.pathHash = hashPath(objName);
+	for(int c = 0; c < 3; c++) {
+		header.boundsMin[c] = mesh.getBoundsMin()[c];
+		header.boundsMax[c] = mesh.getBoundsMax()[c];
+	}
+	const char *arrays[CACHE_ARRAYS] = {
+		reinterpret_cast<const char *>(mesh.getX()),
+		reinterpret_cast<const char *>(mesh.getY()),
+		reinterpret_cast<const char *>(mesh.getZ()),
+		reinterpret_cast<const char *>(mesh.getNX()),
+		reinterpret_cast<const char *>(mesh.getNY()),
+		reinterpret_cast<const char *>(mesh.getNZ()),
+		reinterpret_cast<const char *>(mesh.getIndices()),
+	};
+	uint64_t offset = alignUp(sizeof(header));
+	for(int k = 0; k < CACHE_ARRAYS; k++) {
+		header.offsets[k] = offset;
+		offset = alignUp(offset + arrayBytes(k, header.vertexCount, header.indexCount));
+	}
+
+	string name = cacheName(objName);
+	string tmpName = name + ".tmp";
+	error_code ec;
+	{
+		ofstream out(tmpName.c_str(), ios::binary | ios::trunc);
+		if(!out) {
+			return false;
+		}
+		const char padding[CACHE_ALIGNMENT] = {};
+		uint64_t written = 0;
+		out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		written += sizeof(header);
+		for(int k = 0; k < CACHE_ARRAYS; k++) {
+			out.write(padding, header.offsets[k] - written);
+			uint64_t bytes = arrayBytes(k, header.vertexCount, header.indexCount);
+			if(bytes > 0) {
+				out.write(arrays[k], bytes);
+			}
+			written = header.offsets[k] + bytes;
+		}
+		if(!out) {
+			out.close();
+			fs::remove(tmpName, ec);
+			return false;
+		}
+	}
+	fs::rename(tmpName, name, ec);
+	if(ec) {
+		fs::remove(tmpName, ec);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#ifndef _MESHCACHE_H_
+#define _MESHCACHE_H_
+
+#include <string>
+
+class Mesh;
+
+/**
+ * Binary sidecar cache of a loaded mesh, stored next to the OBJ file as
+ * <file>.meshcache. It holds a header, the six vertex component arrays and
+ * the index buffer, each starting on a 64 byte boundary, and the bounds of
+ * the vertices, so a cached mesh is memory mapped and used in place with no
+ * parsing, deduplication or bounds pass.
+ *
+ * A cache only counts if it was written on a machine with the same byte
+ * order, for the same source path, and the source file still has the size
+ * and modification time it had then, and only if every index refers to one
+ * of its vertices. Anything else is a miss and the OBJ is loaded as usual.
+ */
+
+// Returns true and points mesh at the mapped cache of objName if there is a
+// valid one. The mapping stays alive as long as the mesh does and is copy on
+// write, so the mesh can still be modified in place.
+bool loadMeshCache(const std::string &objName, Mesh &mesh);
+// Writes the cache for mesh, loaded from objName. The file is written under
+// a temporary name and renamed into place, so readers never see half a
+// cache. Returns false if it could not be written (read only directory, ...).
+bool saveMeshCache(const std::string &objName, const Mesh &mesh);
+
+#endif
@@ -0,0 +1,374 @@
+#include "MeshGenerator.h"
+#include "Mesh.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// Vertex and index arrays under construction. The mesh keeps them alive
+// through setExternal once they are done.
+struct MeshArrays {
+	Mesh::FloatArray components[6];
+	vector<uint32_t> indices;
+
+	void reserve(size_t vertexCount, size_t triangleCount)
+	{
+		for(auto &c : components) {
+			c.reserve(vertexCount);
+		}
+		indices.reserve(3 * triangleCount);
+	}
+	uint32_t vertex(float x, float y, float z, float nx, float ny, float nz)
+	{
+		uint32_t index = (uint32_t)components[0].size();
+		const float v[6] = { x, y, z, nx, ny, nz };
+		for(int c = 0; c < 6; c++) {
+			components[c].push_back(v[c]);
+		}
+		return index;
+	}
+	void triangle(uint32_t a, uint32_t b, uint32_t c)
+	{
+		indices.push_back(a);
+		indices.push_back(b);
+		indices.push_back(c);
+	}
+};
+
+// splitmix64, which gives the same sequence everywhere, unlike the
+// distributions of <random>
+struct Random {
+	uint64_t state;
+
+	uint64_t next()
+	{
+		uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+		return z ^ (z >> 31);
+	}
+	// Uniform in [lo, hi)
+	float uniform(float lo, float hi)
+	{
+		return lo + (hi - lo) * (float)(next() >> 40) * (1.0f / 16777216.0f);
+	}
+};
+
+void normalize(float &x, float &y, float &z)
+{
+	float len = sqrt(x * x + y * y + z * z);
+	if(len > 0.0f) {
+		x /= len;
+		y /= len;
+		z /= len;
+	}
+}
+
+// Icosahedron with counter-clockwise faces seen from outside
+const float PHI = 1.6180339887f;
+const float ICOSAHEDRON_VERTICES[12][3] = {
+	{ -1, PHI, 0 }, { 1, PHI, 0 }, { -1, -PHI, 0 }, { 1, -PHI, 0 },
+	{ 0, -1, PHI }, { 0, 1, PHI }, { 0, -1, -PHI }, { 0, 1, -PHI },
+	{ PHI, 0, -1 }, { PHI, 0, 1 }, { -PHI, 0, -1 }, { -PHI, 0, 1 }
+};
+const int ICOSAHEDRON_FACES[20][3] = {
+	{ 0, 11, 5 }, { 0, 5, 1 }, { 0, 1, 7 }, { 0, 7, 10 }, { 0, 10, 11 },
+	{ 1, 5, 9 }, { 5, 11, 4 }, { 11, 10, 2 }, { 10, 7, 6 }, { 7, 1, 8 },
+	{ 3, 9, 4 }, { 3, 4, 2 }, { 3, 2, 6 }, { 3, 6, 8 }, { 3, 8, 9 },
+	{ 4, 9, 5 }, { 2, 4, 11 }, { 6, 2, 10 }, { 8, 6, 7 }, { 9, 8, 1 }
+};
+
+// Each face gets its own (f + 1)(f + 2)/2 vertices, so vertices along the
+// original edges exist twice; that keeps every face a simple loop.
+void buildSphere(long long triangles, MeshArrays &a)
+{
+	long long f = max(1LL, llround(sqrt(triangles / 20.0)));
+	a.reserve((size_t)(20 * (f + 1) * (f + 2) / 2), (size_t)(20 * f * f));
+	vector<uint32_t> row((size_t)(f + 1) * (f + 2) / 2);
+	for(const auto &face : ICOSAHEDRON_FACES) {
+		const float *A = ICOSAHEDRON_VERTICES[face[0]];
+		const float *B = ICOSAHEDRON_VERTICES[face[1]];
+		const float *C = ICOSAHEDRON_VERTICES[face[2]];
+		// Point (i, j) is A + i/f (B - A) + j/f (C - A), for i + j <= f
+		auto at = [f](long long i, long long j) { return (size_t)(i * (2 * f + 3 - i) / 2 + j); };
+		for(long long i = 0; i <= f; i++) {
+			for(long long j = 0; i + j <= f; j++) {
+				float u = (float)i / f, v = (float)j / f;
+				float x = A[0] + u * (B[0] - A[0]) + v * (C[0] - A[0]);
+				float y = A[1] + u * (B[1] - A[1]) + v * (C[1] - A[1]);
+				float z = A[2] + u * (B[2] - A[2]) + v * (C[2] - A[2]);
+				normalize(x, y, z);
+				row[at(i, j)] = a.vertex(x, y, z, x, y, z);
+			}
+		}
+		// Both kinds of small triangle keep the winding of the face
+		for(long long i = 0; i < f; i++) {
+			for(long long j = 0; i + j < f; j++) {
+				a.triangle(row[at(i, j)], row[at(i + 1, j)], row[at(i, j + 1)]);
+				if(i + j + 1 < f) {
+					a.triangle(row[at(i + 1, j)], row[at(i + 1, j + 1)], row[at(i, j + 1)]);
+				}
+			}
+		}
+	}
+}
+
+// An n x n quad grid over [-1, 1]^2 at depth z, facing +z
+void buildGrid(long long n, float z, MeshArrays &a)
+{
+	uint32_t first = (uint32_t)a.components[0].size();
+	for(long long r = 0; r <= n; r++) {
+		float y = -1.0f + 2.0f * r / n;
+		for(long long c = 0; c <= n; c++) {
+			a.vertex(-1.0f + 2.0f * c / n, y, z, 0.0f, 0.0f, 1.0f);
+		}
+	}
+	uint32_t stride = (uint32_t)(n + 1);
+	for(uint32_t r = 0; r < (uint32_t)n; r++) {
+		for(uint32_t c = 0; c < (uint32_t)n; c++) {
+			uint32_t v = first + r * stride + c;
+			a.triangle(v, v + 1, v + stride + 1);
+			a.triangle(v, v + stride + 1, v + stride);
+		}
+	}
+}
+
+void buildSoup(const StressSpec &spec, MeshArrays &a)
+{
+	a.reserve((size_t)(3 * spec.triangles), (size_t)spec.triangles);
+	Random random = { spec.seed };
+	float half = 0.5f * spec.size;
+	for(long long t = 0; t < spec.triangles; t++) {
+		// Centres stay far enough inside for the corners to fit the cube
+		float cx = random.uniform(-1.0f + half, 1.0f - half);
+		float cy = random.uniform(-1.0f + half, 1.0f - half);
+		float cz = random.uniform(-1.0f + half, 1.0f - half);
+		float p[3][3];
+		for(auto &corner : p) {
+			corner[0] = cx + random.uniform(-half, half);
+			corner[1] = cy + random.uniform(-half, half);
+			corner[2] = cz + random.uniform(-half, half);
+		}
+		float ux = p[1][0] - p[0][0], uy = p[1][1] - p[0][1], uz = p[1][2] - p[0][2];
+		float vx = p[2][0] - p[0][0], vy = p[2][1] - p[0][1], vz = p[2][2] - p[0][2];
+		float nx = uy * vz - uz * vy, ny = uz * vx - ux * vz, nz = ux * vy - uy * vx;
+		normalize(nx, ny, nz);
+		uint32_t v0 = a.vertex(p[0][0], p[0][1], p[0][2], nx, ny, nz);
+		uint32_t v1 = a.vertex(p[1][0], p[1][1], p[1][2], nx, ny, nz);
+		uint32_t v2 = a.vertex(p[2][0], p[2][1], p[2][2], nx, ny, nz);
+		a.triangle(v0, v1, v2);
+	}
+}
+
+// Quads per side of a grid of about this many triangles
+long long gridSide(long long triangles)
+{
+	return max(1LL, llround(sqrt(triangles / 2.0)));
+}
+
+// Vertex and triangle counts of what spec generates, to check them before
+// allocating anything
+void countStress(const StressSpec &spec, long long &vertices, long long &triangles)
+{
+	switch(spec.shape) {
+	case StressShape::Sphere: {
+		long long f = max(1LL, llround(sqrt(spec.triangles / 20.0)));
+		vertices = 20 * (f + 1) * (f + 2) / 2;
+		triangles = 20 * f * f;
+		break;
+	}
+	case StressShape::Grid: {
+		long long n = gridSide(spec.triangles);
+		vertices = (n + 1) * (n + 1);
+		triangles = 2 * n * n;
+		break;
+	}
+	case StressShape::Soup:
+		vertices = 3 * spec.triangles;
+		triangles = spec.triangles;
+		break;
+	case StressShape::Stack: {
+		long long n = gridSide(spec.triangles / spec.layers);
+		vertices = spec.layers * (n + 1) * (n + 1);
+		triangles = spec.layers * 2 * n * n;
+		break;
+	}
+	}
+}
+
+// A count with an optional k, M or G suffix
+bool parseCount(const string &s, long long &count)
+{
+	char *end = nullptr;
+	double value = strtod(s.c_str(), &end);
+	if(end == s.c_str()) {
+		return false;
+	}
+	string suffix(end);
+	if(suffix == "k" || suffix == "K") {
+		value *= 1e3;
+	} else if(suffix == "M") {
+		value *= 1e6;
+	} else if(suffix == "G") {
+		value *= 1e9;
+	} else if(!suffix.empty()) {
+		return false;
+	}
+	count = llround(value);
+	return value >= 1.0 && value < 1e15;
+}
+
+// Whole of s as a decimal number without sign, like the seed
+bool parseUnsigned(const string &s, uint64_t &value)
+{
+	if(s.empty() || !isdigit((unsigned char)s[0])) {
+		return false;
+	}
+	char *end = nullptr;
+	errno = 0;
+	value = strtoull(s.c_str(), &end, 10);
+	return *end == '\0' && errno == 0;
+}
+
+// Whole of s as a number, like the soup size
+bool parseReal(const string &s, float &value)
+{
+	char *end = nullptr;
+	value = (float)strtod(s.c_str(), &end);
+	return end != s.c_str() && *end == '\0';
+}
+
+}
+
+bool parseStressShape(const string &name, StressShape &shape)
+{
+	if(name == "sphere") {
+		shape = StressShape::Sphere;
+	} else if(name == "grid") {
+		shape = StressShape::Grid;
+	} else if(name == "soup") {
+		shape = StressShape::Soup;
+	} else if(name == "stack") {
+		shape = StressShape::Stack;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+StressSpec defaultStressSpec(StressShape shape, long long triangles)
+{
+	StressSpec spec;
+	spec.shape = shape;
+	spec.triangles = triangles;
+	spec.seed = 1;
+	spec.size = 0.02f;
+	spec.layers = 8;
+	spec.nearFirst = false;
+	return spec;
+}
+
+bool isStressMeshName(const string &name)
+{
+	return name.compare(0, 4, "gen:") == 0;
+}
+
+bool parseStressMeshName(const string &name, StressSpec &spec, string &err)
+{
+	vector<string> fields;
+	stringstream ss(name);
+	string field;
+	while(getline(ss, field, ':')) {
+		fields.push_back(field);
+	}
+	StressShape shape;
+	long long triangles = 0;
+	if(fields.size() < 3 || fields[0] != "gen" || !parseStressShape(fields[1], shape) ||
+		!parseCount(fields[2], triangles)) {
+		err = "Bad generated mesh " + name + " (use gen:sphere|grid|soup|stack:<triangles>[:key=value...])";
+		return false;
+	}
+	spec = defaultStressSpec(shape, triangles);
+	for(size_t i = 3; i < fields.size(); i++) {
+		size_t eq = fields[i].find('=');
+		string key = fields[i].substr(0, eq);
+		string value = eq == string::npos ? "" : fields[i].substr(eq + 1);
+		bool ok = !value.empty();
+		if(key == "seed") {
+			ok = parseUnsigned(value, spec.seed);
+		} else if(key == "size") {
+			ok = parseReal(value, spec.size) && spec.size > 0.0f && spec.size <= 2.0f;
+		} else if(key == "layers") {
+			uint64_t layers = 0;
+			ok = parseUnsigned(value, layers) && layers > 0 && layers <= INT_MAX;
+			spec.layers = (int)layers;
+		} else if(key == "order") {
+			spec.nearFirst = value == "near";
+			ok = value == "near" || value == "far";
+		} else {
+			ok = false;
+		}
+		if(!ok) {
+			err = "Bad option " + fields[i] + " of generated mesh " + name +
+				" (use seed=N, size=0..2, layers=N or order=far|near)";
+			return false;
+		}
+	}
+	return true;
+}
+
+bool generateStressMesh(const StressSpec &spec, Mesh &mesh, string &err)
+{
+	long long vertices = 0, triangles = 0;
+	countStress(spec, vertices, triangles);
+	if(vertices > (long long)UINT32_MAX || triangles > (long long)INT_MAX / 3) {
+		err = "Generated mesh too large: " + to_string(triangles) + " triangles, " +
+			to_string(vertices) + " vertices";
+		return false;
+	}
+
+	shared_ptr<MeshArrays> arrays = make_shared<MeshArrays>();
+	MeshArrays &a = *arrays;
+	switch(spec.shape) {
+	case StressShape::Sphere:
+		buildSphere(spec.triangles, a);
+		break;
+	case StressShape::Grid:
+		a.reserve((size_t)vertices, (size_t)triangles);
+		buildGrid(gridSide(spec.triangles), 0.0f, a);
+		break;
+	case StressShape::Soup:
+		buildSoup(spec, a);
+		break;
+	case StressShape::Stack: {
+		// Smaller z is nearer
+		a.reserve((size_t)vertices, (size_t)triangles);
+		long long n = gridSide(spec.triangles / spec.layers);
+		for(int l = 0; l < spec.layers; l++) {
+			float t = spec.layers > 1 ? (float)l / (spec.layers - 1) : 0.5f;
+			buildGrid(n, spec.nearFirst ? -1.0f + 2.0f * t : 1.0f - 2.0f * t, a);
+		}
+		break;
+	}
+	}
+
+	float *components[6];
+	for(int c = 0; c < 6; c++) {
+		components[c] = a.components[c].data();
+	}
+	const float noBounds[3] = { 0.0f, 0.0f, 0.0f };
+	mesh.setExternal(arrays, components, a.indices.data(), a.components[0].size(), a.indices.size(),
+		noBounds, noBounds);
+	mesh.computeBounds();
+	return true;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#ifndef _MESHGENERATOR_H_
+#define _MESHGENERATOR_H_
+
+#include <cstdint>
+#include <string>
+
+class Mesh;
+
+/**
+ * Procedural meshes of any size, for measuring how loading, culling and
+ * rasterization scale with the triangle count. All of them fit in the
+ * [-1, 1] cube, so the renderer frames them the same way at every size.
+ *
+ *   Sphere  a geodesic sphere: an icosahedron whose faces are subdivided
+ *           into f^2 triangles each and pushed out onto the unit sphere.
+ *           Closed, so back face culling drops about half of it.
+ *   Grid    a flat square of quads split into two triangles each, facing
+ *           the viewer. With --fixed-point (top-left rule) every pixel it
+ *           covers is covered once; the default float edge test can count
+ *           a pixel that lies on an edge two triangles share twice.
+ *   Soup    unconnected triangles of random shape and winding, size wide,
+ *           scattered over the whole cube. Three vertices per triangle.
+ *   Stack   layers grids on top of each other, so every pixel is covered
+ *           layers times as often as by one grid. They come far to near
+ *           (each layer passes the depth test again) unless nearFirst is
+ *           set (all but the first layer fail it).
+ *
+ * The triangle count is rounded to the nearest one the shape can make.
+ * Random shapes only depend on the seed, on every platform.
+ */
+enum class StressShape { Sphere, Grid, Soup, Stack };
+
+// Accepts "sphere", "grid", "soup" and "stack". Returns false on anything else.
+bool parseStressShape(const std::string &name, StressShape &shape);
+
+struct StressSpec {
+	StressShape shape;
+	long long triangles;
+	uint64_t seed;
+	float size;  // triangle size of a soup, as a fraction of the cube
+	int layers;  // of a stack
+	bool nearFirst;
+};
+
+// A spec with the defaults for shape: seed 1, size 0.02, 8 layers, far first.
+StressSpec defaultStressSpec(StressShape shape, long long triangles);
+
+// Mesh names of the form gen:<shape>:<triangles>[:key=value...] stand for a
+// generated mesh wherever a mesh file name is accepted. The count takes a
+// k, M or G suffix, and the keys are seed, size, layers and order (far or
+// near), e.g. gen:soup:10M:size=0.005:seed=7.
+bool isStressMeshName(const std::string &name);
+// Returns false and sets err if name is not a valid gen: name.
+bool parseStressMeshName(const std::string &name, StressSpec &spec, std::string &err);
+
+// Fills mesh with the generated triangles, indexed and with its bounds.
+// The arrays are built in place and handed over with Mesh::setExternal, so
+// no vertex goes through the de-duplication of addCorner. Returns false
+// and sets err if the mesh would have more vertices than 32 bit indices
+// can address.
+bool generateStressMesh(const StressSpec &spec, Mesh &mesh, std::string &err);
+
+#endif
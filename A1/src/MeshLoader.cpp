@@ -0,0 +1,283 @@
+#include "MeshLoader.h"
+#include "Mesh.h"
+#include "MeshCache.h"
+#include "MeshGenerator.h"
+
+#include <fstream>
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "tiny_obj_loader.h"
+
+using namespace std;
+
+namespace {
+
+// Element counts of an OBJ file. Only used to size buffers, so lines the
+// scan misreads (leading whitespace, say) just cost a reallocation.
+struct ObjCounts {
+	size_t positions;
+	size_t normals;
+	size_t corners; // triangle corners after splitting polygons into fans
+};
+
+void countObj(istream &in, ObjCounts &counts)
+{
+	counts = ObjCounts();
+	char buf[1 << 16];
+	size_t col = 0;
+	char c0 = 0, c1 = 0;
+	bool face = false, inToken = false;
+	size_t tokens = 0;
+	auto endLine = [&]() {
+		if(face && tokens >= 3) {
+			counts.corners += 3 * (tokens - 2);
+		}
+		col = 0;
+		face = inToken = false;
+		tokens = 0;
+	};
+	while(in) {
+		in.read(buf, sizeof(buf));
+		streamsize n = in.gcount();
+		for(streamsize i = 0; i < n; i++) {
+			char ch = buf[i];
+			if(ch == '\n') {
+				endLine();
+				continue;
+			}
+			bool space = ch == ' ' || ch == '\t' || ch == '\r';
+			if(col == 0) {
+				c0 = ch;
+			} else if(col == 1) {
+				c1 = ch;
+				if(c0 == 'v' && space) {
+					counts.positions++;
+				} else if(c0 == 'f' && space) {
+					face = true;
+				}
+			} else if(col == 2 && c0 == 'v' && c1 == 'n' && space) {
+				counts.normals++;
+			} else if(face) {
+				if(!space && !inToken) {
+					tokens++;
+				}
+				inToken = !space;
+			}
+			col++;
+		}
+	}
+	endLine();
+}
+
+// OBJ indices count from 1, negative ones from the end of the list so far,
+// and 0 means the index is missing. Returns -1 for missing or out of range.
+int resolveIndex(int index, size_t count)
+{
+	long long i = index > 0 ? index - 1 : (long long)count + index;
+	return (index != 0 && i >= 0 && i < (long long)count) ? (int)i : -1;
+}
+
+struct StreamState {
+	Mesh *mesh;
+	vector<float> positions;
+	vector<float> normals;
+	size_t badFaces;
+};
+
+void vertexCallback(void *user, tinyobj::real_t x, tinyobj::real_t y, tinyobj::real_t z, tinyobj::real_t)
+{
+	vector<float> &p = static_cast<StreamState *>(user)->positions;
+	p.push_back(x);
+	p.push_back(y);
+	p.push_back(z);
+}
+
+void normalCallback(void *user, tinyobj::real_t x, tinyobj::real_t y, tinyobj::real_t z)
+{
+	vector<float> &n = static_cast<StreamState *>(user)->normals;
+	n.push_back(x);
+	n.push_back(y);
+	n.push_back(z);
+}
+
+void indexCallback(void *user, tinyobj::index_t *indices, int count)
+{
+	StreamState &state = *static_cast<StreamState *>(user);
+	if(count < 3) {
+		state.badFaces++;
+		return;
+	}
+	for(int k = 0; k < count; k++) {
+		if(resolveIndex(indices[k].vertex_index, state.positions.size() / 3) < 0) {
+			state.badFaces++;
+			return;
+		}
+	}
+	Vertex corners[3];
+	for(int k = 0; k < count; k++) {
+		int v = resolveIndex(indices[k].vertex_index, state.positions.size() / 3);
+		int n = resolveIndex(indices[k].normal_index, state.normals.size() / 3);
+		// Fan: corner 0 stays, the other two slide along the polygon
+		Vertex &corner = corners[k < 2 ? k : 2];
+		if(k >= 3) {
+			corners[1] = corners[2];
+		}
+		corner = {};
+		corner.x = state.positions[3*v + 0];
+		corner.y = state.positions[3*v + 1];
+		corner.z = state.positions[3*v + 2];
+		if(n >= 0) {
+			corner.nx = state.normals[3*n + 0];
+			corner.ny = state.normals[3*n + 1];
+			corner.nz = state.normals[3*n + 2];
+		}
+		if(k >= 2) {
+			state.mesh->addCorner(corners[0]);
+			state.mesh->addCorner(corners[1]);
+			state.mesh->addCorner(corners[2]);
+		}
+	}
+}
+
+}
+
+// Last step of both OBJ paths, once every corner is in the mesh
+static void finishMesh(Mesh &mesh, Stopwatch &timer, LoadStats &stats)
+{
+	mesh.finishLoading();
+	stats.deindex += timer.lap();
+	mesh.computeBounds();
+	stats.bounds += timer.lap();
+}
+
+// Both OBJ paths skip the same faces and say so in the same words
+static void warnSkippedFaces(size_t count, string &warn)
+{
+	if(count > 0) {
+		warn += "Skipped " + to_string(count) + " faces with missing or invalid vertex indices\n";
+	}
+}
+
+// The parallel path: parse everything into tinyobj's arrays first, then
+// gather the corners into the mesh.
+static bool loadObjMeshParallel(const string &filename, Mesh &mesh, string &warn, string &err,
+	int nThreads, LoadStats &stats)
+{
+	Stopwatch timer;
+	tinyobj::attrib_t attrib;
+	vector<tinyobj::shape_t> shapes;
+	size_t skipped = 0;
+	if(!tinyobj::LoadObjParallel(&attrib, &shapes, &warn, &err, filename.c_str(), true, nThreads, &skipped)) {
+		return false;
+	}
+	warnSkippedFaces(skipped, warn);
+	stats.parse += timer.lap();
+	size_t corners = 0;
+	for(const auto &shape : shapes) {
+		corners += shape.mesh.indices.size();
+	}
+	mesh.reserve(attrib.vertices.size() / 3, corners);
+	for(const auto &shape : shapes) {
+		for(const tinyobj::index_t &idx : shape.mesh.indices) {
+			Vertex corner = {};
+			corner.x = attrib.vertices[3*idx.vertex_index + 0];
+			corner.y = attrib.vertices[3*idx.vertex_index + 1];
+			corner.z = attrib.vertices[3*idx.vertex_index + 2];
+			if(idx.normal_index >= 0) {
+				corner.nx = attrib.normals[3*idx.normal_index + 0];
+				corner.ny = attrib.normals[3*idx.normal_index + 1];
+				corner.nz = attrib.normals[3*idx.normal_index + 2];
+			}
+			mesh.addCorner(corner);
+		}
+	}
+	finishMesh(mesh, timer, stats);
+	return true;
+}
+
+// The streaming path: faces go into the mesh as they are parsed.
+static bool loadObjMeshStreaming(const string &filename, Mesh &mesh, string &warn, string &err,
+	LoadStats &stats)
+{
+	Stopwatch timer;
+	ifstream in(filename.c_str(), ios::binary);
+	if(!in) {
+		err = "Cannot open file [" + filename + "]";
+		return false;
+	}
+	ObjCounts counts;
+	countObj(in, counts);
+	in.clear();
+	in.seekg(0);
+
+	StreamState state;
+	state.mesh = &mesh;
+	state.positions.reserve(3 * counts.positions);
+	state.normals.reserve(3 * counts.normals);
+	state.badFaces = 0;
+	// Shared vertices are the rule, so a unique vertex per position is the
+	// usual case.
+	mesh.reserve(counts.positions, counts.corners);
+
+	tinyobj::callback_t callback;
+	callback.vertex_cb = vertexCallback;
+	callback.normal_cb = normalCallback;
+	callback.index_cb = indexCallback;
+	bool rc = tinyobj::LoadObjWithCallback(in, callback, &state, NULL, &warn, &err);
+	warnSkippedFaces(state.badFaces, warn);
+	stats.parse += timer.lap();
+	finishMesh(mesh, timer, stats);
+	return rc;
+}
+
+bool loadObjFile(const string &filename, Mesh &mesh, string &warn, string &err, bool parallel,
+	int nThreads, LoadStats *stats)
+{
+	LoadStats local = LoadStats();
+	LoadStats &s = stats ? *stats : local;
+	if(parallel) {
+		return loadObjMeshParallel(filename, mesh, warn, err, nThreads, s);
+	}
+	return loadObjMeshStreaming(filename, mesh, warn, err, s);
+}
+
+bool loadObjMesh(const string &filename, Mesh &mesh, string &warn, string &err, int nThreads,
+	bool useCache, LoadStats *stats)
+{
+	LoadStats local;
+	LoadStats &s = stats ? *stats : local;
+	s = LoadStats();
+	Stopwatch timer;
+	if(isStressMeshName(filename)) {
+		StressSpec spec;
+		if(!parseStressMeshName(filename, spec, err) || !generateStressMesh(spec, mesh, err)) {
+			return false;
+		}
+		s.parse = timer.lap();
+		return true;
+	}
+	if(useCache && loadMeshCache(filename, mesh)) {
+		s.parse = timer.lap();
+		s.fromCache = true;
+		return true;
+	}
+	ifstream in(filename.c_str(), ios::binary | ios::ate);
+	if(!in) {
+		err = "Cannot open file [" + filename + "]";
+		return false;
+	}
+	bool parallel = (size_t)in.tellg() >= PARALLEL_LOAD_BYTES;
+	in.close();
+	// A stale or missing cache still cost a look
+	s.parse = timer.lap();
+	if(!loadObjFile(filename, mesh, warn, err, parallel, nThreads, &s)) {
+		return false;
+	}
+	if(useCache) {
+		timer.restart();
+		// Best effort: without a cache the next run just parses again
+		saveMeshCache(filename, mesh);
+		s.cacheWrite = timer.lap();
+	}
+	return true;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#ifndef _MESHLOADER_H_
+#define _MESHLOADER_H_
+
+#include <cstddef>
+#include <string>
+
+#include "Stopwatch.h"
+
+class Mesh;
+
+/**
+ * Where the time of one loadObjMesh went. parse is reading the file (or
+ * mapping the cache), deindex is merging identical corners into shared
+ * vertices and bounds is computing the mesh bounds. The streaming path
+ * de-indexes each face as it is parsed, so its deindex only holds the final
+ * cleanup and the rest is part of parse. A mesh from the cache comes
+ * de-indexed and with its bounds, and only has parse; so does a generated
+ * mesh, for the whole of its generation.
+ */
+struct LoadStats {
+	StageTime parse;
+	StageTime deindex;
+	StageTime bounds;
+	StageTime cacheWrite;
+	bool fromCache;
+};
+
+// Files at least this big are parsed on several threads.
+const size_t PARALLEL_LOAD_BYTES = 16 << 20;
+
+// Loads the OBJ file into mesh. Polygons are split into triangle fans.
+// Small files are streamed straight into the mesh in a single parsing pass,
+// using the callback interface of tiny_obj_loader: no intermediate attrib_t
+// or shape_t is built, only the raw position and normal lists are kept until
+// the faces that index them have been read, and a quick scan of the file
+// first counts its elements so that every buffer is sized once up front.
+// Files of PARALLEL_LOAD_BYTES or more are memory mapped and parsed on
+// nThreads threads (<= 0: one per hardware thread) with LoadObjParallel
+// instead. Returns false and sets err if the file cannot be read; warnings
+// (faces skipped for bad indices, ...) go to warn.
+// With useCache the mesh comes from the file's .meshcache sidecar instead
+// when that is still valid (see MeshCache.h), and a successful OBJ load
+// writes a new one. Names starting with gen: are generated in memory
+// instead (see MeshGenerator.h). stats, if given, receives the stage times.
+bool loadObjMesh(const std::string &filename, Mesh &mesh, std::string &warn, std::string &err,
+	int nThreads = 0, bool useCache = true, LoadStats *stats = nullptr);
+
+// The OBJ part of loadObjMesh, on the parallel path if parallel is set and
+// on the streaming one otherwise, whatever the size of the file. Both give
+// the same mesh and skip the same faces. stats, if given, receives the
+// stage times on top of what it holds.
+bool loadObjFile(const std::string &filename, Mesh &mesh, std::string &warn, std::string &err,
+	bool parallel, int nThreads = 0, LoadStats *stats = nullptr);
+
+#endif
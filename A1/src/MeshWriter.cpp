@@ -0,0 +1,107 @@
+#include "MeshWriter.h"
+#include "Mesh.h"
+
+#include <charconv>
+#include <cstdio>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// Output goes through a large buffer; the files can run to gigabytes.
+struct ObjBuffer {
+	FILE *file;
+	vector<char> data;
+	size_t used;
+	bool failed;
+
+	void flush()
+	{
+		if(used > 0 && fwrite(data.data(), 1, used, file) != used) {
+			failed = true;
+		}
+		used = 0;
+	}
+	// Room for one line of any kind
+	char *reserve()
+	{
+		if(data.size() - used < 256) {
+			flush();
+		}
+		return data.data() + used;
+	}
+};
+
+char *writeFloat(char *p, float v)
+{
+#if defined(__cpp_lib_to_chars)
+	return to_chars(p, p + 32, v).ptr;
+#else
+	return p + snprintf(p, 32, "%.9g", v);
+#endif
+}
+
+char *writeIndex(char *p, uint32_t v)
+{
+	return to_chars(p, p + 16, v).ptr;
+}
+
+// "<tag> x y z\n"
+void writeTriple(ObjBuffer &out, const char *tag, float x, float y, float z)
+{
+	char *p = out.reserve(), *start = p;
+	while(*tag) {
+		*p++ = *tag++;
+	}
+	const float v[3] = { x, y, z };
+	for(float c : v) {
+		*p++ = ' ';
+		p = writeFloat(p, c);
+	}
+	*p++ = '\n';
+	out.used += p - start;
+}
+
+}
+
+bool writeObjMesh(const string &filename, const Mesh &mesh, string &err)
+{
+	FILE *file = fopen(filename.c_str(), "wb");
+	if(!file) {
+		err = "Cannot write file [" + filename + "]";
+		return false;
+	}
+	ObjBuffer out = { file, vector<char>(1 << 20), 0, false };
+	int nVerts = mesh.getVertexCount();
+	const float *x = mesh.getX(), *y = mesh.getY(), *z = mesh.getZ();
+	const float *nx = mesh.getNX(), *ny = mesh.getNY(), *nz = mesh.getNZ();
+	for(int v = 0; v < nVerts; v++) {
+		writeTriple(out, "v", x[v], y[v], z[v]);
+	}
+	for(int v = 0; v < nVerts; v++) {
+		writeTriple(out, "vn", nx[v], ny[v], nz[v]);
+	}
+	const uint32_t *indices = mesh.getIndices();
+	for(size_t i = 0; i < mesh.getIndexCount(); i += 3) {
+		char *p = out.reserve(), *start = p;
+		*p++ = 'f';
+		for(int k = 0; k < 3; k++) {
+			// OBJ indices count from 1
+			uint32_t index = indices[i + k] + 1;
+			*p++ = ' ';
+			p = writeIndex(p, index);
+			*p++ = '/';
+			*p++ = '/';
+			p = writeIndex(p, index);
+		}
+		*p++ = '\n';
+		out.used += p - start;
+	}
+	out.flush();
+	if(fclose(file) != 0 || out.failed) {
+		err = "Failed writing file [" + filename + "]";
+		return false;
+	}
+	return true;
+}
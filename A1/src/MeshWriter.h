@@ -0,0 +1,16 @@
+#pragma once
+#ifndef _MESHWRITER_H_
+#define _MESHWRITER_H_
+
+#include <string>
+
+class Mesh;
+
+// Writes mesh as an OBJ file: one v and one vn line per unique vertex and
+// one f line per triangle, with the normal index equal to the vertex index.
+// Floats are written with the fewest digits that read back to the same
+// value, so loading the file gives the same vertices again. Returns false
+// and sets err if the file cannot be written.
+bool writeObjMesh(const std::string &filename, const Mesh &mesh, std::string &err);
+
+#endif
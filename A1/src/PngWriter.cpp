@@ -0,0 +1,776 @@
+#include "PngWriter.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <queue>
+
+#include "stb_image_write.h"
+
+#include "ThreadPool.h"
+
+using namespace std;
+
+namespace {
+
+// Filtered bytes per band. Small enough to spread an image over many
+// threads, big enough that restarting the Huffman statistics and the band
+// alignment cost next to nothing.
+const size_t BAND_BYTES = 256 << 10;
+const size_t WINDOW_SIZE = 32768;
+const int MIN_MATCH = 3;
+const int MAX_MATCH = 258;
+// Length 3 matches further back than this cost more than three literals
+const size_t TOO_FAR = 4096;
+const int HASH_BITS = 15;
+// Tokens per deflate block
+const size_t BLOCK_TOKENS = 16384;
+
+const int LENGTH_BASE[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+const int LENGTH_EXTRA[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+const int DIST_BASE[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+const int DIST_EXTRA[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+// Order the code length code lengths are sent in
+const int CLEN_ORDER[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+// Match search effort of a level
+struct SearchParams {
+	int maxChain; // hash chain entries tried per position
+	bool lazy;    // look one byte ahead for a longer match
+	int goodEnough; // stop searching at this length
+	int maxInsert;  // positions inside longer matches are not hashed
+};
+
+// Symbol tables built once: the length code of every match length and the
+// distance code of every distance.
+struct CodeTables {
+	unsigned char lengthCode[MAX_MATCH + 1];
+	unsigned char distCode[WINDOW_SIZE + 1];
+	uint32_t crc[256];
+
+	CodeTables()
+	{
+		for(int c = 0; c < 29; c++) {
+			int end = c + 1 < 29 ? LENGTH_BASE[c + 1] : MAX_MATCH + 1;
+			for(int len = LENGTH_BASE[c]; len < end; len++) {
+				lengthCode[len] = (unsigned char)c;
+			}
+		}
+		// Length 258 has its own code rather than being 227 + 31
+		lengthCode[MAX_MATCH] = 28;
+		for(int c = 0; c < 30; c++) {
+			int end = c + 1 < 30 ? DIST_BASE[c + 1] : (int)WINDOW_SIZE + 1;
+			for(int d = DIST_BASE[c]; d < end; d++) {
+				distCode[d] = (unsigned char)c;
+			}
+		}
+		for(uint32_t n = 0; n < 256; n++) {
+			uint32_t c = n;
+			for(int k = 0; k < 8; k++) {
+				c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			}
+			crc[n] = c;
+		}
+	}
+};
+
+const CodeTables &tables()
+{
+	static const CodeTables t;
+	return t;
+}
+
+uint32_t crc32(uint32_t crc, const unsigned char *data, size_t n)
+{
+	const uint32_t *table = tables().crc;
+	crc = ~crc;
+	for(size_t i = 0; i < n; i++) {
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+const uint32_t ADLER_BASE = 65521;
+
+uint32_t adler32(const unsigned char *data, size_t n)
+{
+	uint32_t a = 1, b = 0;
+	while(n > 0) {
+		// The largest run whose sums cannot overflow before the modulo
+		size_t run = min(n, (size_t)5552);
+		for(size_t i = 0; i < run; i++) {
+			a += data[i];
+			b += a;
+		}
+		a %= ADLER_BASE;
+		b %= ADLER_BASE;
+		data += run;
+		n -= run;
+	}
+	return (b << 16) | a;
+}
+
+// Adler-32 of the concatenation of two pieces, the second len2 bytes long
+uint32_t adler32Combine(uint32_t adler1, uint32_t adler2, size_t len2)
+{
+	uint32_t rem = (uint32_t)(len2 % ADLER_BASE);
+	uint32_t sum1 = adler1 & 0xFFFF;
+	uint32_t sum2 = (uint32_t)(((uint64_t)rem * sum1) % ADLER_BASE);
+	sum1 += (adler2 & 0xFFFF) + ADLER_BASE - 1;
+	sum2 += (adler1 >> 16) + (adler2 >> 16) + ADLER_BASE - rem;
+	if(sum1 >= ADLER_BASE) sum1 -= ADLER_BASE;
+	if(sum1 >= ADLER_BASE) sum1 -= ADLER_BASE;
+	if(sum2 >= (ADLER_BASE << 1)) sum2 -= (ADLER_BASE << 1);
+	if(sum2 >= ADLER_BASE) sum2 -= ADLER_BASE;
+	return sum1 | (sum2 << 16);
+}
+
+// Deflate bits go out least significant bit first
+class BitWriter
+{
+public:
+	BitWriter(vector<unsigned char> &out) : out(out), bits(0), count(0) {}
+	void put(uint32_t value, int n)
+	{
+		bits |= (uint64_t)value << count;
+		count += n;
+		while(count >= 8) {
+			out.push_back((unsigned char)bits);
+			bits >>= 8;
+			count -= 8;
+		}
+	}
+	void align()
+	{
+		if(count > 0) {
+			put(0, 8 - count);
+		}
+	}
+	vector<unsigned char> &bytes() { return out; }
+
+private:
+	vector<unsigned char> &out;
+	uint64_t bits;
+	int count;
+};
+
+// Code lengths of at most maxBits for the symbol frequencies. At least two
+// symbols get a code, which keeps every decoder happy with the tree.
+void huffmanLengths(const uint32_t *freq, int n, int maxBits, unsigned char *lengths)
+{
+	vector<uint32_t> f(freq, freq + n);
+	int used = 0;
+	for(int i = 0; i < n; i++) {
+		used += f[i] > 0;
+	}
+	for(int i = 0; i < n && used < 2; i++) {
+		if(f[i] == 0) {
+			f[i] = 1;
+			used++;
+		}
+	}
+	for(;;) {
+		// Plain Huffman tree over the used symbols
+		struct Node { uint64_t weight; int index; };
+		auto heavier = [](const Node &a, const Node &b) {
+			return a.weight != b.weight ? a.weight > b.weight : a.index > b.index;
+		};
+		priority_queue<Node, vector<Node>, decltype(heavier)> heap(heavier);
+		vector<int> parent(2 * n, -1);
+		for(int i = 0; i < n; i++) {
+			if(f[i] > 0) {
+				heap.push({ f[i], i });
+			}
+		}
+		int next = n;
+		while(heap.size() > 1) {
+			Node a = heap.top();
+			heap.pop();
+			Node b = heap.top();
+			heap.pop();
+			parent[a.index] = next;
+			parent[b.index] = next;
+			heap.push({ a.weight + b.weight, next });
+			next++;
+		}
+		int longest = 0;
+		for(int i = 0; i < n; i++) {
+			int depth = 0;
+			if(f[i] > 0) {
+				for(int p = parent[i]; p >= 0; p = parent[p]) {
+					depth++;
+				}
+			}
+			lengths[i] = (unsigned char)depth;
+			longest = max(longest, depth);
+		}
+		if(longest <= maxBits) {
+			return;
+		}
+		// Too deep: flatten the statistics and try again
+		for(int i = 0; i < n; i++) {
+			if(f[i] > 0) {
+				f[i] = (f[i] >> 1) | 1;
+			}
+		}
+	}
+}
+
+// Canonical codes for the lengths, bit reversed for the LSB first writer
+void huffmanCodes(const unsigned char *lengths, int n, uint16_t *codes)
+{
+	int count[16] = {};
+	for(int i = 0; i < n; i++) {
+		count[lengths[i]]++;
+	}
+	count[0] = 0;
+	int next[16] = {};
+	int code = 0;
+	for(int bits = 1; bits < 16; bits++) {
+		code = (code + count[bits - 1]) << 1;
+		next[bits] = code;
+	}
+	for(int i = 0; i < n; i++) {
+		int len = lengths[i];
+		if(len == 0) {
+			codes[i] = 0;
+			continue;
+		}
+		int c = next[len]++;
+		int reversed = 0;
+		for(int k = 0; k < len; k++) {
+			reversed = (reversed << 1) | ((c >> k) & 1);
+		}
+		codes[i] = (uint16_t)reversed;
+	}
+}
+
+// Literal (dist == 0) or match
+struct Token {
+	uint16_t litLen;
+	uint16_t dist;
+};
+
+void writeStored(BitWriter &bw, const unsigned char *data, size_t n, bool final)
+{
+	do {
+		size_t len = min(n, (size_t)65535);
+		n -= len;
+		bw.put(final && n == 0 ? 1 : 0, 1);
+		bw.put(0, 2);
+		bw.align();
+		bw.put((uint32_t)len, 16);
+		bw.put((uint32_t)(~len & 0xFFFF), 16);
+		bw.bytes().insert(bw.bytes().end(), data, data + len);
+		data += len;
+	} while(n > 0);
+}
+
+// One block with its own Huffman codes, or stored if that is smaller.
+// raw is the input the tokens stand for.
+void writeBlock(BitWriter &bw, const Token *tokens, size_t nTokens,
+	const unsigned char *raw, size_t rawLen, bool final)
+{
+	const CodeTables &t = tables();
+	uint32_t litFreq[286] = {};
+	uint32_t distFreq[30] = {};
+	for(size_t i = 0; i < nTokens; i++) {
+		if(tokens[i].dist == 0) {
+			litFreq[tokens[i].litLen]++;
+		} else {
+			litFreq[257 + t.lengthCode[tokens[i].litLen]]++;
+			distFreq[t.distCode[tokens[i].dist]]++;
+		}
+	}
+	litFreq[256] = 1;
+
+	unsigned char litLen[286];
+	unsigned char distLen[30];
+	huffmanLengths(litFreq, 286, 15, litLen);
+	huffmanLengths(distFreq, 30, 15, distLen);
+	int hlit = 286;
+	while(hlit > 257 && litLen[hlit - 1] == 0) {
+		hlit--;
+	}
+	int hdist = 30;
+	while(hdist > 1 && distLen[hdist - 1] == 0) {
+		hdist--;
+	}
+	// Both sets of lengths are sent as one sequence
+	unsigned char lengths[286 + 30];
+	memcpy(lengths, litLen, hlit);
+	memcpy(lengths + hlit, distLen, hdist);
+
+	// Run length code the code lengths
+	struct Run { unsigned char symbol, extra; };
+	vector<Run> runs;
+	int total = hlit + hdist;
+	for(int i = 0; i < total;) {
+		int len = lengths[i];
+		int run = 1;
+		while(i + run < total && lengths[i + run] == len) {
+			run++;
+		}
+		int left = run;
+		if(len == 0) {
+			while(left >= 11) {
+				int r = min(left, 138);
+				runs.push_back({ 18, (unsigned char)(r - 11) });
+				left -= r;
+			}
+			if(left >= 3) {
+				runs.push_back({ 17, (unsigned char)(left - 3) });
+				left = 0;
+			}
+		} else {
+			runs.push_back({ (unsigned char)len, 0 });
+			left--;
+			while(left >= 3) {
+				int r = min(left, 6);
+				runs.push_back({ 16, (unsigned char)(r - 3) });
+				left -= r;
+			}
+		}
+		for(; left > 0; left--) {
+			runs.push_back({ (unsigned char)len, 0 });
+		}
+		i += run;
+	}
+	uint32_t clFreq[19] = {};
+	for(const Run &r : runs) {
+		clFreq[r.symbol]++;
+	}
+	unsigned char clLen[19];
+	huffmanLengths(clFreq, 19, 7, clLen);
+	int hclen = 19;
+	while(hclen > 4 && clLen[CLEN_ORDER[hclen - 1]] == 0) {
+		hclen--;
+	}
+
+	// Pick whichever encoding is smaller
+	uint64_t dynamicBits = 3 + 14 + 3 * hclen;
+	for(int s = 0; s < 19; s++) {
+		dynamicBits += (uint64_t)clFreq[s] * clLen[s];
+	}
+	dynamicBits += 2 * clFreq[16] + 3 * clFreq[17] + 7 * clFreq[18];
+	for(int s = 0; s < 286; s++) {
+		dynamicBits += (uint64_t)litFreq[s] * (litLen[s] + (s > 256 ? LENGTH_EXTRA[s - 257] : 0));
+	}
+	for(int s = 0; s < 30; s++) {
+		dynamicBits += (uint64_t)distFreq[s] * (distLen[s] + DIST_EXTRA[s]);
+	}
+	uint64_t storedBits = 8 * ((uint64_t)rawLen + 5 * (rawLen / 65535 + 1)) + 7;
+	if(storedBits <= dynamicBits) {
+		writeStored(bw, raw, rawLen, final);
+		return;
+	}
+
+	uint16_t litCode[286], distCode[30], clCode[19];
+	huffmanCodes(litLen, 286, litCode);
+	huffmanCodes(distLen, 30, distCode);
+	huffmanCodes(clLen, 19, clCode);
+
+	bw.put(final ? 1 : 0, 1);
+	bw.put(2, 2);
+	bw.put(hlit - 257, 5);
+	bw.put(hdist - 1, 5);
+	bw.put(hclen - 4, 4);
+	for(int i = 0; i < hclen; i++) {
+		bw.put(clLen[CLEN_ORDER[i]], 3);
+	}
+	for(const Run &r : runs) {
+		bw.put(clCode[r.symbol], clLen[r.symbol]);
+		if(r.symbol == 16) {
+			bw.put(r.extra, 2);
+		} else if(r.symbol == 17) {
+			bw.put(r.extra, 3);
+		} else if(r.symbol == 18) {
+			bw.put(r.extra, 7);
+		}
+	}
+	for(size_t i = 0; i < nTokens; i++) {
+		const Token &tok = tokens[i];
+		if(tok.dist == 0) {
+			bw.put(litCode[tok.litLen], litLen[tok.litLen]);
+			continue;
+		}
+		int lc = t.lengthCode[tok.litLen];
+		bw.put(litCode[257 + lc], litLen[257 + lc]);
+		bw.put(tok.litLen - LENGTH_BASE[lc], LENGTH_EXTRA[lc]);
+		int dc = t.distCode[tok.dist];
+		bw.put(distCode[dc], distLen[dc]);
+		bw.put(tok.dist - DIST_BASE[dc], DIST_EXTRA[dc]);
+	}
+	bw.put(litCode[256], litLen[256]);
+}
+
+inline uint32_t hash3(const unsigned char *p)
+{
+	uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16);
+	return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// Deflates data[dictLen, total) as a run of blocks ending on a byte
+// boundary, with data[0, dictLen) as the preset window. Only the last band
+// of the stream sets final; the others end in an empty stored block, which
+// byte aligns them without ending the stream.
+void deflateBand(BitWriter &bw, const unsigned char *data, size_t dictLen, size_t total,
+	const SearchParams &search, bool final)
+{
+	vector<int32_t> head(1 << HASH_BITS, -1);
+	vector<int32_t> prev(total);
+	auto insert = [&](size_t pos) {
+		if(pos + MIN_MATCH <= total) {
+			uint32_t h = hash3(data + pos);
+			prev[pos] = head[h];
+			head[h] = (int32_t)pos;
+		}
+	};
+	for(size_t pos = 0; pos < dictLen; pos++) {
+		insert(pos);
+	}
+
+	// Longest match for pos among the earlier positions with the same hash
+	auto findMatch = [&](size_t pos, int &bestLen, size_t &bestDist) {
+		bestLen = 0;
+		bestDist = 0;
+		if(pos + MIN_MATCH > total) {
+			return;
+		}
+		int maxLen = (int)min((size_t)MAX_MATCH, total - pos);
+		int chain = search.maxChain;
+		for(int32_t cand = head[hash3(data + pos)]; cand >= 0 && chain-- > 0; cand = prev[cand]) {
+			size_t dist = pos - cand;
+			if(dist > WINDOW_SIZE) {
+				break;
+			}
+			const unsigned char *a = data + pos;
+			const unsigned char *b = data + cand;
+			if(b[bestLen] != a[bestLen]) {
+				continue;
+			}
+			// Eight bytes at a time until they differ
+			int len = 0;
+			while(len + 8 <= maxLen) {
+				uint64_t x, y;
+				memcpy(&x, a + len, 8);
+				memcpy(&y, b + len, 8);
+				if(x != y) {
+					break;
+				}
+				len += 8;
+			}
+			while(len < maxLen && a[len] == b[len]) {
+				len++;
+			}
+			if(len > bestLen && (len > MIN_MATCH || dist <= TOO_FAR)) {
+				bestLen = len;
+				bestDist = dist;
+				if(len >= search.goodEnough || len == maxLen) {
+					break;
+				}
+			}
+		}
+		if(bestLen < MIN_MATCH) {
+			bestLen = 0;
+		}
+	};
+
+	vector<Token> tokens;
+	tokens.reserve(BLOCK_TOKENS + 2);
+	size_t blockStart = dictLen;
+	size_t pos = dictLen;
+	auto flush = [&](bool last) {
+		writeBlock(bw, tokens.data(), tokens.size(), data + blockStart, pos - blockStart, last && final);
+		tokens.clear();
+		blockStart = pos;
+	};
+
+	int len;
+	size_t dist;
+	findMatch(pos, len, dist);
+	while(pos < total) {
+		if(search.lazy && len > 0 && len < search.goodEnough && pos + 1 < total) {
+			// A longer match one byte later beats this one
+			insert(pos);
+			int nextLen;
+			size_t nextDist;
+			findMatch(pos + 1, nextLen, nextDist);
+			if(nextLen > len) {
+				tokens.push_back({ data[pos], 0 });
+				pos++;
+				len = nextLen;
+				dist = nextDist;
+			} else {
+				tokens.push_back({ (uint16_t)len, (uint16_t)dist });
+				for(size_t k = 1; k < (size_t)len && len <= search.maxInsert; k++) {
+					insert(pos + k);
+				}
+				pos += len;
+				findMatch(pos, len, dist);
+			}
+		} else if(len > 0) {
+			tokens.push_back({ (uint16_t)len, (uint16_t)dist });
+			insert(pos);
+			for(size_t k = 1; k < (size_t)len && len <= search.maxInsert; k++) {
+				insert(pos + k);
+			}
+			pos += len;
+			findMatch(pos, len, dist);
+		} else {
+			tokens.push_back({ data[pos], 0 });
+			insert(pos);
+			pos++;
+			findMatch(pos, len, dist);
+		}
+		if(tokens.size() >= BLOCK_TOKENS) {
+			flush(pos >= total);
+		}
+	}
+	if(!tokens.empty() || (final && blockStart == dictLen && pos == dictLen)) {
+		flush(true);
+	}
+	if(final) {
+		bw.align();
+	} else {
+		writeStored(bw, nullptr, 0, false);
+	}
+}
+
+// Predictor of filter Type for a byte with left neighbour a, upper b and
+// upper left c
+template<int Type>
+inline int predict(int a, int b, int c)
+{
+	switch(Type) {
+	case 1: return a;
+	case 2: return b;
+	case 3: return (a + b) >> 1;
+	case 4: {
+		int p = a + b - c;
+		int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+		return (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+	}
+	default: return 0;
+	}
+}
+
+// Applies filter Type to a row and returns the sum of the absolute values
+// of the filtered bytes taken as signed, the usual guess at how well the row
+// will compress.
+template<int Type>
+long applyFilter(unsigned char *out, const unsigned char *row, const unsigned char *prevRow,
+	int rowBytes, int bpp)
+{
+	long sum = 0;
+	for(int i = 0; i < bpp; i++) {
+		out[i] = (unsigned char)(row[i] - predict<Type>(0, prevRow[i], 0));
+		sum += abs((signed char)out[i]);
+	}
+	for(int i = bpp; i < rowBytes; i++) {
+		out[i] = (unsigned char)(row[i] - predict<Type>(row[i - bpp], prevRow[i], prevRow[i - bpp]));
+		sum += abs((signed char)out[i]);
+	}
+	return sum;
+}
+
+// Filters one row with the filter that has the smallest sum, or none at all
+// for stored output. out gets the filter type and the filtered bytes.
+// prevRow is all zeros for the first row.
+void filterRow(unsigned char *out, const unsigned char *row, const unsigned char *prevRow,
+	int rowBytes, int bpp, bool choose, vector<unsigned char> &scratch)
+{
+	if(!choose) {
+		out[0] = 0;
+		memcpy(out + 1, row, rowBytes);
+		return;
+	}
+	scratch.resize(5 * (size_t)rowBytes);
+	unsigned char *rows[5];
+	for(int type = 0; type < 5; type++) {
+		rows[type] = scratch.data() + type * (size_t)rowBytes;
+	}
+	long sums[5] = {
+		applyFilter<0>(rows[0], row, prevRow, rowBytes, bpp),
+		applyFilter<1>(rows[1], row, prevRow, rowBytes, bpp),
+		applyFilter<2>(rows[2], row, prevRow, rowBytes, bpp),
+		applyFilter<3>(rows[3], row, prevRow, rowBytes, bpp),
+		applyFilter<4>(rows[4], row, prevRow, rowBytes, bpp),
+	};
+	int best = 0;
+	for(int type = 1; type < 5; type++) {
+		if(sums[type] < sums[best]) {
+			best = type;
+		}
+	}
+	out[0] = (unsigned char)best;
+	memcpy(out + 1, rows[best], rowBytes);
+}
+
+void putBE32(vector<unsigned char> &out, uint32_t v)
+{
+	out.push_back((unsigned char)(v >> 24));
+	out.push_back((unsigned char)(v >> 16));
+	out.push_back((unsigned char)(v >> 8));
+	out.push_back((unsigned char)v);
+}
+
+void stbAppend(void *context, void *data, int size)
+{
+	vector<unsigned char> *out = static_cast<vector<unsigned char> *>(context);
+	const unsigned char *bytes = static_cast<const unsigned char *>(data);
+	out->insert(out->end(), bytes, bytes + size);
+}
+
+}
+
+bool parsePngLevel(const string &name, PngLevel &level)
+{
+	if(name == "stb") {
+		level = PngLevel::Stb;
+	} else if(name == "stored") {
+		level = PngLevel::Stored;
+	} else if(name == "fast") {
+		level = PngLevel::Fast;
+	} else if(name == "default") {
+		level = PngLevel::Default;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+void encodePng(vector<unsigned char> &png, int width, int height, int comp,
+	const unsigned char *pixels, int stride, PngLevel level, int nThreads)
+{
+	png.clear();
+	if(level == PngLevel::Stb) {
+		stbi_write_png_to_func(stbAppend, &png, width, height, comp, pixels, stride);
+		return;
+	}
+
+	size_t rowBytes = (size_t)width * comp;
+	size_t filteredRow = rowBytes + 1;
+	int rowsPerBand = (int)max((size_t)1, BAND_BYTES / filteredRow);
+	int nBands = max(1, (height + rowsPerBand - 1) / rowsPerBand);
+	vector<unsigned char> filtered(filteredRow * height);
+	ThreadPool pool(min(nThreads > 0 ? nThreads : ThreadPool::defaultThreadCount(), nBands));
+
+	// Rows only depend on themselves and the row above, so bands filter
+	// independently.
+	vector<vector<unsigned char> > scratch(pool.size());
+	vector<unsigned char> zeroRow(rowBytes, 0);
+	pool.parallelFor(nBands, [&](int band, int worker) {
+		int end = min(height, (band + 1) * rowsPerBand);
+		for(int y = band * rowsPerBand; y < end; y++) {
+			const unsigned char *row = pixels + (size_t)y * stride;
+			const unsigned char *prevRow = y > 0 ? row - stride : zeroRow.data();
+			filterRow(filtered.data() + y * filteredRow, row, prevRow, (int)rowBytes, comp,
+				level != PngLevel::Stored, scratch[worker]);
+		}
+	});
+
+	// Every band becomes one IDAT chunk: length, type, data, CRC
+	// Roughly zlib levels 1 and 6
+	SearchParams search = level == PngLevel::Fast ?
+		SearchParams{ 4, false, 8, 4 } : SearchParams{ 128, true, 128, MAX_MATCH };
+	vector<vector<unsigned char> > chunks(nBands);
+	vector<uint32_t> adlers(nBands);
+	pool.parallelFor(nBands, [&](int band, int) {
+		size_t begin = (size_t)band * rowsPerBand * filteredRow;
+		size_t end = min((size_t)height, (size_t)(band + 1) * rowsPerBand) * filteredRow;
+		bool last = band == nBands - 1;
+		vector<unsigned char> &chunk = chunks[band];
+		chunk.reserve((level == PngLevel::Stored ? end - begin : (end - begin) / 2) + 64);
+		chunk.resize(8);
+		memcpy(&chunk[4], "IDAT", 4);
+		if(band == 0) {
+			// zlib header: deflate with a 32K window and the level hint
+			chunk.push_back(0x78);
+			chunk.push_back(level == PngLevel::Stored || level == PngLevel::Fast ? 0x01 : 0x9C);
+		}
+		BitWriter bw(chunk);
+		if(level == PngLevel::Stored) {
+			writeStored(bw, filtered.data() + begin, end - begin, last);
+		} else {
+			size_t dictStart = begin > WINDOW_SIZE ? begin - WINDOW_SIZE : 0;
+			deflateBand(bw, filtered.data() + dictStart, begin - dictStart, end - dictStart, search, last);
+		}
+		adlers[band] = adler32(filtered.data() + begin, end - begin);
+		if(last) {
+			// The checksum of the whole stream is only known once all bands
+			// are done, so room is left for it here.
+			chunk.resize(chunk.size() + 4);
+		}
+		uint32_t length = (uint32_t)(chunk.size() - 8);
+		chunk[0] = (unsigned char)(length >> 24);
+		chunk[1] = (unsigned char)(length >> 16);
+		chunk[2] = (unsigned char)(length >> 8);
+		chunk[3] = (unsigned char)length;
+		if(!last) {
+			putBE32(chunk, crc32(0, chunk.data() + 4, chunk.size() - 4));
+		}
+	});
+
+	uint32_t adler = adlers[0];
+	for(int band = 1; band < nBands; band++) {
+		int rows = min(height, (band + 1) * rowsPerBand) - band * rowsPerBand;
+		adler = adler32Combine(adler, adlers[band], (size_t)rows * filteredRow);
+	}
+	vector<unsigned char> &lastChunk = chunks[nBands - 1];
+	size_t at = lastChunk.size() - 4;
+	lastChunk[at + 0] = (unsigned char)(adler >> 24);
+	lastChunk[at + 1] = (unsigned char)(adler >> 16);
+	lastChunk[at + 2] = (unsigned char)(adler >> 8);
+	lastChunk[at + 3] = (unsigned char)adler;
+	putBE32(lastChunk, crc32(0, lastChunk.data() + 4, lastChunk.size() - 4));
+
+	static const unsigned char SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	static const unsigned char COLOR_TYPE[5] = { 0, 0, 4, 2, 6 };
+	size_t size = 8 + 25 + 12;
+	for(const auto &chunk : chunks) {
+		size += chunk.size();
+	}
+	png.reserve(size);
+	png.insert(png.end(), SIGNATURE, SIGNATURE + 8);
+	putBE32(png, 13);
+	size_t ihdr = png.size();
+	png.insert(png.end(), { 'I', 'H', 'D', 'R' });
+	putBE32(png, (uint32_t)width);
+	putBE32(png, (uint32_t)height);
+	png.insert(png.end(), { 8, COLOR_TYPE[comp], 0, 0, 0 });
+	putBE32(png, crc32(0, png.data() + ihdr, png.size() - ihdr));
+	for(const auto &chunk : chunks) {
+		png.insert(png.end(), chunk.begin(), chunk.end());
+	}
+	putBE32(png, 0);
+	size_t iend = png.size();
+	png.insert(png.end(), { 'I', 'E', 'N', 'D' });
+	putBE32(png, crc32(0, png.data() + iend, 4));
+}
+
+bool writePng(const string &filename, int width, int height, int comp,
+	const unsigned char *pixels, int stride, PngLevel level, int nThreads)
+{
+	if(level == PngLevel::Stb) {
+		return stbi_write_png(filename.c_str(), width, height, comp, pixels, stride) != 0;
+	}
+	vector<unsigned char> png;
+	encodePng(png, width, height, comp, pixels, stride, level, nThreads);
+	FILE *f = fopen(filename.c_str(), "wb");
+	if(!f) {
+		return false;
+	}
+	bool ok = fwrite(png.data(), 1, png.size(), f) == png.size();
+	return fclose(f) == 0 && ok;
+}
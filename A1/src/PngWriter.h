@@ -0,0 +1,42 @@
+#pragma once
+#ifndef _PNGWRITER_H_
+#define _PNGWRITER_H_
+
+#include <string>
+#include <vector>
+
+/**
+ * How a PNG gets compressed.
+ * Stb hands the image to stbi_write_png as it is, which produces the same
+ * files as always but filters and deflates on a single thread. The others
+ * use the encoder below: Stored does not compress at all, Fast does a quick
+ * greedy match search and Default a longer lazy one.
+ */
+enum class PngLevel { Stb, Stored, Fast, Default };
+
+// Accepts "stb", "stored", "fast" and "default". Returns false on anything
+// else.
+bool parsePngLevel(const std::string &name, PngLevel &level);
+
+/**
+ * Parallel PNG encoder. The image is cut into bands of rows, each band is
+ * filtered and deflated on its own thread (with the 32K of data before it
+ * as the dictionary, so matches still reach back across band edges), and
+ * the band streams, each ending on a byte boundary, are joined into one
+ * zlib stream. The bands go into consecutive IDAT chunks, so every chunk CRC
+ * is computed on the thread that made the band and the Adler-32 checksums of
+ * the bands are combined at the end.
+ *
+ * Band sizes only depend on the image size, so the file is the same for any
+ * number of threads. pixels has comp (1 to 4) bytes per pixel, rows stride
+ * bytes apart, the first row at the top.
+ */
+void encodePng(std::vector<unsigned char> &png, int width, int height, int comp,
+	const unsigned char *pixels, int stride, PngLevel level, int nThreads = 0);
+
+// Encodes and writes the file. nThreads <= 0 means one per hardware thread.
+// Returns false if the file cannot be written.
+bool writePng(const std::string &filename, int width, int height, int comp,
+	const unsigned char *pixels, int stride, PngLevel level, int nThreads = 0);
+
+#endif
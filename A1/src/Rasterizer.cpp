@@ -0,0 +1,684 @@
+#include "Rasterizer.h"
+#include "Mesh.h"
+#include "ThreadPool.h"
+#include "Shaders.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+// Lower bound on every depth the depth kernel can interpolate inside the
+// triangle. Covered pixels may have barycentrics slightly below zero (down to
+// EDGE_EPSILON/area) and the edge values carry some rounding, so the bound is
+// pulled towards the viewer by both. Degenerate triangles end up at -inf or
+// NaN, which never rejects anything.
+template<class Setup>
+static float nearestDepth(float za, float zb, float zc, const Setup &s)
+{
+	float zMin = min(min(za, zb), zc);
+	float zMax = max(max(za, zb), zc);
+	float zMag = max(fabs(zMin), fabs(zMax));
+	float extent = (float)(s.maxX - s.minX + s.maxY - s.minY + 2);
+	float edgeMag = max(max(fabs(s.ab.dx) + fabs(s.ab.dy), fabs(s.bc.dx) + fabs(s.bc.dy)),
+		fabs(s.ca.dx) + fabs(s.ca.dy)) * extent;
+	float w = (-EDGE_EPSILON + 24 * FLT_EPSILON * edgeMag) * fabs(s.invArea);
+	return zMin - 3 * w * (zMax - zMin + zMag) - 8 * FLT_EPSILON * zMag * (1 + 3 * w);
+}
+
+// Rounds a projected coordinate to the fixed point grid. Returns false if it
+// is outside the guard band, or not a number.
+static bool snapCoordinate(float v, int64_t &fixed)
+{
+	if(!(fabs(v) <= (float)Rasterizer::FIXED_GUARD_BAND)) {
+		return false;
+	}
+	fixed = llround((double)v * Rasterizer::SUBPIXELS);
+	return true;
+}
+
+// Integer division rounding down and up, for b > 0
+static int64_t floorDiv(int64_t a, int64_t b)
+{
+	return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+static int64_t ceilDiv(int64_t a, int64_t b)
+{
+	return -floorDiv(-a, b);
+}
+
+// Bias of the directed edge (dx, dy) of a triangle whose inside is on its
+// left (y up). Pixels on top edges (horizontal, inside below) and left edges
+// (inside to the right, so going down) belong to the triangle.
+static int64_t fillBias(int64_t dx, int64_t dy)
+{
+	return dy < 0 || (dy == 0 && dx < 0) ? 0 : -1;
+}
+
+// Sample positions relative to the pixel centre in 1/16 pixel, for 2, 4 and
+// 8 samples: the standard patterns, which put every sample in its own row
+// and column.
+static const int SAMPLE_POSITIONS_2[2][2] = { { 4, 4 }, { -4, -4 } };
+static const int SAMPLE_POSITIONS_4[4][2] = { { -2, -6 }, { 6, -2 }, { -6, 2 }, { 2, 6 } };
+static const int SAMPLE_POSITIONS_8[8][2] = {
+	{ 1, -3 }, { -1, 3 }, { 5, 1 }, { -3, -5 }, { -5, 5 }, { -7, -1 }, { 3, 7 }, { 7, -7 }
+};
+
+static const int (*samplePositions(int n))[2]
+{
+	return n == 8 ? SAMPLE_POSITIONS_8 : (n == 4 ? SAMPLE_POSITIONS_4 : SAMPLE_POSITIONS_2);
+}
+
+// Narrows the pixels lo <= k < hi of a span to those where e + k*step is not
+// negative. The value is monotonic in k, so they are a prefix or a suffix.
+static void narrowToEdge(int64_t e, int64_t step, int &lo, int &hi)
+{
+	if(step > 0) {
+		if(e < 0) {
+			int64_t first = (-e + step - 1) / step;
+			lo = (int)max((int64_t)lo, min(first, (int64_t)hi));
+		}
+	} else if(step < 0) {
+		int64_t end = e < 0 ? 0 : e / -step + 1;
+		hi = (int)min((int64_t)hi, max(end, (int64_t)lo));
+	} else if(e < 0) {
+		hi = lo;
+	}
+}
+
+bool parseCullMode(const string &name, CullMode &mode)
+{
+	if(name == "none") {
+		mode = CullMode::None;
+	} else if(name == "back") {
+		mode = CullMode::Back;
+	} else if(name == "front") {
+		mode = CullMode::Front;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+Rasterizer::Rasterizer(int w, int h, int nThreads) :
+	width(w),
+	height(h),
+	tilesX((w + TILE_SIZE - 1) / TILE_SIZE),
+	tilesY((h + TILE_SIZE - 1) / TILE_SIZE),
+	pool(new ThreadPool(nThreads)),
+	simd(detectSimdLevel()),
+	scissorMinX(0),
+	scissorMinY(0),
+	scissorMaxX(w),
+	scissorMaxY(h),
+	stats(),
+	useHiZ(true),
+	fixedPoint(false),
+	layout(w, h),
+	samples(1),
+	sampleReach(0.0f),
+	fixedSampleReach(0),
+	cull(CullMode::Back),
+	chunkSize(1)
+{
+}
+
+Rasterizer::~Rasterizer()
+{
+}
+
+int Rasterizer::getThreadCount() const
+{
+	return pool->size();
+}
+
+void Rasterizer::setScissor(int x, int y, int w, int h)
+{
+	// Image rows count down from the top, raster rows count up.
+	scissorMinX = max(x, 0);
+	scissorMaxX = min(x + w, width);
+	scissorMinY = max(height - (y + h), 0);
+	scissorMaxY = min(height - y, height);
+}
+
+void Rasterizer::setTiledFramebuffer(bool enabled)
+{
+	layout = FrameLayout(width, height, enabled ? TILE_SIZE : 0);
+}
+
+bool Rasterizer::setSamples(int n)
+{
+	if(n != 1 && n != 2 && n != 4 && n != 8) {
+		return false;
+	}
+	samples = n;
+	int reach = 0;
+	if(n > 1) {
+		const int (*positions)[2] = samplePositions(n);
+		for(int i = 0; i < n; i++) {
+			reach = max(reach, max(abs(positions[i][0]), abs(positions[i][1])));
+		}
+	}
+	sampleReach = reach / 16.0f;
+	fixedSampleReach = reach * (SUBPIXELS / 16);
+	return true;
+}
+
+void Rasterizer::resolve(const vector<unsigned char> &framebuffer, vector<unsigned char> &image)
+{
+	Stopwatch timer;
+	image.resize((size_t)width * height * 3);
+	pool->parallelFor(layout.getBlockCount(), [&](int block, int) {
+		layout.resolveBlock(block, 3, samples, framebuffer.data(), image.data());
+	});
+	stats.resolve += timer.elapsed();
+}
+
+void Rasterizer::setSimdLevel(SimdLevel level)
+{
+	simd = min(level, detectSimdLevel());
+}
+
+void Rasterizer::draw(const Mesh &mesh, const RasterParams &params,
+	vector<unsigned char> &image, DepthBuffer &depth)
+{
+	int nTris = mesh.getTriangleCount();
+	stats = RasterStats();
+	stats.trianglesIn = nTris;
+	stats.scissorPixels = (long long)max(scissorMaxX - scissorMinX, 0) * max(scissorMaxY - scissorMinY, 0);
+	if(nTris == 0 || scissorMinX >= scissorMaxX || scissorMinY >= scissorMaxY) {
+		stats.trianglesCulled = nTris;
+		return;
+	}
+
+	// The shading mode is resolved here, once, instead of per pixel.
+	switch(params.task) {
+	case 1:
+		drawTiles(BoxShader(), mesh, params, image, depth);
+		break;
+	case 2:
+		drawTiles(FlatShader(), mesh, params, image, depth);
+		break;
+	case 3:
+		drawTiles(VertexColorShader(), mesh, params, image, depth);
+		break;
+	case 4:
+		drawTiles(GradientShader{ params.minY, params.maxY }, mesh, params, image, depth);
+		break;
+	case 5:
+		drawTiles(DepthShader{ simd, params.minZ, params.maxZ, &depth }, mesh, params, image, depth);
+		break;
+	case 6:
+		drawTiles(NormalShader{ simd }, mesh, params, image, depth);
+		break;
+	case 7:
+	case 8:
+		drawTiles(LambertShader{ simd }, mesh, params, image, depth);
+		break;
+	default:
+		break;
+	}
+}
+
+template<class Shader>
+void Rasterizer::drawTiles(const Shader &shader, const Mesh &mesh,
+	const RasterParams &params, vector<unsigned char> &image, DepthBuffer &depth)
+{
+	// Projection, once per unique vertex. Triangles sharing a vertex all
+	// read the same projected position afterwards.
+	Stopwatch timer;
+	const float *vx = mesh.getX();
+	const float *vy = mesh.getY();
+	int nVerts = mesh.getVertexCount();
+	projected.resize(nVerts);
+	int nVertChunks = min(nVerts, pool->size() * 4);
+	int vertChunkSize = nVertChunks > 0 ? (nVerts + nVertChunks - 1) / nVertChunks : 0;
+	pool->parallelFor(nVertChunks, [&](int chunk, int) {
+		int end = min(nVerts, (chunk + 1) * vertChunkSize);
+		for(int v = chunk * vertChunkSize; v < end; v++) {
+			projected[v] = projectToImage(vx[v], vy[v], params.scale, params.translation);
+		}
+	});
+	stats.transform += timer.lap();
+
+	// Setup: a few chunks per thread so that uneven chunks still balance.
+	int nTris = mesh.getTriangleCount();
+	int nChunks = min(nTris, pool->size() * 4);
+	chunkSize = (nTris + nChunks - 1) / nChunks;
+	nChunks = (nTris + chunkSize - 1) / chunkSize;
+	setup.resize(nTris);
+	if(fixedPoint) {
+		fixedSetup.resize(nTris);
+	}
+	bins.resize(nChunks);
+	for(auto &chunk : bins) {
+		chunk.resize(tilesX * tilesY);
+		for(auto &bin : chunk) {
+			bin.clear();
+		}
+	}
+	chunkStats.assign(nChunks, RasterStats());
+	pool->parallelFor(nChunks, [&](int chunk, int) {
+		setupRange(chunk, mesh, Shader::USES_COVERAGE);
+	});
+	for(const auto &c : chunkStats) {
+		stats.trianglesBinned += c.trianglesBinned;
+		stats.trianglesCulled += c.trianglesCulled;
+		stats.trianglesFacing += c.trianglesFacing;
+		stats.trianglesDegenerate += c.trianglesDegenerate;
+		stats.trianglesClipped += c.trianglesClipped;
+		stats.tileEntries += c.tileEntries;
+	}
+	stats.setup += timer.lap();
+
+	// Rasterization: every tile belongs to exactly one worker.
+	if(Shader::USES_DEPTH && useHiZ && samples == 1) {
+		hiz.reset(depth, TILE_SIZE);
+	}
+	workerStats.assign(pool->size(), RasterStats());
+	pool->parallelFor(tilesX * tilesY, [&](int tile, int worker) {
+		rasterizeTile(tile, shader, mesh, image, depth, workerStats[worker]);
+	});
+	for(const auto &w : workerStats) {
+		stats.hizTilesCulled += w.hizTilesCulled;
+		stats.hizBlocksCulled += w.hizBlocksCulled;
+		stats.pixelsTested += w.pixelsTested;
+		stats.pixelsCovered += w.pixelsCovered;
+		stats.pixelsWritten += w.pixelsWritten;
+	}
+	if(Shader::USES_DEPTH) {
+		stats.depthTests = stats.pixelsCovered;
+		stats.depthPasses = stats.pixelsWritten;
+		stats.depthFails = stats.pixelsCovered - stats.pixelsWritten;
+	}
+	stats.raster += timer.lap();
+}
+
+void Rasterizer::setupRange(int chunk, const Mesh &mesh, bool coverage)
+{
+	const float *vz = mesh.getZ();
+	const uint32_t *indices = mesh.getIndices();
+	vector<vector<int> > &chunkBins = bins[chunk];
+	RasterStats &cstats = chunkStats[chunk];
+	int begin = chunk * chunkSize;
+	int end = min(mesh.getTriangleCount(), begin + chunkSize);
+	for(int i = begin; i < end; i++) {
+		TriSetup &s = setup[i];
+		s.minX = s.maxX = s.minY = s.maxY = 0;
+		s.a = projected[indices[3*i + 0]];
+		s.b = projected[indices[3*i + 1]];
+		s.c = projected[indices[3*i + 2]];
+		int64_t fx[3], fy[3];
+		s.fixed = fixedPoint &&
+			snapCoordinate(s.a.x, fx[0]) && snapCoordinate(s.a.y, fy[0]) &&
+			snapCoordinate(s.b.x, fx[1]) && snapCoordinate(s.b.y, fy[1]) &&
+			snapCoordinate(s.c.x, fx[2]) && snapCoordinate(s.c.y, fy[2]);
+		if(s.fixed) {
+			// The float edges describe the snapped triangle as well, so that
+			// the depth bound below holds for it
+			s.a = { (float)fx[0] / SUBPIXELS, (float)fy[0] / SUBPIXELS };
+			s.b = { (float)fx[1] / SUBPIXELS, (float)fy[1] / SUBPIXELS };
+			s.c = { (float)fx[2] / SUBPIXELS, (float)fy[2] / SUBPIXELS };
+		}
+		s.ab = { s.a.x, s.a.y, s.b.x - s.a.x, s.b.y - s.a.y };
+		s.bc = { s.b.x, s.b.y, s.c.x - s.b.x, s.c.y - s.b.y };
+		s.ca = { s.c.x, s.c.y, s.a.x - s.c.x, s.a.y - s.c.y };
+
+		// Winding and area, before any pixel work. The signed area is the
+		// AB edge function at C, the same sum ABP + BCP + CAP adds up to.
+		float area = s.ab.at(s.c.x, s.c.y);
+		s.invArea = 1.0f / area;
+		int64_t fixedArea = 0;
+		FixedSetup *f = s.fixed ? &fixedSetup[i] : nullptr;
+		if(f) {
+			f->ab = { fx[0], fy[0], fx[1] - fx[0], fy[1] - fy[0], 0 };
+			f->bc = { fx[1], fy[1], fx[2] - fx[1], fy[2] - fy[1], 0 };
+			f->ca = { fx[2], fy[2], fx[0] - fx[2], fy[0] - fy[2], 0 };
+			// Exact, and scaled to the units of the float edge values
+			fixedArea = f->ab.at(fx[2], fy[2]);
+			area = (float)fixedArea / ((float)SUBPIXELS * SUBPIXELS);
+			s.invArea = 1.0f / area;
+		}
+		if(coverage) {
+			if(f ? fixedArea == 0 : (!isfinite(area) || !isfinite(s.invArea))) {
+				// Would only produce NaN barycentrics
+				cstats.trianglesCulled++;
+				cstats.trianglesDegenerate++;
+				continue;
+			}
+			bool front = f ? fixedArea > 0 : area > 0.0f;
+			if((cull == CullMode::Back && !front) || (cull == CullMode::Front && front)) {
+				cstats.trianglesCulled++;
+				cstats.trianglesFacing++;
+				continue;
+			}
+			if(!front) {
+				s.ab = { s.ab.x0, s.ab.y0, -s.ab.dx, -s.ab.dy };
+				s.bc = { s.bc.x0, s.bc.y0, -s.bc.dx, -s.bc.dy };
+				s.ca = { s.ca.x0, s.ca.y0, -s.ca.dx, -s.ca.dy };
+				s.invArea = -s.invArea;
+				if(f) {
+					for(FixedEdge *e : { &f->ab, &f->bc, &f->ca }) {
+						e->dx = -e->dx;
+						e->dy = -e->dy;
+					}
+				}
+			}
+			if(f) {
+				for(FixedEdge *e : { &f->ab, &f->bc, &f->ca }) {
+					e->bias = fillBias(e->dx, e->dy);
+				}
+			}
+		}
+
+		// Pixel bounding box. Triangles that miss the scissor rectangle are
+		// rejected here, before anything is converted to int, so that huge
+		// or NaN coordinates never reach the pixel loop. The comparisons are
+		// written so that NaN fails them. When multisampling, the box grows
+		// by the reach of the samples, which can be covered in pixels whose
+		// centre is not.
+		float triMinX, triMinY, triMaxX, triMaxY;
+		float reach = coverage ? sampleReach : 0.0f;
+		if(f) {
+			// Every pixel inside or on the snapped triangle, exactly
+			int64_t fixedReach = fixedSampleReach;
+			triMinX = (float)ceilDiv(min(min(fx[0], fx[1]), fx[2]) - fixedReach, SUBPIXELS);
+			triMinY = (float)ceilDiv(min(min(fy[0], fy[1]), fy[2]) - fixedReach, SUBPIXELS);
+			triMaxX = (float)(floorDiv(max(max(fx[0], fx[1]), fx[2]) + fixedReach, SUBPIXELS) + 1);
+			triMaxY = (float)(floorDiv(max(max(fy[0], fy[1]), fy[2]) + fixedReach, SUBPIXELS) + 1);
+		} else {
+			triMinX = floor(min(min(s.a.x, s.b.x), s.c.x) - reach);
+			triMinY = floor(min(min(s.a.y, s.b.y), s.c.y) - reach);
+			triMaxX = ceil(max(max(s.a.x, s.b.x), s.c.x) + reach);
+			triMaxY = ceil(max(max(s.a.y, s.b.y), s.c.y) + reach);
+		}
+		if(!(triMinX < scissorMaxX && triMaxX > scissorMinX && triMinY < scissorMaxY && triMaxY > scissorMinY)) {
+			cstats.trianglesCulled++;
+			continue;
+		}
+		if(triMinX < scissorMinX || triMaxX > scissorMaxX || triMinY < scissorMinY || triMaxY > scissorMaxY) {
+			cstats.trianglesClipped++;
+		}
+		int minX = (int)max(triMinX, (float)scissorMinX);
+		int minY = (int)max(triMinY, (float)scissorMinY);
+		int maxX = (int)min(triMaxX, (float)scissorMaxX);
+		int maxY = (int)min(triMaxY, (float)scissorMaxY);
+		if(minX >= maxX || minY >= maxY) {
+			// Zero-width box: all vertices on the same pixel column or row
+			cstats.trianglesCulled++;
+			continue;
+		}
+		s.minX = minX;
+		s.minY = minY;
+		s.maxX = maxX;
+		s.maxY = maxY;
+		s.zNear = nearestDepth(vz[indices[3*i + 0]], vz[indices[3*i + 1]], vz[indices[3*i + 2]], s);
+		cstats.trianglesBinned++;
+
+		int tx0 = s.minX / TILE_SIZE;
+		int ty0 = s.minY / TILE_SIZE;
+		int tx1 = (s.maxX - 1) / TILE_SIZE;
+		int ty1 = (s.maxY - 1) / TILE_SIZE;
+		for(int ty = ty0; ty <= ty1; ty++) {
+			for(int tx = tx0; tx <= tx1; tx++) {
+				chunkBins[ty * tilesX + tx].push_back(i);
+			}
+		}
+		cstats.tileEntries += (long long)(tx1 - tx0 + 1) * (ty1 - ty0 + 1);
+	}
+}
+
+template<class Shader>
+void Rasterizer::rasterizeTile(int tile, const Shader &shader, const Mesh &mesh,
+	vector<unsigned char> &image, DepthBuffer &depth, RasterStats &tileStats)
+{
+	const int B = HiZBuffer::BLOCK_SIZE;
+	const uint32_t *indices = mesh.getIndices();
+	const bool depthCull = Shader::USES_DEPTH && useHiZ && samples == 1;
+	int tx = tile % tilesX;
+	int ty = tile / tilesX;
+	int tileMinX = tx * TILE_SIZE;
+	int tileMinY = ty * TILE_SIZE;
+	int tileMaxX = min(tileMinX + TILE_SIZE, width);
+	int tileMaxY = min(tileMinY + TILE_SIZE, height);
+
+	for(const auto &chunkBins : bins) {
+		for(int i : chunkBins[tile]) {
+			const TriSetup &s = setup[i];
+			int yBegin = max(s.minY, tileMinY);
+			int yEnd = min(s.maxY, tileMaxY);
+			int xBegin = max(s.minX, tileMinX);
+			int xEnd = min(s.maxX, tileMaxX);
+			// The Hi-Z keeps stored values, so compare what zNear would store
+			float zBound = depthCull ? depth.storedBound(s.zNear) : 0.0f;
+			if(depthCull && hiz.tileOccluded(tx, ty, zBound)) {
+				tileStats.hizTilesCulled++;
+				continue;
+			}
+
+			// Everything but the per-row pointers and edge values is shared
+			// by all rows of the triangle. Fixed point edge values are in
+			// 1/SUBPIXELS^2 of the float ones, which is a power of two, so
+			// they convert to the same barycentrics.
+			const float fixedScale = 1.0f / ((float)SUBPIXELS * SUBPIXELS);
+			const FixedSetup *f = Shader::USES_COVERAGE && s.fixed ? &fixedSetup[i] : nullptr;
+			SpanSetup span;
+			span.start = 0;
+			span.count = xEnd - xBegin;
+			span.covered = f != nullptr;
+			if(f) {
+				span.step[0] = (float)f->ab.stepX() * fixedScale;
+				span.step[1] = (float)f->bc.stepX() * fixedScale;
+				span.step[2] = (float)f->ca.stepX() * fixedScale;
+			} else {
+				span.step[0] = s.ab.stepX();
+				span.step[1] = s.bc.stepX();
+				span.step[2] = s.ca.stepX();
+			}
+			span.invArea = s.invArea;
+			shader.triangle(i, mesh, &indices[3*i], span);
+
+			// Which 8x8 blocks of the current block row are visible
+			int bx0 = xBegin / B;
+			int bx1 = (xEnd - 1) / B;
+			bool visible[TILE_SIZE / B];
+
+			for(int y = yBegin; y < yEnd; y++) {
+				// Evaluate the edges exactly at the start of the span; pixel
+				// k of the span is then e0 + k*step. In fixed point the
+				// covered pixels rowBegin <= k < rowEnd are found right away.
+				int rowBegin = 0, rowEnd = xEnd - xBegin;
+				if(f) {
+					const FixedEdge *edges[3] = { &f->ab, &f->bc, &f->ca };
+					for(int k = 0; k < 3; k++) {
+						int64_t e = edges[k]->atPixel(xBegin, y);
+						narrowToEdge(e + edges[k]->bias, edges[k]->stepX(), rowBegin, rowEnd);
+						span.e0[k] = (float)e * fixedScale;
+					}
+				} else {
+					span.e0[0] = s.ab.at(static_cast<float>(xBegin), static_cast<float>(y));
+					span.e0[1] = s.bc.at(static_cast<float>(xBegin), static_cast<float>(y));
+					span.e0[2] = s.ca.at(static_cast<float>(xBegin), static_cast<float>(y));
+				}
+				int flippedY = height - 1 - y;
+				size_t at = layout.index(xBegin, y);
+				if(samples > 1) {
+					shadeSamples(shader, s, f, span, xBegin, y, at, image, depth, tileStats);
+					continue;
+				}
+				span.rgb = &image[at * 3];
+				span.depth = depth.pixel(at);
+				if(!depthCull) {
+					if(rowBegin < rowEnd) {
+						span.start = rowBegin;
+						span.count = rowEnd;
+						countSpan(tileStats, rowEnd - rowBegin, shader.span(span, flippedY));
+					}
+					continue;
+				}
+
+				if(y == yBegin || y % B == 0) {
+					for(int bx = bx0; bx <= bx1; bx++) {
+						visible[bx - bx0] = !hiz.blockOccluded(bx, y / B, zBound);
+						if(visible[bx - bx0]) {
+							hiz.touchBlock(bx, y / B);
+						} else {
+							tileStats.hizBlocksCulled++;
+						}
+					}
+				}
+				// Shade each run of visible blocks. Only start and count
+				// move, so every pixel is evaluated as in a full span.
+				if(rowBegin >= rowEnd) {
+					continue;
+				}
+				for(int bx = bx0; bx <= bx1; bx++) {
+					if(!visible[bx - bx0]) {
+						continue;
+					}
+					int runBegin = bx;
+					while(bx < bx1 && visible[bx + 1 - bx0]) {
+						bx++;
+					}
+					span.start = max(max(runBegin * B, xBegin) - xBegin, rowBegin);
+					span.count = min(min((bx + 1) * B, xEnd) - xBegin, rowEnd);
+					if(span.start < span.count) {
+						countSpan(tileStats, span.count - span.start, shader.span(span, flippedY));
+					}
+				}
+			}
+		}
+	}
+}
+
+template<class Shader>
+void Rasterizer::shadeSamples(const Shader &shader, const TriSetup &s, const FixedSetup *f,
+	SpanSetup span, int xBegin, int y, size_t at, vector<unsigned char> &image, DepthBuffer &depth,
+	RasterStats &tileStats)
+{
+	const float fixedScale = 1.0f / ((float)SUBPIXELS * SUBPIXELS);
+	const int (*positions)[2] = samplePositions(samples);
+	const size_t planeSize = layout.size();
+	const int flippedY = height - 1 - y;
+	const int count = span.count;
+	// Bit n of masks[k] is set when sample n of pixel k is covered
+	unsigned char masks[TILE_SIZE];
+	if(!Shader::PER_SAMPLE) {
+		fill(masks, masks + count, 0);
+	}
+
+	for(int n = 0; n < samples; n++) {
+		// Edge values at sample n of the first pixel. Fixed point finds the
+		// covered pixels begin <= k < end right away, like for the centres.
+		float e0[3];
+		int begin = 0, end = count;
+		if(f) {
+			const FixedEdge *edges[3] = { &f->ab, &f->bc, &f->ca };
+			int64_t sx = (int64_t)xBegin * SUBPIXELS + positions[n][0] * (SUBPIXELS / 16);
+			int64_t sy = (int64_t)y * SUBPIXELS + positions[n][1] * (SUBPIXELS / 16);
+			for(int k = 0; k < 3; k++) {
+				int64_t e = edges[k]->at(sx, sy);
+				narrowToEdge(e + edges[k]->bias, edges[k]->stepX(), begin, end);
+				e0[k] = (float)e * fixedScale;
+			}
+		} else {
+			float sx = (float)xBegin + positions[n][0] / 16.0f;
+			float sy = (float)y + positions[n][1] / 16.0f;
+			e0[0] = s.ab.at(sx, sy);
+			e0[1] = s.bc.at(sx, sy);
+			e0[2] = s.ca.at(sx, sy);
+		}
+
+		if(Shader::PER_SAMPLE) {
+			// The sample's own span, shaded into its own planes
+			SpanSetup sample = span;
+			copy(e0, e0 + 3, sample.e0);
+			sample.start = begin;
+			sample.count = end;
+			sample.rgb = &image[(n * planeSize + at) * 3];
+			sample.depth = depth.pixel(n * planeSize + at);
+			if(begin < end) {
+				countSpan(tileStats, end - begin, shader.span(sample, flippedY));
+			}
+			continue;
+		}
+
+		if(f || !Shader::USES_COVERAGE) {
+			tileStats.pixelsTested += end - begin;
+			for(int k = begin; k < end; k++) {
+				masks[k] |= (unsigned char)(1 << n);
+			}
+		} else {
+			tileStats.pixelsTested += count;
+			// The same test, with the same rounding, as spanCoverage. No
+			// early outs, so that the compiler can vectorize it.
+			for(int k = 0; k < count; k++) {
+				float fk = static_cast<float>(k);
+				int inside = (e0[0] + fk * span.step[0] >= EDGE_EPSILON) &
+					(e0[1] + fk * span.step[1] >= EDGE_EPSILON) &
+					(e0[2] + fk * span.step[2] >= EDGE_EPSILON);
+				masks[k] |= (unsigned char)(inside << n);
+			}
+		}
+	}
+	if(Shader::PER_SAMPLE) {
+		return;
+	}
+	int first = 0, last = count - 1;
+	while(first <= last && !masks[first]) {
+		first++;
+	}
+	while(last >= first && !masks[last]) {
+		last--;
+	}
+	if(first > last) {
+		return;
+	}
+
+	// Shade every pixel with a covered sample once, at its centre, then
+	// store the color in the covered samples.
+	unsigned char shaded[TILE_SIZE * 3];
+	span.start = first;
+	span.count = last + 1;
+	span.covered = true;
+	span.rgb = shaded;
+	shader.span(span, flippedY);
+	int covered = 0;
+	for(int k = first; k <= last; k++) {
+		for(int mask = masks[k]; mask; mask &= mask - 1) {
+			covered++;
+		}
+	}
+	tileStats.pixelsCovered += covered;
+	tileStats.pixelsWritten += covered;
+	unsigned char *planes[MAX_SAMPLES];
+	for(int n = 0; n < samples; n++) {
+		planes[n] = &image[(n * planeSize + at) * 3];
+	}
+	const unsigned char all = (unsigned char)((1 << samples) - 1);
+	for(int k = first; k <= last; k++) {
+		if(masks[k] == all) {
+			// Inside the triangle whole runs of pixels are fully covered
+			int run = k;
+			while(run < last && masks[run + 1] == all) {
+				run++;
+			}
+			for(int n = 0; n < samples; n++) {
+				memcpy(planes[n] + 3*k, shaded + 3*k, 3 * (run - k + 1));
+			}
+			k = run;
+			continue;
+		}
+		for(int n = 0, mask = masks[k]; mask; n++, mask >>= 1) {
+			if(mask & 1) {
+				planes[n][3*k + 0] = shaded[3*k + 0];
+				planes[n][3*k + 1] = shaded[3*k + 1];
+				planes[n][3*k + 2] = shaded[3*k + 2];
+			}
+		}
+	}
+}
@@ -0,0 +1,273 @@
+#pragma once
+#ifndef _RASTERIZER_H_
+#define _RASTERIZER_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "DepthBuffer.h"
+#include "FrameLayout.h"
+#include "HiZBuffer.h"
+#include "SpanKernels.h"
+#include "Stopwatch.h"
+
+class Mesh;
+class ThreadPool;
+
+struct Point {
+	float x, y;
+};
+
+inline Point projectToImage(float x, float y, float scale, const Point& translation)
+{
+	return { scale * x + translation.x, scale * y + translation.y };
+}
+
+/**
+ * Which triangles the setup stage drops by winding. Front facing triangles
+ * are counter-clockwise on screen (positive signed area with y up), which
+ * is the only winding the original pixel loop ever covered, so Back is the
+ * default and leaves the image unchanged.
+ */
+enum class CullMode { None, Back, Front };
+
+// Accepts "none", "back" and "front". Returns false on anything else.
+bool parseCullMode(const std::string &name, CullMode &mode);
+
+/**
+ * Everything the pixel loop needs to know besides the triangles themselves.
+ * minY/maxY are the projected y extents used by the gradient (task 4) and
+ * minZ/maxZ the object space depth range used by the depth view (task 5).
+ */
+struct RasterParams {
+	int task;
+	float scale;
+	Point translation;
+	float minY, maxY;
+	float minZ, maxZ;
+};
+
+/**
+ * Per-draw counters and stage times. A triangle is culled when it faces
+ * the culled way, has no area (or a non-finite one), or its bounding box
+ * misses the scissor rectangle; trianglesCulled counts all of them. It is
+ * clipped when its bounding box had to be clamped to the scissor. Whatever
+ * is not culled is binned and reaches the pixel loop.
+ *
+ * The pixel counters count samples when multisampling. A pixel is tested
+ * when the pixel loop evaluates its coverage; fixed point rows are narrowed
+ * to their covered pixels first, and pixels in blocks the Hi-Z rejected are
+ * never tested. Covered pixels of a depth tested draw are depth tests, and
+ * the written ones passed.
+ *
+ * transform is the projection of the vertices, setup the per-triangle setup
+ * and binning, raster the tile loop and resolve the copy of a tiled or
+ * multisampled framebuffer into the image. renderFrame adds the rotation of
+ * the vertices to transform and fills in clear.
+ */
+struct RasterStats {
+	long long trianglesIn;
+	long long trianglesBinned;
+	long long trianglesCulled;
+	long long trianglesFacing; // culled by winding
+	long long trianglesDegenerate; // culled for having no area
+	long long trianglesClipped;
+	long long tileEntries; // triangle/tile pairs produced by binning
+	long long hizTilesCulled; // triangle/tile pairs rejected by the Hi-Z
+	long long hizBlocksCulled;
+	long long scissorPixels; // pixels inside the scissor rectangle
+	long long pixelsTested;
+	long long pixelsCovered;
+	long long pixelsWritten;
+	long long depthTests;
+	long long depthPasses;
+	long long depthFails;
+	StageTime clear; // buffers and rasterizer made ready for the draw
+	StageTime transform;
+	StageTime setup;
+	StageTime raster;
+	StageTime resolve;
+};
+
+/**
+ * Sort-middle software rasterizer.
+ * A setup pass projects every triangle and bins it into the TILE_SIZE x
+ * TILE_SIZE screen tiles its bounding box touches. The tiles are then handed
+ * out to the thread pool; a tile is only ever written by the thread that owns
+ * it and its bin is walked in submission order, so the result is identical to
+ * drawing the triangles one after the other on a single core.
+ */
+class Rasterizer
+{
+public:
+	static const int TILE_SIZE = 64;
+	// Sub-pixel steps per pixel of fixed point vertices (24.8)
+	static const int SUBPIXELS = 256;
+	// Fixed point triangles have to stay within this many pixels of the
+	// origin for their edge functions to fit in 64 bits.
+	static const int FIXED_GUARD_BAND = 1 << 21;
+	// Most samples per pixel setSamples takes
+	static const int MAX_SAMPLES = 8;
+
+	// nThreads <= 0 means one worker per hardware thread.
+	Rasterizer(int width, int height, int nThreads = 0);
+	virtual ~Rasterizer();
+	// Draws every triangle of the mesh.
+	// image is RGB8 and depth was reset, both in getLayout() and with
+	// getSamples() planes. Both must already be sized and cleared.
+	void draw(const Mesh &mesh, const RasterParams &params,
+		std::vector<unsigned char> &image, DepthBuffer &depth);
+	// Turns an RGB8 framebuffer drawn in getLayout() into the linear image
+	// the writers expect, sized width x height with the first row at the top.
+	// Multisampled framebuffers are averaged down to one sample per pixel.
+	void resolve(const std::vector<unsigned char> &framebuffer, std::vector<unsigned char> &image);
+	int getThreadCount() const;
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
+	// Restricts drawing to the w x h rectangle whose top left pixel is
+	// (x, y) in image coordinates (origin at the top left, like the output
+	// file). It is clamped to the image; by default it covers all of it.
+	void setScissor(int x, int y, int w, int h);
+	const RasterStats &getStats() const { return stats; }
+	// Hierarchical depth rejection for the shaders that depth test. On by
+	// default; it never changes the image.
+	void setHiZ(bool enabled) { useHiZ = enabled; }
+	// Winding based culling, Back by default. The bounding box view (task 1)
+	// does not test coverage and draws every triangle regardless.
+	void setCullMode(CullMode mode) { cull = mode; }
+	CullMode getCullMode() const { return cull; }
+	// Vector width for the span kernels. Defaults to the best the CPU
+	// supports; asking for more than that falls back to what is supported.
+	void setSimdLevel(SimdLevel level);
+	SimdLevel getSimdLevel() const { return simd; }
+	// Fixed point coverage. Vertices are snapped to 1/SUBPIXELS of a pixel
+	// and the edge functions evaluated exactly in integers, with a top-left
+	// fill rule: a pixel centre exactly on an edge belongs to the triangle
+	// only if that is a top edge (horizontal, with the triangle below it in
+	// the image) or a left edge. Triangles sharing an edge then never both
+	// cover a pixel and never both miss one, and coverage no longer depends
+	// on rounding. Off by default, which keeps the float edge test with its
+	// EDGE_EPSILON tolerance. A triangle outside FIXED_GUARD_BAND is drawn the
+	// float way regardless.
+	void setFixedPoint(bool enabled) { fixedPoint = enabled; }
+	bool getFixedPoint() const { return fixedPoint; }
+	// Tiled framebuffers (see FrameLayout) use TILE_SIZE tiles, so every tile
+	// the rasterizer hands to a worker is one block of memory. Linear by
+	// default, which draws straight into the image.
+	void setTiledFramebuffer(bool enabled);
+	const FrameLayout &getLayout() const { return layout; }
+	// Multisampling with 1 (off, the default), 2, 4 or 8 samples per pixel,
+	// at the positions of the standard rotated grid (2x, 4x) and sparse (8x)
+	// patterns. Coverage and depth are tested per sample. Colors are shaded
+	// once per pixel and triangle, at the pixel centre, and stored in every
+	// covered sample; only the depth view, whose color is the depth, shades
+	// each sample. Hi-Z rejection is off while multisampling. Returns false,
+	// changing nothing, for any other count.
+	bool setSamples(int n);
+	int getSamples() const { return samples; }
+
+private:
+	// Edge function of the directed edge (x0, y0) -> (x0 + dx, y0 + dy).
+	// It is linear in the pixel position, so moving one pixel to the right
+	// adds stepX() and moving one row up adds stepY().
+	struct Edge {
+		float x0, y0, dx, dy;
+		float at(float x, float y) const { return dx * (y - y0) - dy * (x - x0); }
+		float stepX() const { return -dy; }
+		float stepY() const { return dx; }
+	};
+
+	// Screen space triangle after projection, with its pixel bounding box
+	// clamped to the scissor. The box is half open: [minX, maxX) x [minY, maxY).
+	// invArea is 1 / (ABP + BCP + CAP), which is the same for every pixel.
+	// Clockwise triangles that are drawn get all three edges and invArea
+	// negated, which makes their inside positive without changing any
+	// barycentric.
+	// zNear is a lower bound on any depth interpolated inside the triangle.
+	// fixed is set when the triangle got snapped and has a FixedSetup.
+	struct TriSetup {
+		Point a, b, c;
+		int minX, minY, maxX, maxY;
+		Edge ab, bc, ca;
+		float invArea;
+		float zNear;
+		bool fixed;
+	};
+
+	// The same edge function on vertices in 1/SUBPIXELS units, evaluated
+	// exactly. bias is 0 for an edge the fill rule puts pixels on into the
+	// triangle and -1 for the others, so a pixel is covered when at() + bias
+	// is not negative for all three edges.
+	struct FixedEdge {
+		int64_t x0, y0, dx, dy;
+		int64_t bias;
+		int64_t at(int64_t x, int64_t y) const { return dx * (y - y0) - dy * (x - x0); }
+		int64_t atPixel(int x, int y) const { return at((int64_t)x * SUBPIXELS, (int64_t)y * SUBPIXELS); }
+		int64_t stepX() const { return -dy * SUBPIXELS; }
+	};
+
+	// Fixed point edges of a snapped triangle, kept apart from TriSetup so
+	// that float rasterization does not pay for them.
+	struct FixedSetup {
+		FixedEdge ab, bc, ca;
+	};
+
+	void setupRange(int chunk, const Mesh &mesh, bool coverage);
+	// Both are instantiated once per shader policy (see Shaders.h).
+	// drawTiles runs the setup pass and then rasterizes every tile.
+	template<class Shader>
+	void drawTiles(const Shader &shader, const Mesh &mesh,
+		const RasterParams &params, std::vector<unsigned char> &image, DepthBuffer &depth);
+	template<class Shader>
+	void rasterizeTile(int tile, const Shader &shader, const Mesh &mesh,
+		std::vector<unsigned char> &image, DepthBuffer &depth, RasterStats &tileStats);
+	// Adds what shading one span did to the pixel counters
+	static void countSpan(RasterStats &tileStats, int tested, SpanCounts counts)
+	{
+		tileStats.pixelsTested += tested;
+		tileStats.pixelsCovered += counts.covered;
+		tileStats.pixelsWritten += counts.written;
+	}
+	// One row of a triangle when multisampling. span is set up for the row
+	// at the pixel centres, the way rasterizeTile shades it otherwise, and
+	// at is the storage position of its first pixel.
+	template<class Shader>
+	void shadeSamples(const Shader &shader, const TriSetup &s, const FixedSetup *f,
+		SpanSetup span, int xBegin, int y, size_t at, std::vector<unsigned char> &image,
+		DepthBuffer &depth, RasterStats &tileStats);
+
+	int width;
+	int height;
+	int tilesX;
+	int tilesY;
+	std::unique_ptr<ThreadPool> pool;
+	SimdLevel simd;
+	// Projected position of every unique vertex of the mesh
+	std::vector<Point> projected;
+	std::vector<TriSetup> setup;
+	std::vector<FixedSetup> fixedSetup;
+	// Scissor rectangle in raster coordinates (y up), half open
+	int scissorMinX, scissorMinY, scissorMaxX, scissorMaxY;
+	RasterStats stats;
+	std::vector<RasterStats> chunkStats;
+	std::vector<RasterStats> workerStats;
+	bool useHiZ;
+	bool fixedPoint;
+	FrameLayout layout;
+	int samples;
+	// How far the samples reach from the pixel centre, in pixels and in
+	// fixed point units
+	float sampleReach;
+	int64_t fixedSampleReach;
+	CullMode cull;
+	HiZBuffer hiz;
+	// bins[chunk][tile] lists the triangles of one contiguous chunk of the
+	// input that touch the tile. Chunks are visited in order when a tile is
+	// rasterized, which keeps the overall triangle order intact.
+	std::vector<std::vector<std::vector<int> > > bins;
+	int chunkSize;
+};
+
+#endif
@@ -0,0 +1,149 @@
+#include "RenderJob.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+
+#include "ThreadPool.h"
+
+using namespace std;
+
+namespace {
+
+//function to compute bounding box for whole object
+void computeBoundingBox(const Mesh& mesh, float& minX, float& minY, float& maxX, float& maxY)
+{
+	// Kept with the mesh, so this is free for a cached mesh
+	minX = mesh.getBoundsMin()[0];
+	minY = mesh.getBoundsMin()[1];
+	maxX = mesh.getBoundsMax()[0];
+	maxY = mesh.getBoundsMax()[1];
+}
+
+void rotate(float& x, float& y, float& z, float theta) {
+	float cosTheta = cos(theta);
+	float sinTheta = sin(theta);
+
+	float xNew = cosTheta * x + sinTheta * z;
+	float zNew = -sinTheta * x + cosTheta * z;
+
+	x = xNew;
+	z = zNew;
+}
+
+// Copies the vertices of mesh into vertices, turns them by theta and points
+// rotated at them. rotated shares the index buffer of mesh, so it must not
+// outlive mesh or vertices. minZ and maxZ get the depth range after turning,
+// which the bounds of mesh no longer describe.
+void rotatedCopy(const Mesh &mesh, float theta, Mesh::FloatArray vertices[6], Mesh &rotated,
+	float &minZ, float &maxZ)
+{
+	const float *source[6] = { mesh.getX(), mesh.getY(), mesh.getZ(),
+		mesh.getNX(), mesh.getNY(), mesh.getNZ() };
+	float *components[6];
+	for (int k = 0; k < 6; k++) {
+		vertices[k].assign(source[k], source[k] + mesh.getVertexCount());
+		components[k] = vertices[k].data();
+	}
+	// Once per unique vertex, not per triangle corner
+	float *x = components[0], *y = components[1], *z = components[2];
+	float *nx = components[3], *ny = components[4], *nz = components[5];
+	minZ = numeric_limits<float>::max();
+	maxZ = -numeric_limits<float>::max();
+	for (int i = 0; i < mesh.getVertexCount(); i++) {
+		rotate(x[i], y[i], z[i], theta);
+		rotate(nx[i], ny[i], nz[i], theta);
+		minZ = min(minZ, z[i]);
+		maxZ = max(maxZ, z[i]);
+	}
+	rotated.setExternal(nullptr, components, mesh.getIndices(), mesh.getVertexCount(),
+		mesh.getIndexCount(), mesh.getBoundsMin(), mesh.getBoundsMax());
+}
+
+}
+
+float defaultRotation(int task)
+{
+	float theta = 3.14 / 4.0f;
+	return task == 8 ? theta : 0.0f;
+}
+
+RasterParams frameMesh(const Mesh &mesh, int imageWidth, int imageHeight, int task)
+{
+	float minX, minY, maxX, maxY;
+	computeBoundingBox(mesh, minX, minY, maxX, maxY);
+
+	float bboxWidth = maxX - minX;
+	float bboxHeight = maxY - minY;
+	float scale = min(static_cast<float>(imageWidth) / bboxWidth, static_cast<float>(imageHeight) / bboxHeight);
+	Point translation = {
+		static_cast<float>(imageWidth) / 2.0f - scale * (minX + maxX) / 2.0f,
+		static_cast<float>(imageHeight) / 2.0f - scale * (minY + maxY) / 2.0f
+	};
+
+	RasterParams params;
+	params.task = task;
+	params.scale = scale;
+	params.translation = translation;
+	//object bounding box after translation. The projection only scales
+	//and shifts, so the extremes come from the extremes of the mesh.
+	params.minY = projectToImage(minX, minY, scale, translation).y;
+	params.maxY = projectToImage(maxX, maxY, scale, translation).y;
+	//global min and max Z values
+	params.minZ = mesh.getBoundsMin()[2];
+	params.maxZ = mesh.getBoundsMax()[2];
+	return params;
+}
+
+void renderFrame(const Mesh &mesh, const RasterParams &params, int imageWidth, int imageHeight,
+	float rotation, const RenderOptions &options, int nThreads, FrameBuffers &buffers,
+	RasterStats &stats)
+{
+	Stopwatch timer;
+	Mesh rotated;
+	float minZ = params.minZ, maxZ = params.maxZ;
+	if (rotation != 0.0f) {
+		rotatedCopy(mesh, rotation, buffers.vertices, rotated, minZ, maxZ);
+	}
+	StageTime rotate = timer.lap();
+
+	unique_ptr<Rasterizer> &rasterizer = buffers.rasterizer;
+	int threads = nThreads > 0 ? nThreads : ThreadPool::defaultThreadCount();
+	if (!rasterizer || rasterizer->getWidth() != imageWidth || rasterizer->getHeight() != imageHeight ||
+		rasterizer->getThreadCount() != threads) {
+		rasterizer.reset(new Rasterizer(imageWidth, imageHeight, threads));
+	}
+	rasterizer->setSimdLevel(options.simd);
+	rasterizer->setHiZ(options.hiz);
+	rasterizer->setFixedPoint(options.fixedPoint);
+	rasterizer->setTiledFramebuffer(options.tiled);
+	rasterizer->setSamples(options.samples);
+	rasterizer->setCullMode(options.cull);
+	if (options.crop) {
+		rasterizer->setScissor(options.cropX, options.cropY, options.cropW, options.cropH);
+	}
+
+	// Unorm depths are spread over the depth range of what gets drawn
+	const FrameLayout &layout = rasterizer->getLayout();
+	int samples = rasterizer->getSamples();
+	buffers.depth.reset(layout, options.depthFormat, minZ, maxZ, samples);
+	bool resolve = layout.isTiled() || samples > 1;
+	vector<unsigned char> &target = resolve ? buffers.framebuffer : buffers.image;
+	target.assign(layout.size() * samples * 3, 0);
+	StageTime clear = timer.lap();
+	rasterizer->draw(rotation != 0.0f ? rotated : mesh, params, target, buffers.depth);
+	if (resolve) {
+		rasterizer->resolve(buffers.framebuffer, buffers.image);
+	}
+	stats = rasterizer->getStats();
+	stats.transform += rotate;
+	stats.clear = clear;
+}
+
+void renderJob(const Mesh &mesh, const RenderJob &job, const RenderOptions &options,
+	int nThreads, FrameBuffers &buffers, RasterStats &stats)
+{
+	RasterParams params = frameMesh(mesh, job.width, job.height, job.task);
+	renderFrame(mesh, params, job.width, job.height, job.rotation, options, nThreads, buffers, stats);
+}
@@ -0,0 +1,83 @@
+#pragma once
+#ifndef _RENDERJOB_H_
+#define _RENDERJOB_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "DepthBuffer.h"
+#include "ImageWriter.h"
+#include "Mesh.h"
+#include "Rasterizer.h"
+#include "SpanKernels.h"
+
+/**
+ * One image to render: which mesh, where to write it, at what size, in
+ * which task's style. rotation is an angle in radians about the y axis that
+ * is applied to the mesh after it has been framed, the way task 8 does it.
+ * format is the file format of the output, usually formatFromFilename of it.
+ */
+struct RenderJob {
+	std::string meshName;
+	std::string outputName;
+	ImageFormat format;
+	int width;
+	int height;
+	int task;
+	float rotation;
+};
+
+// The rotation a task gets when none is asked for: task 8 turns the mesh by
+// 3.14/4, the others leave it alone.
+float defaultRotation(int task);
+
+// Rasterizer settings shared by every job of a run
+struct RenderOptions {
+	SimdLevel simd;
+	bool hiz;
+	bool fixedPoint;
+	bool tiled;
+	int samples; // 1, 2, 4 or 8
+	DepthFormat depthFormat;
+	CullMode cull;
+	bool crop;
+	int cropX, cropY, cropW, cropH;
+};
+
+/**
+ * Everything one render writes to, kept so that the next render on the same
+ * thread can reuse the storage: the image, the depth buffer, the rotated
+ * vertices and the rasterizer with its bins. One per concurrent render.
+ * With a tiled or multisampled framebuffer the colors are drawn into
+ * framebuffer and resolved into image afterwards; the depth buffer is in the
+ * rasterizer's layout either way.
+ */
+struct FrameBuffers {
+	std::vector<unsigned char> image; // RGB8, first row at the top
+	std::vector<unsigned char> framebuffer;
+	DepthBuffer depth;
+	Mesh::FloatArray vertices[6];
+	std::unique_ptr<Rasterizer> rasterizer;
+};
+
+// Fits the bounds of mesh into a width x height image and fills in the
+// parameters for drawing it in the task's style. Only needs the bounds, so
+// frames that just rotate the mesh can share the result.
+RasterParams frameMesh(const Mesh &mesh, int width, int height, int task);
+
+// Draws mesh with params (from frameMesh) into buffers.image, which gets
+// resized and cleared. A non-zero rotation turns a copy of the vertices in
+// buffers about the y axis first and leaves mesh untouched, so meshes can be
+// shared between renders running at the same time. nThreads is the number
+// of rasterizer threads (<= 0: one per hardware thread). stats gets the
+// counters and stage times of the draw.
+void renderFrame(const Mesh &mesh, const RasterParams &params, int width, int height,
+	float rotation, const RenderOptions &options, int nThreads, FrameBuffers &buffers,
+	RasterStats &stats);
+
+// frameMesh and renderFrame for one job.
+void renderJob(const Mesh &mesh, const RenderJob &job, const RenderOptions &options,
+	int nThreads, FrameBuffers &buffers, RasterStats &stats);
+
+#endif
@@ -0,0 +1,181 @@
+#include "Sequence.h"
+
+#include <algorithm>
+#include <cctype>
+#include <condition_variable>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include "ImageEncoder.h"
+#include "Mesh.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+namespace {
+
+bool hasSuffix(const string &s, const string &suffix)
+{
+	return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Finds the single %d (with optional flags and width, like %04d) in a
+// frame name pattern. Returns false if there is none, or anything else
+// printf would expand.
+bool findConversion(const string &pattern, bool &found)
+{
+	found = false;
+	for(size_t i = 0; i < pattern.size(); i++) {
+		if(pattern[i] != '%') {
+			continue;
+		}
+		if(i + 1 < pattern.size() && pattern[i + 1] == '%') {
+			i++;
+			continue;
+		}
+		size_t j = i + 1;
+		while(j < pattern.size() && (pattern[j] == '0' || pattern[j] == '-' || isdigit((unsigned char)pattern[j]))) {
+			j++;
+		}
+		if(found || j >= pattern.size() || pattern[j] != 'd') {
+			return false;
+		}
+		found = true;
+		i = j;
+	}
+	return true;
+}
+
+}
+
+bool sequenceToStdout(const SequenceSpec &spec)
+{
+	return spec.output == "-";
+}
+
+bool renderSequence(const Mesh &mesh, const SequenceSpec &spec, const RenderOptions &options,
+	int nThreads, int nEncoders, PngLevel pngLevel, ostream &log)
+{
+	bool stream = sequenceToStdout(spec) || hasSuffix(spec.output, ".rgb");
+	string pattern = spec.output;
+	FILE *out = nullptr;
+	if(stream) {
+		if(sequenceToStdout(spec)) {
+			out = stdout;
+#ifdef _WIN32
+			_setmode(_fileno(stdout), _O_BINARY);
+#endif
+		} else {
+			out = fopen(spec.output.c_str(), "wb");
+			if(!out) {
+				cerr << "Failed to open output file " << spec.output << endl;
+				return false;
+			}
+		}
+	} else {
+		bool found;
+		if(!findConversion(pattern, found)) {
+			cerr << "Bad frame name pattern " << pattern << " (use one %d, like frame_%04d.png)" << endl;
+			return false;
+		}
+		if(!found) {
+			size_t dot = pattern.find_last_of('.');
+			size_t slash = pattern.find_last_of("/\\");
+			if(dot == string::npos || (slash != string::npos && dot < slash)) {
+				dot = pattern.size();
+			}
+			pattern.insert(dot, "_%04d");
+		}
+	}
+
+	// Framing only depends on the bounds, which the rotation does not touch
+	RasterParams params = frameMesh(mesh, spec.width, spec.height, spec.task);
+
+	// Whole frames run in parallel. Any threads left over when there are
+	// fewer frames than threads go to the rasterizer of each frame.
+	int threads = nThreads > 0 ? nThreads : ThreadPool::defaultThreadCount();
+	int concurrent = max(1, min(threads, spec.frames));
+	int perFrame = max(1, threads / concurrent);
+	ThreadPool pool(concurrent);
+	vector<FrameBuffers> buffers(concurrent);
+	vector<vector<unsigned char> > encoded(concurrent); // stream frames
+
+	mutex mtx;
+	condition_variable turn;
+	int nextToWrite = 0; // streams get the frames in order
+	bool ok = true;
+	size_t frameBytes = (size_t)spec.width * spec.height * 3;
+
+	auto frameDone = [&](int i, float angle, const string &name, bool written) {
+		lock_guard<mutex> lock(mtx);
+		if(written) {
+			log << "Frame " << i << " (" << angle << " rad) written to " << name << endl;
+		} else {
+			ok = false;
+			cerr << "Failed to write frame " << i << " to " << name << endl;
+		}
+	};
+	// Numbered images go through the encoder, streams are written in order
+	unique_ptr<ImageEncoder> encoder;
+	if(!stream) {
+		encoder.reset(new ImageEncoder(nEncoders, 0, pngLevel));
+	}
+
+	pool.parallelFor(spec.frames, [&](int i, int worker) {
+		float angle = (float)(spec.startAngle + ((double)spec.endAngle - spec.startAngle) * i / spec.frames);
+		RasterStats stats;
+		FrameBuffers &frame = buffers[worker];
+		renderFrame(mesh, params, spec.width, spec.height, angle, options, perFrame, frame, stats);
+
+		if(stream) {
+			// Raw video is the image as it is, anything else gets encoded
+			// before waiting for its turn
+			const unsigned char *data = frame.image.data();
+			size_t size = frameBytes;
+			if(spec.format != ImageFormat::Rgb) {
+				encodeImage(encoded[worker], spec.format, spec.width, spec.height, 3,
+					frame.image.data(), spec.width * 3, pngLevel, perFrame);
+				data = encoded[worker].data();
+				size = encoded[worker].size();
+			}
+			// Frames are handed out in order, so the one this waits for is
+			// always being rendered or already done.
+			bool written;
+			{
+				unique_lock<mutex> lock(mtx);
+				turn.wait(lock, [&] { return nextToWrite == i; });
+				written = fwrite(data, 1, size, out) == size;
+				nextToWrite++;
+			}
+			turn.notify_all();
+			frameDone(i, angle, spec.output, written);
+		} else {
+			vector<char> buf(pattern.size() + 32);
+			snprintf(buf.data(), buf.size(), pattern.c_str(), i);
+			string name = buf.data();
+			encoder->submit(name, spec.format, spec.width, spec.height, frame.image,
+				[&frameDone, i, angle, name](bool written) {
+					frameDone(i, angle, name, written);
+				});
+			encoder->recycle(frame.image);
+		}
+	});
+	if(encoder) {
+		encoder->finish();
+	}
+
+	if(out && out != stdout) {
+		ok = fclose(out) == 0 && ok;
+	} else if(out) {
+		ok = fflush(out) == 0 && ok;
+	}
+	return ok;
+}
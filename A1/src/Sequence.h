@@ -0,0 +1,52 @@
+#pragma once
+#ifndef _SEQUENCE_H_
+#define _SEQUENCE_H_
+
+#include <iosfwd>
+#include <string>
+
+#include "ImageWriter.h"
+#include "RenderJob.h"
+
+class Mesh;
+
+/**
+ * A turntable: frames of one mesh turning about the y axis. Frame i of n is
+ * rotated by startAngle + (endAngle - startAngle) * i / n radians, so a full
+ * turn (0 to 2 pi) does not repeat its first frame at the end.
+ *
+ * output is either a file name pattern for numbered images with one printf
+ * style integer conversion in it (frame_%04d.png), or a stream: "-" for
+ * stdout or a name ending in .rgb, which gets every frame back to back in
+ * frame order. A pattern without a conversion gets _%04d inserted before its
+ * extension. Every frame is written in format; as a stream, Rgb makes raw
+ * video (ffmpeg -f rawvideo -pix_fmt rgb24 -s WxH) and Ppm or Qoi a stream
+ * of images that ffmpeg -f image2pipe reads.
+ */
+struct SequenceSpec {
+	std::string output;
+	ImageFormat format;
+	int width;
+	int height;
+	int task;
+	int frames;
+	float startAngle;
+	float endAngle;
+};
+
+// Whether spec.output asks for a stream on stdout. Nothing but frames may
+// go to stdout then.
+bool sequenceToStdout(const SequenceSpec &spec);
+
+// Renders every frame of the sequence. The mesh is framed once, by its
+// bounds before any rotation, so it stays put while it turns. Frames are
+// spread over nThreads threads (<= 0: one per hardware thread), each with
+// its own FrameBuffers. Numbered images are encoded on nEncoders threads
+// (<= 0: the ImageEncoder default), PNGs at pngLevel, while later frames
+// render; stream frames are encoded by the thread that rendered them and
+// written in frame order. Progress goes to log. Returns false if an output
+// could not be written.
+bool renderSequence(const Mesh &mesh, const SequenceSpec &spec, const RenderOptions &options,
+	int nThreads, int nEncoders, PngLevel pngLevel, std::ostream &log);
+
+#endif
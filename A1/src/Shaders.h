@@ -0,0 +1,224 @@
+#pragma once
+#ifndef _SHADERS_H_
+#define _SHADERS_H_
+
+#include <algorithm>
+
+#include "Mesh.h"
+#include "Rasterizer.h"
+#include "SpanKernels.h"
+
+/**
+ * Shader policies for the Rasterizer, one per task. The tile loop is a
+ * template that gets instantiated once per policy, so each mode is compiled
+ * into its own loop with no per-pixel task checks, and adding a mode does not
+ * touch the others. A policy provides
+ *
+ *   static const bool USES_DEPTH
+ *     whether it depth tests, which turns on Hi-Z rejection,
+ *   static const bool USES_COVERAGE
+ *     whether it tests coverage at all, which turns on culling,
+ *   static const bool PER_SAMPLE
+ *     whether, when multisampling, span() runs once per sample with the
+ *     samples' own coverage and depth planes instead of once per pixel at
+ *     the centre with all samples treated as covered,
+ *   void triangle(int index, const Mesh &mesh, const uint32_t *corners,
+ *       SpanSetup &span) const
+ *     fills in the per-triangle attributes (attrA/B/C) of the span from the
+ *     mesh vertices corners[0..2], and
+ *   SpanCounts span(const SpanSetup &span, int flippedY) const
+ *     shades one row of the triangle and says how many pixels it covered
+ *     and wrote. flippedY is the image row.
+ */
+
+static const double RANDOM_COLORS[7][3] = {
+	{0.0000,    0.4470,    0.7410},
+	{0.8500,    0.3250,    0.0980},
+	{0.9290,    0.6940,    0.1250},
+	{0.4940,    0.1840,    0.5560},
+	{0.4660,    0.6740,    0.1880},
+	{0.3010,    0.7450,    0.9330},
+	{0.6350,    0.0780,    0.1840},
+};
+
+// Writes the triangle's color to every pixel of a covered span (or of the
+// whole bounding box if Box is set). The triangle color is kept in attrA.
+template<bool Box>
+struct FlatShaderBase {
+	static const bool USES_DEPTH = false;
+	static const bool USES_COVERAGE = !Box;
+	static const bool PER_SAMPLE = false;
+
+	void triangle(int i, const Mesh &, const uint32_t *, SpanSetup &span) const
+	{
+		const double *color = RANDOM_COLORS[i % 7];
+		span.attrA[0] = static_cast<unsigned char>(color[0] * 255);
+		span.attrA[1] = static_cast<unsigned char>(color[1] * 255);
+		span.attrA[2] = static_cast<unsigned char>(color[2] * 255);
+	}
+	SpanCounts span(const SpanSetup &span, int) const
+	{
+		unsigned char r = static_cast<unsigned char>(span.attrA[0]);
+		unsigned char g = static_cast<unsigned char>(span.attrA[1]);
+		unsigned char b = static_cast<unsigned char>(span.attrA[2]);
+		float alpha, beta, gamma;
+		int covered = 0;
+		for(int k = span.start; k < span.count; k++) {
+			if(Box || spanCoverage(span, k, alpha, beta, gamma)) {
+				span.rgb[3*k + 0] = r;
+				span.rgb[3*k + 1] = g;
+				span.rgb[3*k + 2] = b;
+				covered++;
+			}
+		}
+		return { covered, covered };
+	}
+};
+
+// Task 1: bounding boxes
+typedef FlatShaderBase<true> BoxShader;
+// Task 2: filled triangles
+typedef FlatShaderBase<false> FlatShader;
+
+// Task 3: per-vertex colors, interpolated with the barycentrics
+struct VertexColorShader {
+	static const bool USES_DEPTH = false;
+	static const bool USES_COVERAGE = true;
+	static const bool PER_SAMPLE = false;
+
+	void triangle(int i, const Mesh &, const uint32_t *, SpanSetup &span) const
+	{
+		int vertexCount = (i * 9)/3;
+		int indx1 = vertexCount + 2;
+		int indx2 = vertexCount;
+		int indx3 = vertexCount + 1;
+		if(i == 1) {
+			indx1 = 2;
+			indx2 = 0;
+			indx3 = 1;
+		}
+		for(int c = 0; c < 3; c++) {
+			span.attrA[c] = RANDOM_COLORS[indx1%7][c];
+			span.attrB[c] = RANDOM_COLORS[indx2%7][c];
+			span.attrC[c] = RANDOM_COLORS[indx3%7][c];
+		}
+	}
+	SpanCounts span(const SpanSetup &span, int) const
+	{
+		float alpha, beta, gamma;
+		int covered = 0;
+		for(int k = span.start; k < span.count; k++) {
+			if(!spanCoverage(span, k, alpha, beta, gamma)) {
+				continue;
+			}
+			covered++;
+			//for this barycentric calculation and anywhere else appearing, I asked chatGPT to give me the equation
+			float r = alpha * span.attrA[0] + beta * span.attrB[0] + gamma * span.attrC[0];
+			float g = alpha * span.attrA[1] + beta * span.attrB[1] + gamma * span.attrC[1];
+			float b = alpha * span.attrA[2] + beta * span.attrB[2] + gamma * span.attrC[2];
+			span.rgb[3*k + 0] = static_cast<unsigned char>(saturate(r) * 255);
+			span.rgb[3*k + 1] = static_cast<unsigned char>(saturate(g) * 255);
+			span.rgb[3*k + 2] = static_cast<unsigned char>(saturate(b) * 255);
+		}
+		return { covered, covered };
+	}
+};
+
+// Task 4: red to blue gradient over the projected height of the object.
+// The color only depends on the row, so it is computed once per span.
+struct GradientShader {
+	static const bool USES_DEPTH = false;
+	static const bool USES_COVERAGE = true;
+	static const bool PER_SAMPLE = false;
+	float minY, maxY;
+
+	void triangle(int, const Mesh &, const uint32_t *, SpanSetup &) const {}
+	SpanCounts span(const SpanSetup &span, int flippedY) const
+	{
+		float normalizedY = (flippedY - minY) / (maxY - minY);
+		normalizedY = std::max(0.0f, std::min(1.0f, normalizedY));
+		unsigned char red = static_cast<unsigned char>(255 * (1 - normalizedY));
+		unsigned char blue = static_cast<unsigned char>(255 * normalizedY);
+		float alpha, beta, gamma;
+		int covered = 0;
+		for(int k = span.start; k < span.count; k++) {
+			if(spanCoverage(span, k, alpha, beta, gamma)) {
+				span.rgb[3*k + 0] = red;
+				span.rgb[3*k + 1] = 0;
+				span.rgb[3*k + 2] = blue;
+				covered++;
+			}
+		}
+		return { covered, covered };
+	}
+};
+
+// Task 5: z-buffered depth view
+struct DepthShader {
+	static const bool USES_DEPTH = true;
+	static const bool USES_COVERAGE = true;
+	static const bool PER_SAMPLE = true;
+	SimdLevel simd;
+	float minZ, maxZ;
+	const DepthBuffer *depth;
+
+	void triangle(int, const Mesh &mesh, const uint32_t *corners, SpanSetup &span) const
+	{
+		const float *z = mesh.getZ();
+		span.attrA[0] = z[corners[0]];
+		span.attrB[0] = z[corners[1]];
+		span.attrC[0] = z[corners[2]];
+	}
+	SpanCounts span(const SpanSetup &span, int) const
+	{
+		return shadeDepthSpan(simd, span, minZ, maxZ, *depth);
+	}
+};
+
+// Normals are the attribute for both the normal and the Lambert view.
+inline void normalAttributes(const Mesh &mesh, const uint32_t *corners, SpanSetup &span)
+{
+	float *attr[3] = { span.attrA, span.attrB, span.attrC };
+	for(int k = 0; k < 3; k++) {
+		attr[k][0] = mesh.getNX()[corners[k]];
+		attr[k][1] = mesh.getNY()[corners[k]];
+		attr[k][2] = mesh.getNZ()[corners[k]];
+	}
+}
+
+// Task 6: normal view
+struct NormalShader {
+	static const bool USES_DEPTH = false;
+	static const bool USES_COVERAGE = true;
+	static const bool PER_SAMPLE = false;
+	SimdLevel simd;
+
+	void triangle(int, const Mesh &mesh, const uint32_t *corners, SpanSetup &span) const
+	{
+		normalAttributes(mesh, corners, span);
+	}
+	SpanCounts span(const SpanSetup &span, int) const
+	{
+		return shadeNormalSpan(simd, span);
+	}
+};
+
+// Tasks 7 and 8: Lambert shading. Task 8 rotates the mesh before it gets
+// here, so both use the same policy.
+struct LambertShader {
+	static const bool USES_DEPTH = false;
+	static const bool USES_COVERAGE = true;
+	static const bool PER_SAMPLE = false;
+	SimdLevel simd;
+
+	void triangle(int, const Mesh &mesh, const uint32_t *corners, SpanSetup &span) const
+	{
+		normalAttributes(mesh, corners, span);
+	}
+	SpanCounts span(const SpanSetup &span, int) const
+	{
+		return shadeLambertSpan(simd, span);
+	}
+};
+
+#endif
@@ -0,0 +1,596 @@
+#include "SpanKernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SPAN_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang only emit AVX2 code inside functions marked for it, which
+// lets the rest of the program run on any x86-64 CPU. MSVC needs no marking.
+#if defined(__GNUC__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+using namespace std;
+
+SimdLevel detectSimdLevel()
+{
+#if defined(SPAN_X86) && defined(__GNUC__)
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2")) {
+		return SimdLevel::AVX2;
+	}
+	return __builtin_cpu_supports("sse2") ? SimdLevel::SSE2 : SimdLevel::Scalar;
+#elif defined(SPAN_X86) && defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if(info[0] >= 7) {
+		__cpuidex(info, 7, 0);
+		if(info[1] & (1 << 5)) {
+			return SimdLevel::AVX2;
+		}
+	}
+	__cpuid(info, 1);
+	return (info[3] & (1 << 26)) ? SimdLevel::SSE2 : SimdLevel::Scalar;
+#else
+	return SimdLevel::Scalar;
+#endif
+}
+
+const char *simdLevelName(SimdLevel level)
+{
+	switch(level) {
+	case SimdLevel::AVX2: return "avx2";
+	case SimdLevel::SSE2: return "sse2";
+	default: return "scalar";
+	}
+}
+
+bool parseSimdLevel(const string &name, SimdLevel &level)
+{
+	if(name == "scalar") {
+		level = SimdLevel::Scalar;
+	} else if(name == "sse2") {
+		level = SimdLevel::SSE2;
+	} else if(name == "avx2") {
+		level = SimdLevel::AVX2;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+//
+// Scalar reference. The vector kernels below perform exactly these
+// operations (and those of spanCoverage) in exactly this order, one lane per
+// pixel.
+//
+
+// What the depth buffer holds per pixel in each format
+template<DepthFormat Format>
+using DepthValue = typename conditional<Format == DepthFormat::Float32, float,
+	typename conditional<Format == DepthFormat::Unorm16, uint16_t, uint32_t>::type>::type;
+
+template<DepthFormat Format>
+static inline void depthPixel(const SpanSetup &s, int k, float minZ, float rangeZ, const DepthBuffer &d,
+	SpanCounts &counts)
+{
+	float alpha, beta, gamma;
+	if(!spanCoverage(s, k, alpha, beta, gamma)) {
+		return;
+	}
+	counts.covered++;
+	float z = alpha * s.attrA[0] + beta * s.attrB[0] + gamma * s.attrC[0];
+	DepthValue<Format> *depth = static_cast<DepthValue<Format> *>(s.depth);
+	if constexpr(Format == DepthFormat::Float32) {
+		if(!(z < depth[k])) {
+			return;
+		}
+		depth[k] = z;
+	} else {
+		int q = d.quantize(z);
+		if(!(q < (int)depth[k])) {
+			return;
+		}
+		depth[k] = static_cast<DepthValue<Format> >(q);
+	}
+	counts.written++;
+	float normalizedZ = (z - minZ) / rangeZ;
+	normalizedZ = clamp(normalizedZ, 0.0f, 1.0f);
+	s.rgb[3*k + 0] = static_cast<unsigned char>(normalizedZ * 255);
+	s.rgb[3*k + 1] = 0;
+	s.rgb[3*k + 2] = 0;
+}
+
+static inline void normalPixel(const SpanSetup &s, int k, SpanCounts &counts)
+{
+	float alpha, beta, gamma;
+	if(!spanCoverage(s, k, alpha, beta, gamma)) {
+		return;
+	}
+	counts.covered++;
+	counts.written++;
+	float nx = alpha * s.attrA[0] + beta * s.attrB[0] + gamma * s.attrC[0];
+	float ny = alpha * s.attrA[1] + beta * s.attrB[1] + gamma * s.attrC[1];
+	float nz = alpha * s.attrA[2] + beta * s.attrB[2] + gamma * s.attrC[2];
+	s.rgb[3*k + 0] = static_cast<unsigned char>(255 * saturate(0.5f * nx + 0.5f));
+	s.rgb[3*k + 1] = static_cast<unsigned char>(255 * saturate(0.5f * ny + 0.5f));
+	s.rgb[3*k + 2] = static_cast<unsigned char>(255 * saturate(0.5f * nz + 0.5f));
+}
+
+static inline void lambertPixel(const SpanSetup &s, int k, float l, SpanCounts &counts)
+{
+	float alpha, beta, gamma;
+	if(!spanCoverage(s, k, alpha, beta, gamma)) {
+		return;
+	}
+	counts.covered++;
+	counts.written++;
+	float nx = alpha * s.attrA[0] + beta * s.attrB[0] + gamma * s.attrC[0];
+	float ny = alpha * s.attrA[1] + beta * s.attrB[1] + gamma * s.attrC[1];
+	float nz = alpha * s.attrA[2] + beta * s.attrB[2] + gamma * s.attrC[2];
+	float c = saturate(l * nx + l * ny + l * nz);
+	unsigned char rgb = static_cast<unsigned char>(255 * c);
+	s.rgb[3*k + 0] = rgb;
+	s.rgb[3*k + 1] = rgb;
+	s.rgb[3*k + 2] = rgb;
+}
+
+// Light direction component, (1, 1, 1)/sqrt(3)
+static float lightComponent()
+{
+	return 1.0f / sqrt(3.0f);
+}
+
+#ifdef SPAN_X86
+
+// Number of lanes set in a movemask of up to 8 lanes, without branches
+static inline int laneCount(int mask)
+{
+	mask = mask - ((mask >> 1) & 0x55);
+	mask = (mask & 0x33) + ((mask >> 2) & 0x33);
+	return (mask + (mask >> 4)) & 0x0f;
+}
+
+// Writes the low byte of r/g/b for every lane set in mask, which is what a
+// float to unsigned char cast does for the scalar kernel.
+static inline void storeRGB(unsigned char *rgb, int mask, const int *r, const int *g, const int *b)
+{
+	while(mask) {
+		int lane = 0;
+		while(!(mask & (1 << lane))) {
+			lane++;
+		}
+		mask &= ~(1 << lane);
+		rgb[3*lane + 0] = static_cast<unsigned char>(r[lane]);
+		rgb[3*lane + 1] = static_cast<unsigned char>(g[lane]);
+		rgb[3*lane + 2] = static_cast<unsigned char>(b[lane]);
+	}
+}
+
+//
+// SSE2, 4 pixels per iteration
+//
+
+static inline __m128 coverage4(const SpanSetup &s, int k, __m128 &alpha, __m128 &beta, __m128 &gamma)
+{
+	__m128 fk = _mm_add_ps(_mm_set1_ps(static_cast<float>(k)), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f));
+	__m128 ABP = _mm_add_ps(_mm_set1_ps(s.e0[0]), _mm_mul_ps(fk, _mm_set1_ps(s.step[0])));
+	__m128 BCP = _mm_add_ps(_mm_set1_ps(s.e0[1]), _mm_mul_ps(fk, _mm_set1_ps(s.step[1])));
+	__m128 CAP = _mm_add_ps(_mm_set1_ps(s.e0[2]), _mm_mul_ps(fk, _mm_set1_ps(s.step[2])));
+	__m128 invArea = _mm_set1_ps(s.invArea);
+	alpha = _mm_mul_ps(ABP, invArea);
+	beta = _mm_mul_ps(BCP, invArea);
+	gamma = _mm_mul_ps(CAP, invArea);
+	if(s.covered) {
+		return _mm_castsi128_ps(_mm_set1_epi32(-1));
+	}
+	__m128 eps = _mm_set1_ps(EDGE_EPSILON);
+	return _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(ABP, eps), _mm_cmpge_ps(BCP, eps)), _mm_cmpge_ps(CAP, eps));
+}
+
+static inline __m128 saturate4(__m128 c)
+{
+	return _mm_min_ps(_mm_max_ps(c, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+}
+
+static inline __m128 interpolate4(__m128 alpha, __m128 beta, __m128 gamma, float a, float b, float c)
+{
+	return _mm_add_ps(_mm_add_ps(_mm_mul_ps(alpha, _mm_set1_ps(a)), _mm_mul_ps(beta, _mm_set1_ps(b))),
+		_mm_mul_ps(gamma, _mm_set1_ps(c)));
+}
+
+// DepthBuffer::quantize of 4 depths
+static inline __m128i quantize4(__m128 z, const DepthBuffer &d)
+{
+	__m128 t = _mm_mul_ps(_mm_sub_ps(z, _mm_set1_ps(d.getQuantMinZ())), _mm_set1_ps(d.getQuantScale()));
+	t = _mm_min_ps(_mm_max_ps(t, _mm_setzero_ps()), _mm_set1_ps(d.getQuantMax()));
+	return _mm_cvttps_epi32(_mm_add_ps(t, _mm_set1_ps(0.5f)));
+}
+
+// Depth test and store of 4 pixels. Returns the lanes that passed.
+template<DepthFormat Format>
+static inline int depthTest4(const SpanSetup &s, int k, __m128 inside, __m128 z, const DepthBuffer &d)
+{
+	DepthValue<Format> *depth = static_cast<DepthValue<Format> *>(s.depth) + k;
+	if constexpr(Format == DepthFormat::Float32) {
+		__m128 old = _mm_loadu_ps(depth);
+		__m128 pass = _mm_and_ps(inside, _mm_cmplt_ps(z, old));
+		int mask = _mm_movemask_ps(pass);
+		if(mask) {
+			_mm_storeu_ps(depth, _mm_or_ps(_mm_and_ps(pass, z), _mm_andnot_ps(pass, old)));
+		}
+		return mask;
+	} else {
+		// Stored values are below 2^24, so signed compares are fine
+		__m128i old;
+		if constexpr(Format == DepthFormat::Unorm16) {
+			old = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i *)depth), _mm_setzero_si128());
+		} else {
+			old = _mm_loadu_si128((const __m128i *)depth);
+		}
+		__m128i q = quantize4(z, d);
+		__m128i pass = _mm_and_si128(_mm_castps_si128(inside), _mm_cmpgt_epi32(old, q));
+		int mask = _mm_movemask_ps(_mm_castsi128_ps(pass));
+		if(!mask) {
+			return 0;
+		}
+		__m128i merged = _mm_or_si128(_mm_and_si128(pass, q), _mm_andnot_si128(pass, old));
+		if constexpr(Format == DepthFormat::Unorm16) {
+			// SSE2 only packs with signed saturation, so shift the range
+			// down by 32768 around the pack
+			__m128i bias = _mm_set1_epi32(32768);
+			__m128i packed = _mm_packs_epi32(_mm_sub_epi32(merged, bias), _mm_sub_epi32(merged, bias));
+			_mm_storel_epi64((__m128i *)depth, _mm_xor_si128(packed, _mm_set1_epi16((short)0x8000)));
+		} else {
+			_mm_storeu_si128((__m128i *)depth, merged);
+		}
+		return mask;
+	}
+}
+
+template<DepthFormat Format>
+static SpanCounts depthSpanSSE2(const SpanSetup &s, float minZ, float rangeZ, const DepthBuffer &d)
+{
+	SpanCounts counts = { 0, 0 };
+	int k = s.start;
+	alignas(16) int r[4];
+	const int zero[4] = { 0, 0, 0, 0 };
+	for(; k + 4 <= s.count; k += 4) {
+		__m128 alpha, beta, gamma;
+		__m128 inside = coverage4(s, k, alpha, beta, gamma);
+		int insideMask = _mm_movemask_ps(inside);
+		if(!insideMask) {
+			continue;
+		}
+		counts.covered += laneCount(insideMask);
+		__m128 z = interpolate4(alpha, beta, gamma, s.attrA[0], s.attrB[0], s.attrC[0]);
+		int mask = depthTest4<Format>(s, k, inside, z, d);
+		if(!mask) {
+			continue;
+		}
+		counts.written += laneCount(mask);
+		__m128 n = _mm_div_ps(_mm_sub_ps(z, _mm_set1_ps(minZ)), _mm_set1_ps(rangeZ));
+		n = _mm_min_ps(_mm_max_ps(n, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+		_mm_store_si128((__m128i *)r, _mm_cvttps_epi32(_mm_mul_ps(n, _mm_set1_ps(255.0f))));
+		storeRGB(s.rgb + 3*k, mask, r, zero, zero);
+	}
+	for(; k < s.count; k++) {
+		depthPixel<Format>(s, k, minZ, rangeZ, d, counts);
+	}
+	return counts;
+}
+
+static SpanCounts normalSpanSSE2(const SpanSetup &s)
+{
+	SpanCounts counts = { 0, 0 };
+	int k = s.start;
+	alignas(16) int r[4], g[4], b[4];
+	__m128 half = _mm_set1_ps(0.5f);
+	__m128 scale = _mm_set1_ps(255.0f);
+	for(; k + 4 <= s.count; k += 4) {
+		__m128 alpha, beta, gamma;
+		int mask = _mm_movemask_ps(coverage4(s, k, alpha, beta, gamma));
+		if(!mask) {
+			continue;
+		}
+		counts.covered += laneCount(mask);
+		__m128 nx = interpolate4(alpha, beta, gamma, s.attrA[0], s.attrB[0], s.attrC[0]);
+		__m128 ny = interpolate4(alpha, beta, gamma, s.attrA[1], s.attrB[1], s.attrC[1]);
+		__m128 nz = interpolate4(alpha, beta, gamma, s.attrA[2], s.attrB[2], s.attrC[2]);
+		_mm_store_si128((__m128i *)r, _mm_cvttps_epi32(_mm_mul_ps(scale, saturate4(_mm_add_ps(_mm_mul_ps(half, nx), half)))));
+		_mm_store_si128((__m128i *)g, _mm_cvttps_epi32(_mm_mul_ps(scale, saturate4(_mm_add_ps(_mm_mul_ps(half, ny), half)))));
+		_mm_store_si128((__m128i *)b, _mm_cvttps_epi32(_mm_mul_ps(scale, saturate4(_mm_add_ps(_mm_mul_ps(half, nz), half)))));
+		storeRGB(s.rgb + 3*k, mask, r, g, b);
+	}
+	counts.written = counts.covered;
+	for(; k < s.count; k++) {
+		normalPixel(s, k, counts);
+	}
+	return counts;
+}
+
+static SpanCounts lambertSpanSSE2(const SpanSetup &s)
+{
+	SpanCounts counts = { 0, 0 };
+	int k = s.start;
+	alignas(16) int c[4];
+	const float l = lightComponent();
+	__m128 lv = _mm_set1_ps(l);
+	for(; k + 4 <= s.count; k += 4) {
+		__m128 alpha, beta, gamma;
+		int mask = _mm_movemask_ps(coverage4(s, k, alpha, beta, gamma));
+		if(!mask) {
+			continue;
+		}
+		counts.covered += laneCount(mask);
+		__m128 nx = interpolate4(alpha, beta, gamma, s.attrA[0], s.attrB[0], s.attrC[0]);
+		__m128 ny = interpolate4(alpha, beta, gamma, s.attrA[1], s.attrB[1], s.attrC[1]);
+		__m128 nz = interpolate4(alpha, beta, gamma, s.attrA[2], s.attrB[2], s.attrC[2]);
+		__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(lv, nx), _mm_mul_ps(lv, ny)), _mm_mul_ps(lv, nz));
+		d = saturate4(d);
+		_mm_store_si128((__m128i *)c, _mm_cvttps_epi32(_mm_mul_ps(_mm_set1_ps(255.0f), d)));
+		storeRGB(s.rgb + 3*k, mask, c, c, c);
+	}
+	counts.written = counts.covered;
+	for(; k < s.count; k++) {
+		lambertPixel(s, k, l, counts);
+	}
+	return counts;
+}
+
+//
+// AVX2, 8 pixels per iteration. Same structure as the SSE2 kernels.
+//
+
+TARGET_AVX2 static inline __m256 coverage8(const SpanSetup &s, int k, __m256 &alpha, __m256 &beta, __m256 &gamma)
+{
+	__m256 fk = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(k)),
+		_mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f));
+	__m256 ABP = _mm256_add_ps(_mm256_set1_ps(s.e0[0]), _mm256_mul_ps(fk, _mm256_set1_ps(s.step[0])));
+	__m256 BCP = _mm256_add_ps(_mm256_set1_ps(s.e0[1]), _mm256_mul_ps(fk, _mm256_set1_ps(s.step[1])));
+	__m256 CAP = _mm256_add_ps(_mm256_set1_ps(s.e0[2]), _mm256_mul_ps(fk, _mm256_set1_ps(s.step[2])));
+	__m256 invArea = _mm256_set1_ps(s.invArea);
+	alpha = _mm256_mul_ps(ABP, invArea);
+	beta = _mm256_mul_ps(BCP, invArea);
+	gamma = _mm256_mul_ps(CAP, invArea);
+	if(s.covered) {
+		return _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+	}
+	__m256 eps = _mm256_set1_ps(EDGE_EPSILON);
+	return _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(ABP, eps, _CMP_GE_OQ), _mm256_cmp_ps(BCP, eps, _CMP_GE_OQ)),
+		_mm256_cmp_ps(CAP, eps, _CMP_GE_OQ));
+}
+
+TARGET_AVX2 static inline __m256 saturate8(__m256 c)
+{
+	return _mm256_min_ps(_mm256_max_ps(c, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+}
+
+TARGET_AVX2 static inline __m256 interpolate8(__m256 alpha, __m256 beta, __m256 gamma, float a, float b, float c)
+{
+	return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(alpha, _mm256_set1_ps(a)), _mm256_mul_ps(beta, _mm256_set1_ps(b))),
+		_mm256_mul_ps(gamma, _mm256_set1_ps(c)));
+}
+
+TARGET_AVX2 static inline __m256i quantize8(__m256 z, const DepthBuffer &d)
+{
+	__m256 t = _mm256_mul_ps(_mm256_sub_ps(z, _mm256_set1_ps(d.getQuantMinZ())), _mm256_set1_ps(d.getQuantScale()));
+	t = _mm256_min_ps(_mm256_max_ps(t, _mm256_setzero_ps()), _mm256_set1_ps(d.getQuantMax()));
+	return _mm256_cvttps_epi32(_mm256_add_ps(t, _mm256_set1_ps(0.5f)));
+}
+
+template<DepthFormat Format>
+TARGET_AVX2 static inline int depthTest8(const SpanSetup &s, int k, __m256 inside, __m256 z, const DepthBuffer &d)
+{
+	DepthValue<Format> *depth = static_cast<DepthValue<Format> *>(s.depth) + k;
+	if constexpr(Format == DepthFormat::Float32) {
+		__m256 old = _mm256_loadu_ps(depth);
+		__m256 pass = _mm256_and_ps(inside, _mm256_cmp_ps(z, old, _CMP_LT_OQ));
+		int mask = _mm256_movemask_ps(pass);
+		if(mask) {
+			_mm256_storeu_ps(depth, _mm256_blendv_ps(old, z, pass));
+		}
+		return mask;
+	} else {
+		__m256i old;
+		if constexpr(Format == DepthFormat::Unorm16) {
+			old = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)depth));
+		} else {
+			old = _mm256_loadu_si256((const __m256i *)depth);
+		}
+		__m256i q = quantize8(z, d);
+		__m256i pass = _mm256_and_si256(_mm256_castps_si256(inside), _mm256_cmpgt_epi32(old, q));
+		int mask = _mm256_movemask_ps(_mm256_castsi256_ps(pass));
+		if(!mask) {
+			return 0;
+		}
+		__m256i merged = _mm256_blendv_epi8(old, q, pass);
+		if constexpr(Format == DepthFormat::Unorm16) {
+			// The pack works within 128 bit lanes; gather the two halves
+			__m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(merged, merged), 0x08);
+			_mm_storeu_si128((__m128i *)depth, _mm256_castsi256_si128(packed));
+		} else {
+			_mm256_storeu_si256((__m256i *)depth, merged);
+		}
+		return mask;
+	}
+}
+
+template<DepthFormat Format>
+TARGET_AVX2 static SpanCounts depthSpanAVX2(const SpanSetup &s, float minZ, float rangeZ, const DepthBuffer &d)
+{
+	SpanCounts counts = { 0, 0 };
+	int k = s.start;
+	alignas(32) int r[8];
+	const int zero[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+	for(; k + 8 <= s.count; k += 8) {
+		__m256 alpha, beta, gamma;
+		__m256 inside = coverage8(s, k, alpha, beta, gamma);
+		int insideMask = _mm256_movemask_ps(inside);
+		if(!insideMask) {
+			continue;
+		}
+		counts.covered += laneCount(insideMask);
+		__m256 z = interpolate8(alpha, beta, gamma, s.attrA[0], s.attrB[0], s.attrC[0]);
+		int mask = depthTest8<Format>(s, k, inside, z, d);
+		if(!mask) {
+			continue;
+		}
+		counts.written += laneCount(mask);
+		__m256 n = _mm256_div_ps(_mm256_sub_ps(z, _mm256_set1_ps(minZ)), _mm256_set1_ps(rangeZ));
+		n = _mm256_min_ps(_mm256_max_ps(n, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+		_mm256_store_si256((__m256i *)r, _mm256_cvttps_epi32(_mm256_mul_ps(n, _mm256_set1_ps(255.0f))));
+		storeRGB(s.rgb + 3*k, mask, r, zero, zero);
+	}
+	for(; k < s.count; k++) {
+		depthPixel<Format>(s, k, minZ, rangeZ, d, counts);
+	}
+	return counts;
+}
+
+TARGET_AVX2 static SpanCounts normalSpanAVX2(const SpanSetup &s)
+{
+	SpanCounts counts = { 0, 0 };
+	int k = s.start;
+	alignas(32) int r[8], g[8], b[8];
+	__m256 half = _mm256_set1_ps(0.5f);
+	__m256 scale = _mm256_set1_ps(255.0f);
+	for(; k + 8 <= s.count; k += 8) {
+		__m256 alpha, beta, gamma;
+		int mask = _mm256_movemask_ps(coverage8(s, k, alpha, beta, gamma));
+		if(!mask) {
+			continue;
+		}
+		counts.covered += laneCount(mask);
+		__m256 nx = interpolate8(alpha, beta, gamma, s.attrA[0], s.attrB[0], s.attrC[0]);
+		__m256 ny = interpolate8(alpha, beta, gamma, s.attrA[1], s.attrB[1], s.attrC[1]);
+		__m256 nz = interpolate8(alpha, beta, gamma, s.attrA[2], s.attrB[2], s.attrC[2]);
+		_mm256_store_si256((__m256i *)r, _mm256_cvttps_epi32(_mm256_mul_ps(scale, saturate8(_mm256_add_ps(_mm256_mul_ps(half, nx), half)))));
+		_mm256_store_si256((__m256i *)g, _mm256_cvttps_epi32(_mm256_mul_ps(scale, saturate8(_mm256_add_ps(_mm256_mul_ps(half, ny), half)))));
+		_mm256_store_si256((__m256i *)b, _mm256_cvttps_epi32(_mm256_mul_ps(scale, saturate8(_mm256_add_ps(_mm256_mul_ps(half, nz), half)))));
+		storeRGB(s.rgb + 3*k, mask, r, g, b);
+	}
+	counts.written = counts.covered;
+	for(; k < s.count; k++) {
+		normalPixel(s, k, counts);
+	}
+	return counts;
+}
+
+TARGET_AVX2 static SpanCounts lambertSpanAVX2(const SpanSetup &s)
+{
+	SpanCounts counts = { 0, 0 };
+	int k = s.start;
+	alignas(32) int c[8];
+	const float l = lightComponent();
+	__m256 lv = _mm256_set1_ps(l);
+	for(; k + 8 <= s.count; k += 8) {
+		__m256 alpha, beta, gamma;
+		int mask = _mm256_movemask_ps(coverage8(s, k, alpha, beta, gamma));
+		if(!mask) {
+			continue;
+		}
+		counts.covered += laneCount(mask);
+		__m256 nx = interpolate8(alpha, beta, gamma, s.attrA[0], s.attrB[0], s.attrC[0]);
+		__m256 ny = interpolate8(alpha, beta, gamma, s.attrA[1], s.attrB[1], s.attrC[1]);
+		__m256 nz = interpolate8(alpha, beta, gamma, s.attrA[2], s.attrB[2], s.attrC[2]);
+		__m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(lv, nx), _mm256_mul_ps(lv, ny)), _mm256_mul_ps(lv, nz));
+		d = saturate8(d);
+		_mm256_store_si256((__m256i *)c, _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_set1_ps(255.0f), d)));
+		storeRGB(s.rgb + 3*k, mask, c, c, c);
+	}
+	counts.written = counts.covered;
+	for(; k < s.count; k++) {
+		lambertPixel(s, k, l, counts);
+	}
+	return counts;
+}
+
+#endif // SPAN_X86
+
+//
+// Dispatch. Degenerate triangles have an infinite or NaN 1/area, and the
+// vector min/max/compare instructions do not treat NaN the way the scalar
+// code does, so those always take the scalar path.
+//
+
+static SimdLevel effectiveLevel(SimdLevel level, const SpanSetup &s)
+{
+	return std::isfinite(s.invArea) ? level : SimdLevel::Scalar;
+}
+
+template<DepthFormat Format>
+static SpanCounts depthSpan(SimdLevel level, const SpanSetup &span, float minZ, float rangeZ, const DepthBuffer &d)
+{
+	switch(level) {
+#ifdef SPAN_X86
+	case SimdLevel::AVX2: return depthSpanAVX2<Format>(span, minZ, rangeZ, d);
+	case SimdLevel::SSE2: return depthSpanSSE2<Format>(span, minZ, rangeZ, d);
+#endif
+	default: {
+		SpanCounts counts = { 0, 0 };
+		for(int k = span.start; k < span.count; k++) {
+			depthPixel<Format>(span, k, minZ, rangeZ, d, counts);
+		}
+		return counts;
+	}
+	}
+}
+
+SpanCounts shadeDepthSpan(SimdLevel level, const SpanSetup &span, float minZ, float maxZ,
+	const DepthBuffer &depth)
+{
+	float rangeZ = maxZ - minZ;
+	level = effectiveLevel(level, span);
+	switch(depth.getFormat()) {
+	case DepthFormat::Unorm24: return depthSpan<DepthFormat::Unorm24>(level, span, minZ, rangeZ, depth);
+	case DepthFormat::Unorm16: return depthSpan<DepthFormat::Unorm16>(level, span, minZ, rangeZ, depth);
+	default: return depthSpan<DepthFormat::Float32>(level, span, minZ, rangeZ, depth);
+	}
+}
+
+SpanCounts shadeNormalSpan(SimdLevel level, const SpanSetup &span)
+{
+	switch(effectiveLevel(level, span)) {
+#ifdef SPAN_X86
+	case SimdLevel::AVX2: return normalSpanAVX2(span);
+	case SimdLevel::SSE2: return normalSpanSSE2(span);
+#endif
+	default: {
+		SpanCounts counts = { 0, 0 };
+		for(int k = span.start; k < span.count; k++) {
+			normalPixel(span, k, counts);
+		}
+		return counts;
+	}
+	}
+}
+
+SpanCounts shadeLambertSpan(SimdLevel level, const SpanSetup &span)
+{
+	const float l = lightComponent();
+	switch(effectiveLevel(level, span)) {
+#ifdef SPAN_X86
+	case SimdLevel::AVX2: return lambertSpanAVX2(span);
+	case SimdLevel::SSE2: return lambertSpanSSE2(span);
+#endif
+	default: {
+		SpanCounts counts = { 0, 0 };
+		for(int k = span.start; k < span.count; k++) {
+			lambertPixel(span, k, l, counts);
+		}
+		return counts;
+	}
+	}
+}
@@ -0,0 +1,90 @@
+#pragma once
+#ifndef _SPANKERNELS_H_
+#define _SPANKERNELS_H_
+
+#include <string>
+
+#include "DepthBuffer.h"
+
+// Pixels whose three edge functions are all at least this value are covered,
+// unless the span already knows its coverage (SpanSetup::covered).
+const float EDGE_EPSILON = -1e-5f;
+
+enum class SimdLevel { Scalar, SSE2, AVX2 };
+
+// Best level supported by the CPU we are running on.
+SimdLevel detectSimdLevel();
+const char *simdLevelName(SimdLevel level);
+// Accepts "scalar", "sse2" and "avx2". Returns false on anything else.
+bool parseSimdLevel(const std::string &name, SimdLevel &level);
+
+/**
+ * One row of one triangle, clipped to a tile.
+ * Pixel k of the span has edge values e0[i] + k*step[i], which is exactly how
+ * every kernel evaluates them; the vector kernels only do it for 4 or 8 values
+ * of k at a time. Together with the fixed operation order below this makes
+ * all SIMD levels produce bit-identical images.
+ * Kernels shade the pixels start <= k < count. Pixel 0 (where e0, rgb and
+ * depth point) stays put when start moves, so skipping the front of a span
+ * does not change how the rest of it is evaluated.
+ * attrA/B/C hold the per-vertex attribute the kernel interpolates: z in
+ * attrX[0] for the depth view, the normal for the normal and Lambert views.
+ * depth points at a float or unorm value, whichever the DepthBuffer holds.
+ * covered is set when coverage was already decided exactly (fixed point
+ * rasterization), in which case every pixel from start to count is inside and
+ * the edge values only serve as barycentrics.
+ */
+struct SpanSetup {
+	int start, count;
+	bool covered;
+	float e0[3];
+	float step[3];
+	float invArea;
+	float attrA[3], attrB[3], attrC[3];
+	unsigned char *rgb; // first pixel of the span in the RGB8 image
+	void *depth;        // first pixel of the span in the depth buffer
+};
+
+// What shading one span did: how many of its pixels were covered, and how
+// many of those were written (the ones that passed the depth test, or all of
+// them without one).
+struct SpanCounts {
+	int covered;
+	int written;
+};
+
+// Edge values and barycentrics of pixel k of the span. Returns whether the
+// pixel is covered.
+inline bool spanCoverage(const SpanSetup &s, int k, float &alpha, float &beta, float &gamma)
+{
+	float fk = static_cast<float>(k);
+	float ABP = s.e0[0] + fk * s.step[0];
+	float BCP = s.e0[1] + fk * s.step[1];
+	float CAP = s.e0[2] + fk * s.step[2];
+	alpha = ABP * s.invArea;
+	beta = BCP * s.invArea;
+	gamma = CAP * s.invArea;
+	return s.covered || (ABP >= EDGE_EPSILON && BCP >= EDGE_EPSILON && CAP >= EDGE_EPSILON);
+}
+
+// Clamps a color to [0, 1], the way the vector kernels do it with max and
+// min, like a unorm render target saturates. Colors leave that range when
+// they are extrapolated to a pixel centre outside the triangle (MSAA).
+inline float saturate(float c)
+{
+	c = c > 0.0f ? c : 0.0f;
+	return c < 1.0f ? c : 1.0f;
+}
+
+// Task 5: depth test against span.depth and write the normalized depth to red.
+// depth is the buffer span.depth points into; its format picks the kernel,
+// and unorm formats compare and store its quantize of the depth. The colour
+// always comes from the unquantized depth.
+SpanCounts shadeDepthSpan(SimdLevel level, const SpanSetup &span, float minZ, float maxZ,
+	const DepthBuffer &depth);
+// Task 6: interpolated normal mapped to RGB.
+SpanCounts shadeNormalSpan(SimdLevel level, const SpanSetup &span);
+// Tasks 7 and 8: Lambert term for the light direction (1, 1, 1)/sqrt(3).
+SpanCounts shadeLambertSpan(SimdLevel level, const SpanSetup &span);
+
+#endif
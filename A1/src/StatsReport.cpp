@@ -0,0 +1,101 @@
+#include "StatsReport.h"
+
+#include <cstdio>
+#include <string>
+
+using namespace std;
+
+// A JSON string literal for s
+static string quoted(const string &s)
+{
+	string q = "\"";
+	for(char c : s) {
+		if(c == '"' || c == '\\') {
+			q += '\\';
+			q += c;
+		} else if((unsigned char)c < 0x20) {
+			char buf[8];
+			snprintf(buf, sizeof(buf), "\\u%04x", (unsigned char)c);
+			q += buf;
+		} else {
+			q += c;
+		}
+	}
+	return q + "\"";
+}
+
+static string number(double v)
+{
+	char buf[32];
+	snprintf(buf, sizeof(buf), "%.3f", v);
+	return buf;
+}
+
+static string stage(const StageTime &t)
+{
+	return "{ \"wallMs\": " + number(t.wallMs) + ", \"cpuMs\": " + number(t.cpuMs) + " }";
+}
+
+static double perSample(long long a, long long b)
+{
+	return b > 0 ? (double)a / b : 0.0;
+}
+
+void writeStatsJson(ostream &out, const StatsReport &r)
+{
+	const RenderJob &job = r.job;
+	const RasterStats &s = r.raster;
+	long long samples = r.options.samples;
+	out << "{\n";
+	out << "  \"mesh\": " << quoted(job.meshName) << ",\n";
+	out << "  \"output\": " << quoted(job.outputName) << ",\n";
+	out << "  \"width\": " << job.width << ",\n";
+	out << "  \"height\": " << job.height << ",\n";
+	out << "  \"task\": " << job.task << ",\n";
+	out << "  \"threads\": " << r.threads << ",\n";
+	out << "  \"simd\": " << quoted(simdLevelName(r.options.simd)) << ",\n";
+	out << "  \"samples\": " << samples << ",\n";
+	out << "  \"tiled\": " << (r.options.tiled ? "true" : "false") << ",\n";
+	out << "  \"fixedPoint\": " << (r.options.fixedPoint ? "true" : "false") << ",\n";
+	out << "  \"hiz\": " << (r.options.hiz ? "true" : "false") << ",\n";
+	out << "  \"geometry\": {\n";
+	out << "    \"corners\": " << r.corners << ",\n";
+	out << "    \"vertices\": " << r.vertices << ",\n";
+	out << "    \"triangles\": " << r.triangles << ",\n";
+	out << "    \"fromCache\": " << (r.load.fromCache ? "true" : "false") << "\n";
+	out << "  },\n";
+	out << "  \"stages\": {\n";
+	out << "    \"parse\": " << stage(r.load.parse) << ",\n";
+	out << "    \"deindex\": " << stage(r.load.deindex) << ",\n";
+	out << "    \"bounds\": " << stage(r.load.bounds) << ",\n";
+	out << "    \"cacheWrite\": " << stage(r.load.cacheWrite) << ",\n";
+	out << "    \"clear\": " << stage(s.clear) << ",\n";
+	out << "    \"transform\": " << stage(s.transform) << ",\n";
+	out << "    \"setup\": " << stage(s.setup) << ",\n";
+	out << "    \"raster\": " << stage(s.raster) << ",\n";
+	out << "    \"resolve\": " << stage(s.resolve) << ",\n";
+	out << "    \"encode\": " << stage(r.encode) << ",\n";
+	out << "    \"total\": " << stage(r.total) << "\n";
+	out << "  },\n";
+	out << "  \"counters\": {\n";
+	out << "    \"trianglesIn\": " << s.trianglesIn << ",\n";
+	out << "    \"trianglesCulled\": " << s.trianglesCulled << ",\n";
+	out << "    \"trianglesFacing\": " << s.trianglesFacing << ",\n";
+	out << "    \"trianglesDegenerate\": " << s.trianglesDegenerate << ",\n";
+	out << "    \"trianglesClipped\": " << s.trianglesClipped << ",\n";
+	out << "    \"trianglesRasterized\": " << s.trianglesBinned << ",\n";
+	out << "    \"tileEntries\": " << s.tileEntries << ",\n";
+	out << "    \"hizTilesCulled\": " << s.hizTilesCulled << ",\n";
+	out << "    \"hizBlocksCulled\": " << s.hizBlocksCulled << ",\n";
+	out << "    \"scissorPixels\": " << s.scissorPixels << ",\n";
+	out << "    \"pixelsTested\": " << s.pixelsTested << ",\n";
+	out << "    \"pixelsCovered\": " << s.pixelsCovered << ",\n";
+	out << "    \"pixelsWritten\": " << s.pixelsWritten << ",\n";
+	out << "    \"depthTests\": " << s.depthTests << ",\n";
+	out << "    \"depthPasses\": " << s.depthPasses << ",\n";
+	out << "    \"depthFails\": " << s.depthFails << ",\n";
+	out << "    \"depthComplexity\": " << number(perSample(s.pixelsCovered, s.scissorPixels * samples)) << ",\n";
+	out << "    \"overdraw\": " << number(perSample(s.pixelsWritten, s.scissorPixels * samples)) << "\n";
+	out << "  }\n";
+	out << "}\n";
+}
@@ -0,0 +1,36 @@
+#pragma once
+#ifndef _STATSREPORT_H_
+#define _STATSREPORT_H_
+
+#include <ostream>
+
+#include "MeshLoader.h"
+#include "Rasterizer.h"
+#include "RenderJob.h"
+#include "Stopwatch.h"
+
+/**
+ * What --stats reports about one render: the job and its settings, where
+ * the time went from loading the mesh to encoding the image, and the
+ * rasterizer's counters.
+ */
+struct StatsReport {
+	RenderJob job;
+	RenderOptions options;
+	int threads;
+	size_t corners;
+	int vertices;
+	int triangles;
+	LoadStats load;
+	RasterStats raster;
+	StageTime encode;
+	StageTime total;
+};
+
+// Writes the report as one JSON object. Besides the raw counters it gives
+// depthComplexity, the covered samples per sample of the scissor rectangle
+// (how many triangles cover a pixel on average), and overdraw, the written
+// samples per sample of the scissor rectangle.
+void writeStatsJson(std::ostream &out, const StatsReport &report);
+
+#endif
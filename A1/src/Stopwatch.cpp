@@ -0,0 +1,29 @@
+#include "Stopwatch.h"
+
+using namespace std;
+
+Stopwatch::Stopwatch()
+{
+	restart();
+}
+
+void Stopwatch::restart()
+{
+	wallStart = chrono::steady_clock::now();
+	cpuStart = clock();
+}
+
+StageTime Stopwatch::elapsed() const
+{
+	StageTime t;
+	t.wallMs = chrono::duration<double, milli>(chrono::steady_clock::now() - wallStart).count();
+	t.cpuMs = 1000.0 * (double)(clock() - cpuStart) / CLOCKS_PER_SEC;
+	return t;
+}
+
+StageTime Stopwatch::lap()
+{
+	StageTime t = elapsed();
+	restart();
+	return t;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#ifndef _STOPWATCH_H_
+#define _STOPWATCH_H_
+
+#include <chrono>
+#include <ctime>
+
+/**
+ * Time spent in one stage of a run, in milliseconds. cpuMs is the processor
+ * time of the whole process over the same interval, so a stage that keeps n
+ * threads busy shows about n times its wall time there.
+ */
+struct StageTime {
+	double wallMs;
+	double cpuMs;
+
+	StageTime &operator+=(const StageTime &other)
+	{
+		wallMs += other.wallMs;
+		cpuMs += other.cpuMs;
+		return *this;
+	}
+};
+
+/**
+ * Measures StageTimes. Starts running when it is made.
+ */
+class Stopwatch
+{
+public:
+	Stopwatch();
+	void restart();
+	// Time since the last restart
+	StageTime elapsed() const;
+	// elapsed() and restart() in one, for timing stages back to back
+	StageTime lap();
+
+private:
+	std::chrono::steady_clock::time_point wallStart;
+	std::clock_t cpuStart;
+};
+
+#endif
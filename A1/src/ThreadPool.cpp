@@ -0,0 +1,94 @@
+#include "ThreadPool.h"
+
+using namespace std;
+
+ThreadPool::ThreadPool(int n) :
+	nThreads(n > 0 ? n : defaultThreadCount()),
+	job(nullptr),
+	jobCount(0),
+	next(0),
+	active(0),
+	generation(0),
+	stopping(false)
+{
+	for(int i = 1; i < nThreads; i++) {
+		threads.emplace_back(&ThreadPool::workerLoop, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		lock_guard<mutex> lock(mtx);
+		stopping = true;
+	}
+	wake.notify_all();
+	for(auto &t : threads) {
+		t.join();
+	}
+}
+
+int ThreadPool::defaultThreadCount()
+{
+	unsigned n = thread::hardware_concurrency();
+	return n > 0 ? (int)n : 1;
+}
+
+void ThreadPool::parallelFor(int count, const function<void(int, int)> &fn)
+{
+	if(count <= 0) {
+		return;
+	}
+	// Nothing to hand out, so skip the wake-up round trip.
+	if(threads.empty() || count == 1) {
+		for(int i = 0; i < count; i++) {
+			fn(i, 0);
+		}
+		return;
+	}
+
+	lock_guard<mutex> runLock(runMutex);
+	{
+		lock_guard<mutex> lock(mtx);
+		job = &fn;
+		jobCount = count;
+		next = 0;
+		active = (int)threads.size();
+		generation++;
+	}
+	wake.notify_all();
+	drain(0);
+
+	unique_lock<mutex> lock(mtx);
+	done.wait(lock, [this] { return active == 0; });
+	job = nullptr;
+}
+
+void ThreadPool::drain(int worker)
+{
+	for(int i = next++; i < jobCount; i = next++) {
+		(*job)(i, worker);
+	}
+}
+
+void ThreadPool::workerLoop(int worker)
+{
+	unsigned long seen = 0;
+	for(;;) {
+		{
+			unique_lock<mutex> lock(mtx);
+			wake.wait(lock, [&] { return stopping || generation != seen; });
+			if(stopping) {
+				return;
+			}
+			seen = generation;
+		}
+		drain(worker);
+		{
+			lock_guard<mutex> lock(mtx);
+			if(--active == 0) {
+				done.notify_one();
+			}
+		}
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+#ifndef _THREADPOOL_H_
+#define _THREADPOOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A fixed set of worker threads that run data-parallel loops.
+ * The calling thread takes part in every loop as worker 0, so a pool of size
+ * 1 owns no threads at all and simply runs the loop inline.
+ */
+class ThreadPool
+{
+public:
+	// nThreads <= 0 means one worker per hardware thread.
+	ThreadPool(int nThreads = 0);
+	virtual ~ThreadPool();
+	int size() const { return nThreads; }
+	// Calls fn(index, worker) for every index in [0, count) and returns once
+	// all of them are done. worker is in [0, size()) and is unique among the
+	// calls running at the same time, so it can be used to pick scratch space.
+	void parallelFor(int count, const std::function<void(int, int)> &fn);
+
+	static int defaultThreadCount();
+
+private:
+	void workerLoop(int worker);
+	void drain(int worker);
+
+	int nThreads;
+	std::vector<std::thread> threads;
+	std::mutex runMutex; // serializes concurrent parallelFor() callers
+	std::mutex mtx;
+	std::condition_variable wake;
+	std::condition_variable done;
+	const std::function<void(int, int)> *job;
+	int jobCount;
+	std::atomic<int> next;
+	int active;
+	unsigned long generation;
+	bool stopping;
+};
+
+#endif
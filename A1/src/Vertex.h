@@ -0,0 +1,13 @@
+#pragma once
+#ifndef _VERTEX_H_
+#define _VERTEX_H_
+
+/**
+ * One triangle corner as the loaders produce it: a position and a normal.
+ */
+struct Vertex {
+	float x, y, z;
+	float nx, ny, nz;
+};
+
+#endif
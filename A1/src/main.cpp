@@ -1,12 +1,22 @@
 #include <iostream>
+#include <fstream>
 #include <string>
 #include <algorithm>
+#include <cfloat>
 
-#define TINYOBJLOADER_IMPLEMENTATION
-#include "tiny_obj_loader.h"
 #include "stb_image_write.h"
 
+#include "Batch.h"
 #include "Image.h"
+#include "ImageWriter.h"
+#include "Mesh.h"
+#include "MeshLoader.h"
+#include "PngWriter.h"
+#include "Rasterizer.h"
+#include "RenderJob.h"
+#include "Sequence.h"
+#include "StatsReport.h"
+#include "Stopwatch.h"
 
 // This allows you to skip the `std::` in front of C++ standard library
 // functions. You can also say `using std::cout` to be more selective.
@@ -14,514 +24,220 @@
 using namespace std;
 
 
-struct Point {
-	float x, y;
-};
-
-struct Vertex {
-	float x, y, z;
-	float nx, ny, nz;
-};
-
-
-
-struct Tri {
-	Vertex a, b, c;
-};
-
-double RANDOM_COLORS[7][3] = {
-	{0.0000,    0.4470,    0.7410},
-	{0.8500,    0.3250,    0.0980},
-	{0.9290,    0.6940,    0.1250},
-	{0.4940,    0.1840,    0.5560},
-	{0.4660,    0.6740,    0.1880},
-	{0.3010,    0.7450,    0.9330},
-	{0.6350,    0.0780,    0.1840},
-};
-
-
-float globalMinY = FLT_MAX;
-float globalMaxY = -FLT_MAX;
-
-float globalMinZ = numeric_limits<float>::max();
-float globalMaxZ = numeric_limits<float>::lowest();
-
-
-//function to compute the bounding box for 3 vertices as a triangle
-void computeTriangleBoundingBox(const vector<float>& posBuf, size_t startIdx, float& minX, float& minY, float& maxX, float& maxY) {
-	minX = posBuf[startIdx];
-	minY = posBuf[startIdx + 1];
-	maxX = posBuf[startIdx];
-	maxY = posBuf[startIdx + 1];
-
-	for (int i = 0; i < 3; ++i) {
-		float x = posBuf[startIdx + i * 3];
-		float y = posBuf[startIdx + i * 3 + 1];
-		if (x < minX) minX = x;
-		if (y < minY) minY = y;
-		if (x > maxX) maxX = x;
-		if (y > maxY) maxY = y;
-	}
-}
-
-//function to compute bounding box for whole object
-void computeBoundingBox(const vector<float>& posBuf, float& minX, float& minY, float& maxX, float& maxY)
-{
-	minX = posBuf[0];
-	minY = posBuf[1];
-	maxX = posBuf[0];
-	maxY = posBuf[1];
-	for (size_t i = 0; i < posBuf.size(); i += 3) 
-	{
-		float x = posBuf[i];
-		float y = posBuf[i + 1];
-		if (x < minX) minX = x;
-		if (y < minY) minY = y;
-		if (x > maxX) maxX = x;
-		if (y > maxY) maxY = y;
-	}
-}
-
-float dot(float x1, float y1, float z1, float x2, float y2, float z2) {
-	return (x1 * x2) + (y1 * y2) + (z1 * z2);
-}
-
-//float normalize(Vertex& v) {
-//	float magnitude = sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
-//	v.x /= magnitude;
-//	v.y /= magnitude;
-//	v.z /= magnitude;
-//	return magnitude;
-//}
-
-
-Point projectToImage(float x, float y, float scale, const Point& translation) 
-{
-	return { scale * x + translation.x, scale * y + translation.y };
-}
-
-float edgeFunction(const Vertex& a, const Vertex& b, const Vertex& c) {
-	return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
-}
-
-void rotate(float& x, float& y, float& z, float theta) {
-	float cosTheta = cos(theta);
-	float sinTheta = sin(theta);
-
-	float xNew = cosTheta * x + sinTheta * z;
-	float zNew = -sinTheta * x + cosTheta * z;
-
-	x = xNew;
-	z = zNew;
-}
-
-
 int main(int argc, char **argv)
 {
-
-	if(argc < 5) {
+	Stopwatch runTimer;
+
+	// Batch mode takes a manifest in place of the positional arguments and
+	// sequence mode a frame count in place of the task
+	string mode = argc >= 2 ? argv[1] : "";
+	bool batch = mode == "--batch";
+	bool sequence = mode == "--sequence";
+	int firstOption = batch ? 3 : (sequence ? 7 : 6);
+	if(argc < firstOption) {
 		cerr << "Inusfficient amount of arguments" << endl;
+		cerr << "Usage: A1 <mesh.obj> <output.png|-> <width> <height> <task> [options]" << endl;
+		cerr << "       A1 --batch <manifest> [--scheduler throughput|latency] [options]" << endl;
+		cerr << "       A1 --sequence <mesh.obj> <frame_%04d.png|video.rgb|-> <width> <height> <frames> [--task N] [--angles start end] [options]" << endl;
+		cerr << "Options: [--threads N] [--simd scalar|sse2|avx2] [--crop x y w h] [--no-hiz] [--fixed-point] [--tiled] [--msaa 1|2|4|8] [--depth float|unorm24|unorm16] [--cull none|back|front] [--no-cache] [--encoders N] [--png stb|stored|fast|default] [--format png|ppm|pam|qoi|raw|float|rgb] [--stats file.json|-]" << endl;
 		return 1;
 	}
 
-	string meshName = argv[1];
-	string outputName = argv[2];
-	int imageWidth = atoi(argv[3]);
-	int imageHeight = atoi(argv[4]);
-	int task = atoi(argv[5]);
-
-
-	// Load geometry
-	vector<float> posBuf; // list of vertex positions
-	vector<float> norBuf; // list of vertex normals
-	vector<float> texBuf; // list of vertex texture coords
-	vector<Point> frameBuf; //buffer for each pixel colour
-	vector<Vertex> ZBuf; //buffer for each pixel z value
-	vector<Vertex> Vertices;
-	vector<Tri> Triangles;
-	float theta = 3.14 / 4.0f;
-	tinyobj::attrib_t attrib;
-	std::vector<tinyobj::shape_t> shapes;
-	std::vector<tinyobj::material_t> materials;
-	string warnStr, errStr;
-	bool rc = tinyobj::LoadObj(&attrib, &shapes, &materials, &warnStr, &errStr, meshName.c_str());
-	if(!rc) {
-		cerr << errStr << endl;
+	string meshName, outputName, manifestName;
+	int imageWidth = 0, imageHeight = 0, task = 0, frames = 0;
+	float startAngle = 0.0f, endAngle = 6.2831853f;
+	if (batch) {
+		manifestName = argv[2];
+	} else if (sequence) {
+		meshName = argv[2];
+		outputName = argv[3];
+		imageWidth = atoi(argv[4]);
+		imageHeight = atoi(argv[5]);
+		frames = atoi(argv[6]);
+		task = 7;
 	} else {
-		// Some OBJ files have different indices for vertex positions, normals,
-		// and texture coordinates. For example, a cube corner vertex may have
-		// three different normals. Here, we are going to duplicate all such
-		// vertices.
-		// Loop over shapes
-		for(size_t s = 0; s < shapes.size(); s++) {
-			// Loop over faces (polygons)
-			size_t index_offset = 0;
-			for(size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++) {
-				size_t fv = shapes[s].mesh.num_face_vertices[f];
-				// Loop over vertices in the face.
-				for(size_t v = 0; v < fv; v++) {
-					// access to vertex
-					tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
-					posBuf.push_back(attrib.vertices[3*idx.vertex_index+0]);
-					posBuf.push_back(attrib.vertices[3*idx.vertex_index+1]);
-					posBuf.push_back(attrib.vertices[3*idx.vertex_index+2]);
-					if(!attrib.normals.empty()) {
-						norBuf.push_back(attrib.normals[3*idx.normal_index+0]);
-						norBuf.push_back(attrib.normals[3*idx.normal_index+1]);
-						norBuf.push_back(attrib.normals[3*idx.normal_index+2]);
-					}
-					if(!attrib.texcoords.empty()) {
-						texBuf.push_back(attrib.texcoords[2*idx.texcoord_index+0]);
-						texBuf.push_back(attrib.texcoords[2*idx.texcoord_index+1]);
-					}
-				}
-				index_offset += fv;
-				// per-face material (IGNORE)
-				shapes[s].mesh.material_ids[f];
+		meshName = argv[1];
+		outputName = argv[2];
+		imageWidth = atoi(argv[3]);
+		imageHeight = atoi(argv[4]);
+		task = atoi(argv[5]);
+	}
+	BatchScheduler scheduler = BatchScheduler::Throughput;
+	int nThreads = 0; // one per hardware thread
+	int nEncoders = 0; // PNG encoder threads for batches and sequences
+	PngLevel pngLevel = PngLevel::Stb;
+	ImageFormat format = ImageFormat::Png;
+	bool formatGiven = false; // otherwise it follows the output name
+	SimdLevel simd = detectSimdLevel();
+	bool crop = false;
+	bool hiz = true;
+	bool fixedPoint = false;
+	bool tiled = false;
+	int samples = 1;
+	DepthFormat depthFormat = DepthFormat::Float32;
+	bool useCache = true;
+	string statsName; // where --stats writes its JSON, "-" for stdout
+	CullMode cull = CullMode::Back;
+	int cropX = 0, cropY = 0, cropW = 0, cropH = 0;
+
+	// Optional flags after the positional arguments
+	for (int i = firstOption; i < argc; i++) {
+		string arg = argv[i];
+		if (arg == "--threads" && i + 1 < argc) {
+			nThreads = atoi(argv[++i]);
+		} else if (arg == "--simd" && i + 1 < argc) {
+			if (!parseSimdLevel(argv[++i], simd)) {
+				cerr << "Unknown SIMD level " << argv[i] << " (use scalar, sse2 or avx2)" << endl;
+				return 1;
+			}
+		} else if (arg == "--cull" && i + 1 < argc) {
+			if (!parseCullMode(argv[++i], cull)) {
+				cerr << "Unknown cull mode " << argv[i] << " (use none, back or front)" << endl;
+				return 1;
 			}
+		} else if (arg == "--msaa" && i + 1 < argc) {
+			samples = atoi(argv[++i]);
+			if (samples != 1 && samples != 2 && samples != 4 && samples != 8) {
+				cerr << "Unsupported sample count " << argv[i] << " (use 1, 2, 4 or 8)" << endl;
+				return 1;
+			}
+		} else if (arg == "--depth" && i + 1 < argc) {
+			if (!parseDepthFormat(argv[++i], depthFormat)) {
+				cerr << "Unknown depth format " << argv[i] << " (use float, unorm24 or unorm16)" << endl;
+				return 1;
+			}
+		} else if (arg == "--scheduler" && batch && i + 1 < argc) {
+			if (!parseBatchScheduler(argv[++i], scheduler)) {
+				cerr << "Unknown scheduler " << argv[i] << " (use throughput or latency)" << endl;
+				return 1;
+			}
+		} else if (arg == "--task" && sequence && i + 1 < argc) {
+			task = atoi(argv[++i]);
+		} else if (arg == "--angles" && sequence && i + 2 < argc) {
+			startAngle = (float)atof(argv[++i]);
+			endAngle = (float)atof(argv[++i]);
+		} else if (arg == "--encoders" && i + 1 < argc) {
+			nEncoders = atoi(argv[++i]);
+		} else if (arg == "--png" && i + 1 < argc) {
+			if (!parsePngLevel(argv[++i], pngLevel)) {
+				cerr << "Unknown PNG level " << argv[i] << " (use stb, stored, fast or default)" << endl;
+				return 1;
+			}
+		} else if (arg == "--format" && i + 1 < argc) {
+			if (!parseImageFormat(argv[++i], format)) {
+				cerr << "Unknown image format " << argv[i] << " (use png, ppm, pam, qoi, raw, float or rgb)" << endl;
+				return 1;
+			}
+			formatGiven = true;
+		} else if (arg == "--stats" && i + 1 < argc) {
+			if (batch || sequence) {
+				cerr << "--stats only reports on single renders" << endl;
+				return 1;
+			}
+			statsName = argv[++i];
+		} else if (arg == "--no-hiz") {
+			hiz = false;
+		} else if (arg == "--fixed-point") {
+			fixedPoint = true;
+		} else if (arg == "--tiled") {
+			tiled = true;
+		} else if (arg == "--no-cache") {
+			useCache = false;
+		} else if (arg == "--crop" && i + 4 < argc) {
+			crop = true;
+			cropX = atoi(argv[++i]);
+			cropY = atoi(argv[++i]);
+			cropW = atoi(argv[++i]);
+			cropH = atoi(argv[++i]);
+		} else {
+			cerr << "Unknown option " << arg << endl;
+			return 1;
 		}
 	}
-	cout << "Number of vertices: " << posBuf.size()/3 << endl;
 
-	vector<float> zBuffer(imageWidth * imageHeight, numeric_limits<float>::max());
 
-	//populate Vertices vector
-	for (size_t i = 0; i < posBuf.size(); i += 3) 
-	{
-		Vertex temp;
-		temp.x = posBuf[i];
-		temp.y = posBuf[i + 1];
-		temp.z = posBuf[i + 2];
-		temp.nx = norBuf[i];
-		temp.ny = norBuf[i + 1];
-		temp.nz = norBuf[i + 2];
-		Vertices.push_back(temp);
+	RenderOptions options;
+	options.simd = simd;
+	options.hiz = hiz;
+	options.fixedPoint = fixedPoint;
+	options.tiled = tiled;
+	options.samples = samples;
+	options.depthFormat = depthFormat;
+	options.cull = cull;
+	options.crop = crop;
+	options.cropX = cropX;
+	options.cropY = cropY;
+	options.cropW = cropW;
+	options.cropH = cropH;
+
+	if (batch) {
+		vector<RenderJob> jobs;
+		string errStr;
+		if (!readManifest(manifestName, jobs, errStr)) {
+			cerr << errStr << endl;
+			return 1;
+		}
+		if (formatGiven) {
+			for (RenderJob &job : jobs) {
+				job.format = format;
+			}
+		}
+		return runBatch(jobs, options, scheduler, nThreads, nEncoders, pngLevel, useCache) == 0 ? 0 : 1;
 	}
 
 
-	//populate triangles vector
-	for (size_t i = 0; i < posBuf.size(); i += 9)
-	{
-		Vertex temp1;
-		Vertex temp2;
-		Vertex temp3;
-		Tri angle;
-
-		temp1.x = posBuf[i];
-		temp1.y = posBuf[i + 1];
-		temp1.z = posBuf[i + 2];
-		temp2.x = posBuf[i + 3];
-		temp2.y = posBuf[i + 4];
-		temp2.z = posBuf[i + 5];
-		temp3.x = posBuf[i + 6];
-		temp3.y = posBuf[i + 7];
-		temp3.z = posBuf[i + 8];
-
-		temp1.nx = norBuf[i];
-		temp1.ny = norBuf[i + 1];
-		temp1.nz = norBuf[i + 2];
-		temp2.nx = norBuf[i + 3];
-		temp2.ny = norBuf[i + 4];
-		temp2.nz = norBuf[i + 5];
-		temp3.nx = norBuf[i + 6];
-		temp3.ny = norBuf[i + 7];
-		temp3.nz = norBuf[i + 8];
-
-		angle = { temp1, temp2, temp3 };
-
-		Triangles.push_back(angle);
+	if (!statsName.empty() && statsName == outputName) {
+		cerr << "--stats cannot write to the same place as the image" << endl;
+		return 1;
 	}
 
-	
-	float minX, minY, maxX, maxY;
-	computeBoundingBox(posBuf, minX, minY, maxX, maxY);
-
-	float bboxWidth = maxX - minX;
-	float bboxHeight = maxY - minY;
-	float scale = min(static_cast<float>(imageWidth) / bboxWidth, static_cast<float>(imageHeight) / bboxHeight);
-	Point translation = {
-		static_cast<float>(imageWidth) / 2.0f - scale * (minX + maxX) / 2.0f,
-		static_cast<float>(imageHeight) / 2.0f - scale * (minY + maxY) / 2.0f
-	};
-
-	vector<unsigned char> image(imageWidth * imageHeight * 3, 0);
-
-
-	//loop get object bounding box after translation
-	for (size_t i = 0; i < Triangles.size(); i++) {
-		Point a = projectToImage(Triangles[i].a.x, Triangles[i].a.y, scale, translation);
-		Point b = projectToImage(Triangles[i].b.x, Triangles[i].b.y, scale, translation);
-		Point c = projectToImage(Triangles[i].c.x, Triangles[i].c.y, scale, translation);
-
-		globalMinY = min(min(min(globalMinY, a.y), b.y), c.y);
-		globalMaxY = max(max(max(globalMaxY, a.y), b.y), c.y);
+	// Load geometry
+	Mesh mesh; // the only copy of the geometry
+	string warnStr, errStr;
+	LoadStats loadStats;
+	if(!loadObjMesh(meshName, mesh, warnStr, errStr, nThreads, useCache, &loadStats)) {
+		// An empty image (and report) would pass for a real one
+		cerr << errStr << endl;
+		return 1;
 	}
-
-	//loop get global min and max Z values
-	for (const auto& triangle : Triangles) {
-		globalMinZ = min(min(min(globalMinZ, triangle.a.z), triangle.b.z), triangle.c.z);
-		globalMaxZ = max(max(max(globalMaxZ, triangle.a.z), triangle.b.z), triangle.c.z);
+	if(!warnStr.empty()) {
+		cerr << warnStr;
 	}
-
-	for (size_t i = 0; i < Triangles.size(); i++) {
-		int colorIndex = i % 7;
-		const auto& color = RANDOM_COLORS[colorIndex];
-
-		if (task == 8)
-		{
-			rotate(Triangles[i].a.x, Triangles[i].a.y, Triangles[i].a.z, theta);
-			rotate(Triangles[i].a.nx, Triangles[i].a.ny, Triangles[i].a.nz, theta);
-
-			rotate(Triangles[i].b.x, Triangles[i].b.y, Triangles[i].b.z, theta);
-			rotate(Triangles[i].b.nx, Triangles[i].b.ny, Triangles[i].b.nz, theta);
-
-			rotate(Triangles[i].c.x, Triangles[i].c.y, Triangles[i].c.z, theta);
-			rotate(Triangles[i].c.nx, Triangles[i].c.ny, Triangles[i].c.nz, theta);
-		}
-
-		Point a = projectToImage(Triangles[i].a.x, Triangles[i].a.y, scale, translation);
-		Point b = projectToImage(Triangles[i].b.x, Triangles[i].b.y, scale, translation);
-		Point c = projectToImage(Triangles[i].c.x, Triangles[i].c.y, scale, translation);
-
-
-		float zA = Triangles[i].a.z;
-		float zB = Triangles[i].b.z;
-		float zC = Triangles[i].c.z;
-
-		float nxA = Triangles[i].a.nx;
-		float nyA = Triangles[i].a.ny;
-		float nzA = Triangles[i].a.nz;
-
-		float nxB = Triangles[i].b.nx;
-		float nyB = Triangles[i].b.ny;
-		float nzB = Triangles[i].b.nz;
-
-		float nxC = Triangles[i].c.nx;
-		float nyC = Triangles[i].c.ny;
-		float nzC = Triangles[i].c.nz;
-
-
-		// Compute bounding box for the current triangle
-		float triMinX, triMinY, triMaxX, triMaxY;
-		//computeTriangleBoundingBox(posBuf, i, triMinX, triMinY, triMaxX, triMaxY);
-		triMinX = floor(min(min(a.x, b.x), c.x));
-		triMinY = floor(min(min(a.y, b.y), c.y));
-		triMaxX = ceil(max(max(a.x, b.x), c.x));
-		triMaxY = ceil(max(max(a.y, b.y), c.y));
-		/*if (triMinY < 0)
-		{
-			triMinY = 0;
-		}
-		if (triMinX < 0)
-		{
-			triMinX = 0;
-		}
-		if (triMaxY > (triMaxY-triMinY) - 1)
-		{
-			triMaxY = (triMaxY - triMinY) - 1;
-		}
-		if (triMaxX > (triMaxX - triMinX) - 1)
-		{
-			triMaxX = (triMaxX - triMinX) - 1;
-		}*/
-
-
-		for (int y = static_cast<int>(triMinY); y < static_cast<int>(triMaxY); y++)
-		{
-			for (int x = static_cast<int>(triMinX); x < static_cast<int>(triMaxX); x++)
-			{
-				Vertex pixel = { static_cast<float>(x), static_cast<float>(y), 0.0f };
-				float ABP = edgeFunction(Vertex{ a.x, a.y, 0.0f }, Vertex{ b.x, b.y, 0.0f }, pixel);
-				float BCP = edgeFunction(Vertex{ b.x, b.y, 0.0f }, Vertex{ c.x, c.y, 0.0f }, pixel);
-				float CAP = edgeFunction(Vertex{ c.x, c.y, 0.0f }, Vertex{ a.x, a.y, 0.0f }, pixel);
-
-				int flippedY = imageHeight - 1 - y;
-				if (x >= 0 && x < imageWidth && flippedY >= 0 && flippedY < imageHeight && task == 1)
-				{
-					int pixelIndex = (flippedY * imageWidth + x) * 3;
-					image[pixelIndex] = static_cast<unsigned char>(color[0] * 255);
-					image[pixelIndex + 1] = static_cast<unsigned char>(color[1] * 255);
-					image[pixelIndex + 2] = static_cast<unsigned char>(color[2] * 255);
-				}
-
-
-				if (ABP >= -1e-5 && BCP >= -1e-5 && CAP >= -1e-5 && task == 2)
-				{
-					int pixelIndex = (flippedY * imageWidth + x) * 3;
-					image[pixelIndex] = static_cast<unsigned char>(color[0] * 255);
-					image[pixelIndex + 1] = static_cast<unsigned char>(color[1] * 255);
-					image[pixelIndex + 2] = static_cast<unsigned char>(color[2] * 255);
-				}
-
-				if (ABP >= -1e-5 && BCP >= -1e-5 && CAP >= -1e-5 && task == 3) {
-
-					/*int vertexCount = 0;
-					int indx1 = vertexCount+2;
-					int indx2 = vertexCount;
-					int indx3 = vertexCount+1;
-					vertexCount += 3;*/
-
-					int vertexCount = (i * 9)/3;
-
-					int indx1 = vertexCount + 2;
-					int indx2 = vertexCount;
-					int indx3 = vertexCount + 1;
-
-					if (i == 1)
-					{
-						indx1 = 2;
-						indx2 = 0;
-						indx3 = 1;
-					}
-					
-					float rA = RANDOM_COLORS[indx1%7][0];
-					float gA = RANDOM_COLORS[indx1%7][1]; 
-					float bA = RANDOM_COLORS[indx1%7][2];
-
-					float rB = RANDOM_COLORS[indx2%7][0]; 
-					float gB = RANDOM_COLORS[indx2%7][1]; 
-					float bB = RANDOM_COLORS[indx2%7][2]; 
-
-					float rC = RANDOM_COLORS[indx3%7][0]; 
-					float gC = RANDOM_COLORS[indx3%7][1];
-					float bC = RANDOM_COLORS[indx3%7][2];
-
-					//for this barycentric calculation and anywhere else appearing, I asked chatGPT to give me the equation
-					float alpha = ABP / (ABP + BCP + CAP);
-					float beta = BCP / (ABP + BCP + CAP);
-					float gamma = CAP / (ABP + BCP + CAP);
-
-					float r = alpha * rA + beta * rB + gamma * rC;
-					float g = alpha * gA + beta * gB + gamma * gC;
-					float b = alpha * bA + beta * bB + gamma * bC;
-
-					int pixelIndex = (flippedY * imageWidth + x) * 3;
-					image[pixelIndex] = static_cast<unsigned char>(r * 255);
-					image[pixelIndex + 1] = static_cast<unsigned char>(g * 255);
-					image[pixelIndex + 2] = static_cast<unsigned char>(b * 255);
-				}
-
-				if (ABP >= -1e-5 && BCP >= -1e-5 && CAP >= -1e-5 && task == 4)
-				{
-					float normalizedY = (flippedY - globalMinY) / (globalMaxY - globalMinY);
-					normalizedY = max(0.0f, min(1.0f, normalizedY));
-
-
-					float red = 255 * (1 - normalizedY);  
-					float blue = 255 * normalizedY;  
-					float green = 0.0f;
-
-
-
-					int pixelIndex = (flippedY * imageWidth + x) * 3;
-					image[pixelIndex] = static_cast<unsigned char>(red);
-					image[pixelIndex + 1] = static_cast<unsigned char>(green);
-					image[pixelIndex + 2] = static_cast<unsigned char>(blue);
-				}
-
-				if (ABP >= -1e-5 && BCP >= -1e-5 && CAP >= -1e-5 && task == 5)
-				{
-					float alpha = ABP / (ABP + BCP + CAP);
-					float beta = BCP / (ABP + BCP + CAP);
-					float gamma = CAP / (ABP + BCP + CAP);
-
-					float z = alpha * zA + beta * zB + gamma * zC;
-
-					int pixelIndex = (flippedY * imageWidth + x);
-					if (z < zBuffer[pixelIndex]) {
-						zBuffer[pixelIndex] = z;
-
-						float normalizedZ = (z - globalMinZ) / (globalMaxZ - globalMinZ);
-						normalizedZ = clamp(normalizedZ, 0.0f, 1.0f);
-						unsigned char red = static_cast<unsigned char>(normalizedZ * 255);
-
-						int colorIndex = pixelIndex * 3;
-						image[colorIndex] = red;
-						image[colorIndex + 1] = 0;
-						image[colorIndex + 2] = 0;
-					}
-				}
-
-				if (ABP >= -1e-5 && BCP >= -1e-5 && CAP >= -1e-5 && task == 6)
-				{
-					float alpha = ABP / (ABP + BCP + CAP);
-					float beta = BCP / (ABP + BCP + CAP);
-					float gamma = CAP / (ABP + BCP + CAP);
-
-					// Interpolate normals
-					float nx = alpha * nxA + beta * nxB + gamma * nxC;
-					float ny = alpha * nyA + beta * nyB + gamma * nyC;
-					float nz = alpha * nzA + beta * nzB + gamma * nzC;
-
-
-					// Map interpolated normal to RGB values
-					unsigned char r = static_cast<unsigned char>(255 * (0.5f * nx + 0.5f));
-					unsigned char g = static_cast<unsigned char>(255 * (0.5f * ny + 0.5f));
-					unsigned char b = static_cast<unsigned char>(255 * (0.5f * nz + 0.5f));
-
-					int pixelIndex = (flippedY * imageWidth + x) * 3;
-					image[pixelIndex] = r;
-					image[pixelIndex + 1] = g;
-					image[pixelIndex + 2] = b;
-				}
-
-				if (ABP >= -1e-5 && BCP >= -1e-5 && CAP >= -1e-5 && task == 7) 
-				{
-					float alpha = ABP / (ABP + BCP + CAP);
-					float beta = BCP / (ABP + BCP + CAP);
-					float gamma = CAP / (ABP + BCP + CAP);
-
-					float nx = alpha * nxA + beta * nxB + gamma * nxC;
-					float ny = alpha * nyA + beta * nyB + gamma * nyC;
-					float nz = alpha * nzA + beta * nzB + gamma * nzC;
-
-					Vertex n = { nx, ny, nz };
-					Vertex l = { 1.0f / sqrt(3.0f), 1.0f / sqrt(3.0f), 1.0f / sqrt(3.0f) };
-					float dotProduct = dot(l.x, l.y, l.z, n.x, n.y, n.z);
-					float c = max(dotProduct, 0.0f);
-					unsigned char rgb = static_cast<unsigned char>(255 * c);
-
-					int pixelIndex = (flippedY * imageWidth + x) * 3;
-					image[pixelIndex] = rgb;
-					image[pixelIndex + 1] = rgb;
-					image[pixelIndex + 2] = rgb;
-				}
-
-				if (ABP >= -1e-5 && BCP >= -1e-5 && CAP >= -1e-5 && task == 8)
-				{
-					float alpha = ABP / (ABP + BCP + CAP);
-					float beta = BCP / (ABP + BCP + CAP);
-					float gamma = CAP / (ABP + BCP + CAP);
-
-					float nx = alpha * nxA + beta * nxB + gamma * nxC;
-					float ny = alpha * nyA + beta * nyB + gamma * nyC;
-					float nz = alpha * nzA + beta * nzB + gamma * nzC;
-
-					Vertex n = { nx, ny, nz };
-					Vertex l = { 1.0f / sqrt(3.0f), 1.0f / sqrt(3.0f), 1.0f / sqrt(3.0f) };
-					float dotProduct = dot(l.x, l.y, l.z, n.x, n.y, n.z);
-					float c = max(dotProduct, 0.0f);
-					unsigned char rgb = static_cast<unsigned char>(255 * c);
-
-					int pixelIndex = (flippedY * imageWidth + x) * 3;
-					image[pixelIndex] = rgb;
-					image[pixelIndex + 1] = rgb;
-					image[pixelIndex + 2] = rgb;
-				}
-			}
+	if (!formatGiven) {
+		// A stream on stdout is raw video unless asked otherwise
+		format = sequence && outputName == "-" ? ImageFormat::Rgb : formatFromFilename(outputName);
+	}
+	SequenceSpec spec = { outputName, format, imageWidth, imageHeight, task, frames, startAngle, endAngle };
+	// An image, video or report on stdout leaves only stderr for messages
+	ostream &log = outputName == "-" || statsName == "-" ? cerr : cout;
+	log << "Number of vertices: " << mesh.getIndexCount() << " (" << mesh.getVertexCount() << " unique)" << endl;
+
+	if (sequence) {
+		if (frames <= 0 || imageWidth <= 0 || imageHeight <= 0) {
+			cerr << "Need a positive size and frame count" << endl;
+			return 1;
 		}
+		return renderSequence(mesh, spec, options, nThreads, nEncoders, pngLevel, log) ? 0 : 1;
+	}
 
-		/*for (int y = static_cast<int>(projectedMin.y); y <= static_cast<int>(projectedMax.y); ++y) {
-			for (int x = static_cast<int>(projectedMin.x); x <= static_cast<int>(projectedMax.x); ++x) {
-				int flippedY = imageHeight - 1 - y; 
-				if (x >= 0 && x < imageWidth && flippedY >= 0 && flippedY < imageHeight) {
-					int pixelIndex = (flippedY * imageWidth + x) * 3;
-					image[pixelIndex] = static_cast<unsigned char>(color[0] * 255);
-					image[pixelIndex + 1] = static_cast<unsigned char>(color[1] * 255);
-					image[pixelIndex + 2] = static_cast<unsigned char>(color[2] * 255);
-				}
-			}
-		}*/
+	RenderJob job;
+	job.meshName = meshName;
+	job.outputName = outputName;
+	job.format = format;
+	job.width = imageWidth;
+	job.height = imageHeight;
+	job.task = task;
+	job.rotation = defaultRotation(task);
+
+	FrameBuffers buffers;
+	RasterStats stats;
+	renderJob(mesh, job, options, nThreads, buffers, stats);
+	log << "Triangles rasterized: " << stats.trianglesBinned << " of " << stats.trianglesIn
+		<< " (" << stats.trianglesFacing << " facing culled, " << stats.trianglesDegenerate
+		<< " degenerate, " << stats.trianglesClipped << " clipped)" << endl;
+	if (stats.hizTilesCulled > 0 || stats.hizBlocksCulled > 0) {
+		log << "Hi-Z rejected: " << stats.hizTilesCulled << " triangle tiles, "
+			<< stats.hizBlocksCulled << " blocks" << endl;
 	}
 
 	//init frame buffer to (0,0,0)
@@ -543,13 +259,38 @@ int main(int argc, char **argv)
 
 
 
-	if (stbi_write_png(outputName.c_str(), imageWidth, imageHeight, 3, image.data(), imageWidth * 3)) {
-		cout << "Output written to " << outputName << "\n";
+	Stopwatch encodeTimer;
+	if (writeImage(outputName, format, imageWidth, imageHeight, 3, buffers.image.data(), imageWidth * 3, pngLevel, nThreads)) {
+		log << "Output written to " << outputName << "\n";
 	}
 	else {
 		cerr << "Failed to write output file " << outputName << "\n";
 		return 1;
 	}
 
+	if (!statsName.empty()) {
+		StatsReport report;
+		report.job = job;
+		report.options = options;
+		report.threads = buffers.rasterizer->getThreadCount();
+		report.corners = mesh.getIndexCount();
+		report.vertices = mesh.getVertexCount();
+		report.triangles = mesh.getTriangleCount();
+		report.load = loadStats;
+		report.raster = stats;
+		report.encode = encodeTimer.elapsed();
+		report.total = runTimer.elapsed();
+		if (statsName == "-") {
+			writeStatsJson(cout, report);
+		} else {
+			ofstream out(statsName.c_str());
+			writeStatsJson(out, report);
+			if (!out) {
+				cerr << "Failed to write stats file " << statsName << "\n";
+				return 1;
+			}
+		}
+	}
+
 	return 0;
 }
@@ -619,6 +619,24 @@ bool LoadObjWithCallback(std::istream &inStream, const callback_t &callback,
                          MaterialReader *readMatFn = NULL,
                          std::string *warn = NULL, std::string *err = NULL);
 
+/// Loads .obj from a file by memory mapping it and parsing line-aligned
+/// chunks of it on `num_threads` threads (0 = one per hardware thread).
+/// The per-thread results are merged with prefix sums over the element
+/// counts, so relative (negative) indices resolve exactly as in LoadObj.
+/// Only geometry is read: `v`, `vn`, `vt` and `f` lines, with `g` and `o`
+/// starting a new shape. Materials, vertex colors, lines, points and tags
+/// are ignored and every face gets material id -1. Polygons are split into
+/// triangle fans when 'triangulate' is set.
+/// Faces with fewer than three vertices, or with a vertex index that does
+/// not refer to a vertex defined before the face, are skipped (a polygon
+/// as a whole). Their number goes to `num_skipped_faces` if given, and
+/// warnings to `warn` otherwise.
+/// Returns false and sets `err` if the file cannot be read.
+bool LoadObjParallel(attrib_t *attrib, std::vector<shape_t> *shapes,
+                     std::string *warn, std::string *err, const char *filename,
+                     bool triangulate = true, int num_threads = 0,
+                     size_t *num_skipped_faces = NULL);
+
 /// Loads object from a std::istream, uses `readMatFn` to retrieve
 /// std::istream for materials.
 /// Returns true when loading .obj become success.
@@ -652,6 +670,7 @@ bool ParseTextureNameAndOption(std::string *texname, texture_option_t *texopt,
 #endif  // TINY_OBJ_LOADER_H_
 
 #ifdef TINYOBJLOADER_IMPLEMENTATION
+#include <algorithm>
 #include <cassert>
 #include <cctype>
 #include <cmath>
@@ -662,8 +681,26 @@ bool ParseTextureNameAndOption(std::string *texname, texture_option_t *texopt,
 #include <limits>
 #include <set>
 #include <sstream>
+#include <iterator>
+
+// std::from_chars for floating point (C++17, libstdc++ 11+, MSVC 2019+) is
+// the correctly rounded fallback of tryParseRealFast.
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#include <charconv>
+#if defined(__cpp_lib_to_chars)
+#define TINYOBJLOADER_HAS_FROM_CHARS
+#endif
+#endif
+#include <thread>
 #include <utility>
 
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #ifdef TINYOBJLOADER_USE_MAPBOX_EARCUT
 
 #ifdef TINYOBJLOADER_DONOT_INCLUDE_MAPBOX_EARCUT
@@ -1020,9 +1057,111 @@ fail:
   return false;
 }
 
+// Parses [s, s_end) straight into real_t, without going through double.
+// Plain decimals whose digits fit the mantissa of real_t and whose exponent
+// is small (nearly everything exporters write) take Clinger's fast path: one
+// exact integer to real_t conversion and one correctly rounded multiply or
+// divide by an exact power of ten. Other plain decimals go to
+// std::from_chars where it is available. Returns false on anything else
+// (inf, nan, hex, trailing junk) so that tryParseDouble still handles it as
+// before.
+static inline bool tryParseRealFast(const char *s, const char *s_end,
+                                    real_t *result) {
+  static const real_t pow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                 1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                 1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                 1e18, 1e19, 1e20, 1e21, 1e22};
+  // Largest integer and power of ten real_t holds exactly
+  const bool is_float = sizeof(real_t) == sizeof(float);
+  const unsigned long long max_mantissa =
+      is_float ? (1ull << 24) : (1ull << 53);
+  const int max_exponent = is_float ? 10 : 22;
+
+  const char *p = s;
+  bool negative = false;
+  if (p < s_end && (*p == '+' || *p == '-')) {
+    negative = (*p == '-');
+    p++;
+  }
+  unsigned long long mantissa = 0;
+  int digits = 0;  // significant digits in mantissa, at most 19
+  int exponent = 0;
+  bool any_digit = false, truncated = false;
+  for (; p < s_end && static_cast<unsigned>(*p - '0') < 10u; p++) {
+    any_digit = true;
+    if (digits < 19) {
+      mantissa = mantissa * 10 + static_cast<unsigned>(*p - '0');
+      digits += mantissa != 0;
+    } else {
+      truncated = true;
+    }
+  }
+  if (p < s_end && *p == '.') {
+    p++;
+    for (; p < s_end && static_cast<unsigned>(*p - '0') < 10u; p++) {
+      any_digit = true;
+      if (digits < 19) {
+        mantissa = mantissa * 10 + static_cast<unsigned>(*p - '0');
+        digits += mantissa != 0;
+        exponent--;
+      } else {
+        truncated = true;
+      }
+    }
+  }
+  if (!any_digit) {
+    return false;
+  }
+  if (p < s_end && (*p == 'e' || *p == 'E')) {
+    p++;
+    bool exp_negative = false;
+    if (p < s_end && (*p == '+' || *p == '-')) {
+      exp_negative = (*p == '-');
+      p++;
+    }
+    if (p == s_end || static_cast<unsigned>(*p - '0') >= 10u) {
+      return false;
+    }
+    int e = 0;
+    for (; p < s_end && static_cast<unsigned>(*p - '0') < 10u; p++) {
+      e = (std::min)(e * 10 + (*p - '0'), 100000);
+    }
+    exponent += exp_negative ? -e : e;
+  }
+  if (p != s_end) {
+    return false;
+  }
+
+  if (!truncated && mantissa <= max_mantissa && exponent >= -max_exponent &&
+      exponent <= max_exponent) {
+    real_t value = static_cast<real_t>(mantissa);
+    value = exponent < 0 ? value / pow10[-exponent] : value * pow10[exponent];
+    (*result) = negative ? -value : value;
+    return true;
+  }
+#ifdef TINYOBJLOADER_HAS_FROM_CHARS
+  // from_chars does not take a leading '+'
+  if (*s == '+') {
+    s++;
+  }
+  real_t value;
+  std::from_chars_result r = std::from_chars(s, s_end, value);
+  if (r.ec == std::errc() && r.ptr == s_end) {
+    (*result) = value;
+    return true;
+  }
+#endif
+  return false;
+}
+
 static inline real_t parseReal(const char **token, double default_value = 0.0) {
   (*token) += strspn((*token), " \t");
   const char *end = (*token) + strcspn((*token), " \t\r");
+  real_t fast;
+  if (tryParseRealFast((*token), end, &fast)) {
+    (*token) = end;
+    return fast;
+  }
   double val = default_value;
   tryParseDouble((*token), end, &val);
   real_t f = static_cast<real_t>(val);
@@ -1033,6 +1172,10 @@ static inline real_t parseReal(const char **token, double default_value = 0.0) {
 static inline bool parseReal(const char **token, real_t *out) {
   (*token) += strspn((*token), " \t");
   const char *end = (*token) + strcspn((*token), " \t\r");
+  if (tryParseRealFast((*token), end, out)) {
+    (*token) = end;
+    return true;
+  }
   double val;
   bool ret = tryParseDouble((*token), end, &val);
   if (ret) {
@@ -1158,6 +1301,28 @@ static tag_sizes parseTagTriple(const char **token) {
 }
 
 // Parse triples with index offsets: i, i/j/k, i//k, i/j
+// Reads the (optionally signed) decimal index at *token and leaves *token
+// on the '/', whitespace or end of line that follows it. Same value as atoi
+// for well formed input, without a generic strcspn scan per index.
+static inline int parseIndex(const char **token) {
+  const char *p = (*token);
+  bool negative = false;
+  if (*p == '-' || *p == '+') {
+    negative = (*p == '-');
+    p++;
+  }
+  int value = 0;
+  while (static_cast<unsigned>(*p - '0') < 10u) {
+    value = value * 10 + (*p - '0');
+    p++;
+  }
+  if (*p != '/' && !IS_SPACE(*p) && !IS_NEW_LINE(*p)) {
+    p += strcspn(p, "/ \t\r");  // junk after the digits
+  }
+  (*token) = p;
+  return negative ? -value : value;
+}
+
 static bool parseTriple(const char **token, int vsize, int vnsize, int vtsize,
                         vertex_index_t *ret, const warning_context &context) {
   if (!ret) {
@@ -1166,11 +1331,10 @@ static bool parseTriple(const char **token, int vsize, int vnsize, int vtsize,
 
   vertex_index_t vi(-1);
 
-  if (!fixIndex(atoi((*token)), vsize, &vi.v_idx, false, context)) {
+  if (!fixIndex(parseIndex(token), vsize, &vi.v_idx, false, context)) {
     return false;
   }
 
-  (*token) += strcspn((*token), "/ \t\r");
   if ((*token)[0] != '/') {
     (*ret) = vi;
     return true;
@@ -1180,20 +1344,18 @@ static bool parseTriple(const char **token, int vsize, int vnsize, int vtsize,
   // i//k
   if ((*token)[0] == '/') {
     (*token)++;
-    if (!fixIndex(atoi((*token)), vnsize, &vi.vn_idx, true, context)) {
+    if (!fixIndex(parseIndex(token), vnsize, &vi.vn_idx, true, context)) {
       return false;
     }
-    (*token) += strcspn((*token), "/ \t\r");
     (*ret) = vi;
     return true;
   }
 
   // i/j/k or i/j
-  if (!fixIndex(atoi((*token)), vtsize, &vi.vt_idx, true, context)) {
+  if (!fixIndex(parseIndex(token), vtsize, &vi.vt_idx, true, context)) {
     return false;
   }
 
-  (*token) += strcspn((*token), "/ \t\r");
   if ((*token)[0] != '/') {
     (*ret) = vi;
     return true;
@@ -1201,10 +1363,9 @@ static bool parseTriple(const char **token, int vsize, int vnsize, int vtsize,
 
   // i/j/k
   (*token)++;  // skip '/'
-  if (!fixIndex(atoi((*token)), vnsize, &vi.vn_idx, true, context)) {
+  if (!fixIndex(parseIndex(token), vnsize, &vi.vn_idx, true, context)) {
     return false;
   }
-  (*token) += strcspn((*token), "/ \t\r");
 
   (*ret) = vi;
 
@@ -1215,8 +1376,7 @@ static bool parseTriple(const char **token, int vsize, int vnsize, int vtsize,
 static vertex_index_t parseRawTriple(const char **token) {
   vertex_index_t vi(static_cast<int>(0));  // 0 is an invalid index in OBJ
 
-  vi.v_idx = atoi((*token));
-  (*token) += strcspn((*token), "/ \t\r");
+  vi.v_idx = parseIndex(token);
   if ((*token)[0] != '/') {
     return vi;
   }
@@ -1225,22 +1385,19 @@ static vertex_index_t parseRawTriple(const char **token) {
   // i//k
   if ((*token)[0] == '/') {
     (*token)++;
-    vi.vn_idx = atoi((*token));
-    (*token) += strcspn((*token), "/ \t\r");
+    vi.vn_idx = parseIndex(token);
     return vi;
   }
 
   // i/j/k or i/j
-  vi.vt_idx = atoi((*token));
-  (*token) += strcspn((*token), "/ \t\r");
+  vi.vt_idx = parseIndex(token);
   if ((*token)[0] != '/') {
     return vi;
   }
 
   // i/j/k
   (*token)++;  // skip '/'
-  vi.vn_idx = atoi((*token));
-  (*token) += strcspn((*token), "/ \t\r");
+  vi.vn_idx = parseIndex(token);
   return vi;
 }
 
@@ -3410,6 +3567,522 @@ bool LoadObjWithCallback(std::istream &inStream, const callback_t &callback,
   return true;
 }
 
+// Read-only view of a whole file. Memory mapped where mmap is available,
+// read into memory otherwise.
+class mapped_file_t {
+ public:
+  mapped_file_t() : data_(NULL), size_(0), mapped_(false) {}
+  ~mapped_file_t() {
+#if !defined(_WIN32)
+    if (mapped_) {
+      munmap(const_cast<char *>(data_), size_);
+    }
+#endif
+  }
+
+  bool open(const char *filename) {
+#if !defined(_WIN32)
+    int fd = ::open(filename, O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      close(fd);
+      return false;
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    if (size_ == 0) {
+      close(fd);
+      data_ = "";
+      return true;
+    }
+    void *p = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+      return false;
+    }
+    madvise(p, size_, MADV_SEQUENTIAL);
+    data_ = static_cast<const char *>(p);
+    mapped_ = true;
+    return true;
+#else
+    std::ifstream ifs(filename, std::ios::binary);
+    if (!ifs) {
+      return false;
+    }
+    buffer_.assign(std::istreambuf_iterator<char>(ifs),
+                   std::istreambuf_iterator<char>());
+    data_ = buffer_.empty() ? "" : &buffer_[0];
+    size_ = buffer_.size();
+    return true;
+#endif
+  }
+
+  const char *data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  mapped_file_t(const mapped_file_t &);
+  mapped_file_t &operator=(const mapped_file_t &);
+
+  const char *data_;
+  size_t size_;
+  bool mapped_;
+#if defined(_WIN32)
+  std::vector<char> buffer_;
+#endif
+};
+
+// Face corner as parsed from one chunk. An index whose bit (1, 2 and 4 for
+// v, vt and vn) is set in `relative` was negative in the file and is still
+// relative to the start of the chunk; the others are final (0-based, -1 =
+// missing). Bit 8 on the first corner of a face marks a fan triangle that
+// continues the polygon of the face before it.
+struct chunk_index_t {
+  int v_idx, vt_idx, vn_idx;
+  unsigned char relative;
+};
+
+// Element counts of a chunk when the faces from `face_offset` on were read.
+// A face may only refer to elements that come before it in the file.
+struct chunk_counts_t {
+  size_t face_offset;
+  size_t v, vn, vt;
+};
+
+// A `g` or `o` line: faces from `face_offset` on belong to a new shape.
+struct shape_start_t {
+  size_t face_offset;
+  std::string name;
+};
+
+struct obj_chunk_t {
+  std::vector<real_t> vertices;
+  std::vector<real_t> normals;
+  std::vector<real_t> texcoords;
+  std::vector<chunk_index_t> indices;
+  std::vector<unsigned char> num_face_vertices;
+  std::vector<shape_start_t> shape_starts;
+  std::vector<chunk_counts_t> counts;
+  size_t degenerate_faces;
+  // Set by the merge: faces dropped for an invalid vertex index (a polygon
+  // counts once), and the faces and indices that remain.
+  size_t invalid_faces;
+  size_t kept_faces;
+  size_t kept_indices;
+};
+
+static inline void encodeChunkIndex(int idx, size_t local_count, int *out,
+                                    unsigned char *relative,
+                                    unsigned char bit) {
+  if (idx > 0) {
+    (*out) = idx - 1;
+  } else if (idx < 0) {
+    (*out) = static_cast<int>(local_count) + idx;
+    (*relative) |= bit;
+  } else {
+    (*out) = -1;
+  }
+}
+
+static void parseObjChunk(const char *begin, const char *end, bool triangulate,
+                          obj_chunk_t *chunk) {
+  std::string linebuf;
+  std::vector<chunk_index_t> face;
+  chunk->degenerate_faces = 0;
+  const char *p = begin;
+  while (p < end) {
+    const char *eol =
+        static_cast<const char *>(memchr(p, '\n', static_cast<size_t>(end - p)));
+    const char *line_end = eol ? eol : end;
+    // Copy the line so the parsers below see it NUL terminated, as they do
+    // in LoadObj.
+    linebuf.assign(p, line_end);
+    p = eol ? eol + 1 : end;
+    if (!linebuf.empty() && linebuf[linebuf.size() - 1] == '\r') {
+      linebuf.erase(linebuf.size() - 1);
+    }
+
+    const char *token = linebuf.c_str();
+    token += strspn(token, " \t");
+    if (token[0] == '\0' || token[0] == '#') continue;
+
+    if (token[0] == 'v' && IS_SPACE((token[1]))) {
+      token += 2;
+      real_t x, y, z, r, g, b;
+      parseVertexWithColor(&x, &y, &z, &r, &g, &b, &token);
+      chunk->vertices.push_back(x);
+      chunk->vertices.push_back(y);
+      chunk->vertices.push_back(z);
+      continue;
+    }
+
+    if (token[0] == 'v' && token[1] == 'n' && IS_SPACE((token[2]))) {
+      token += 3;
+      real_t x, y, z;
+      parseReal3(&x, &y, &z, &token);
+      chunk->normals.push_back(x);
+      chunk->normals.push_back(y);
+      chunk->normals.push_back(z);
+      continue;
+    }
+
+    if (token[0] == 'v' && token[1] == 't' && IS_SPACE((token[2]))) {
+      token += 3;
+      real_t x, y;
+      parseReal2(&x, &y, &token);
+      chunk->texcoords.push_back(x);
+      chunk->texcoords.push_back(y);
+      continue;
+    }
+
+    if (token[0] == 'f' && IS_SPACE((token[1]))) {
+      token += 2;
+      token += strspn(token, " \t");
+      face.clear();
+      while (!IS_NEW_LINE(token[0])) {
+        vertex_index_t vi = parseRawTriple(&token);
+        chunk_index_t idx;
+        idx.relative = 0;
+        encodeChunkIndex(vi.v_idx, chunk->vertices.size() / 3, &idx.v_idx,
+                         &idx.relative, 1);
+        encodeChunkIndex(vi.vt_idx, chunk->texcoords.size() / 2, &idx.vt_idx,
+                         &idx.relative, 2);
+        encodeChunkIndex(vi.vn_idx, chunk->normals.size() / 3, &idx.vn_idx,
+                         &idx.relative, 4);
+        face.push_back(idx);
+        token += strspn(token, " \t\r");
+      }
+      if (face.empty()) continue;
+      if (face.size() < 3) {
+        chunk->degenerate_faces++;
+        continue;
+      }
+      size_t face_offset = chunk->num_face_vertices.size();
+      size_t v_count = chunk->vertices.size() / 3;
+      size_t vn_count = chunk->normals.size() / 3;
+      size_t vt_count = chunk->texcoords.size() / 2;
+      if (chunk->counts.empty() || chunk->counts.back().v != v_count ||
+          chunk->counts.back().vn != vn_count ||
+          chunk->counts.back().vt != vt_count) {
+        chunk_counts_t counts;
+        counts.face_offset = face_offset;
+        counts.v = v_count;
+        counts.vn = vn_count;
+        counts.vt = vt_count;
+        chunk->counts.push_back(counts);
+      }
+      if (triangulate) {
+        for (size_t k = 2; k < face.size(); k++) {
+          chunk_index_t first = face[0];
+          if (k > 2) {
+            first.relative |= 8;
+          }
+          chunk->indices.push_back(first);
+          chunk->indices.push_back(face[k - 1]);
+          chunk->indices.push_back(face[k]);
+          chunk->num_face_vertices.push_back(3);
+        }
+      } else if (face.size() <= 255) {
+        chunk->indices.insert(chunk->indices.end(), face.begin(), face.end());
+        chunk->num_face_vertices.push_back(
+            static_cast<unsigned char>(face.size()));
+      } else {
+        chunk->degenerate_faces++;
+      }
+      continue;
+    }
+
+    if ((token[0] == 'g' || token[0] == 'o') && IS_SPACE((token[1]))) {
+      token += 2;
+      token += strspn(token, " \t");
+      shape_start_t start;
+      start.face_offset = chunk->num_face_vertices.size();
+      start.name = token[0] == '\0' ? std::string() : parseString(&token);
+      chunk->shape_starts.push_back(start);
+      continue;
+    }
+
+    // Everything else (materials, smoothing groups, lines, ...) is ignored.
+  }
+}
+
+// Turns a chunk index into a final one given the element count of all
+// earlier chunks (`base`) and of the chunk up to the face (`seen`). Returns
+// false if it is out of range.
+static inline bool rebaseIndex(int idx, bool relative, size_t base,
+                               size_t seen, int *out) {
+  if (!relative && idx == -1) {
+    (*out) = -1;
+    return true;
+  }
+  long long i = relative ? static_cast<long long>(base) + idx
+                         : static_cast<long long>(idx);
+  if (i < 0 || i >= static_cast<long long>(base + seen)) {
+    return false;
+  }
+  (*out) = static_cast<int>(i);
+  return true;
+}
+
+bool LoadObjParallel(attrib_t *attrib, std::vector<shape_t> *shapes,
+                     std::string *warn, std::string *err, const char *filename,
+                     bool triangulate, int num_threads,
+                     size_t *num_skipped_faces) {
+  attrib->vertices.clear();
+  attrib->normals.clear();
+  attrib->texcoords.clear();
+  attrib->colors.clear();
+  shapes->clear();
+
+  mapped_file_t file;
+  if (!file.open(filename)) {
+    if (err) {
+      (*err) += "Cannot open file [" + std::string(filename) + "]\n";
+    }
+    return false;
+  }
+
+  if (num_threads <= 0) {
+    num_threads = static_cast<int>(std::thread::hardware_concurrency());
+  }
+  // Chunks below this size are not worth a thread.
+  const size_t min_chunk_bytes = 1 << 20;
+  size_t max_chunks = file.size() / min_chunk_bytes + 1;
+  size_t num_chunks = (std::max)(
+      static_cast<size_t>(1),
+      (std::min)(static_cast<size_t>(num_threads), max_chunks));
+
+  // Chunk boundaries, moved forward to the start of the next line.
+  const char *data = file.data();
+  std::vector<size_t> bounds(num_chunks + 1, file.size());
+  bounds[0] = 0;
+  for (size_t c = 1; c < num_chunks; c++) {
+    size_t pos = (std::max)(bounds[c - 1], file.size() / num_chunks * c);
+    const void *eol = pos < file.size()
+                          ? memchr(data + pos, '\n', file.size() - pos)
+                          : NULL;
+    bounds[c] = eol ? static_cast<size_t>(static_cast<const char *>(eol) -
+                                          data) + 1
+                    : file.size();
+  }
+
+  // Parse every chunk on its own thread. The first chunk runs on the
+  // calling thread.
+  std::vector<obj_chunk_t> chunks(num_chunks);
+  {
+    std::vector<std::thread> workers;
+    for (size_t c = 1; c < num_chunks; c++) {
+      workers.push_back(std::thread(parseObjChunk, data + bounds[c],
+                                    data + bounds[c + 1], triangulate,
+                                    &chunks[c]));
+    }
+    parseObjChunk(data + bounds[0], data + bounds[1], triangulate, &chunks[0]);
+    for (size_t i = 0; i < workers.size(); i++) {
+      workers[i].join();
+    }
+  }
+
+  // Prefix sums give every chunk its place in the merged arrays and the
+  // base its relative indices count from.
+  std::vector<size_t> v_base(num_chunks + 1, 0), vn_base(num_chunks + 1, 0),
+      vt_base(num_chunks + 1, 0), index_base(num_chunks + 1, 0),
+      face_base(num_chunks + 1, 0);
+  size_t degenerate_faces = 0;
+  for (size_t c = 0; c < num_chunks; c++) {
+    v_base[c + 1] = v_base[c] + chunks[c].vertices.size() / 3;
+    vn_base[c + 1] = vn_base[c] + chunks[c].normals.size() / 3;
+    vt_base[c + 1] = vt_base[c] + chunks[c].texcoords.size() / 2;
+    index_base[c + 1] = index_base[c] + chunks[c].indices.size();
+    face_base[c + 1] = face_base[c] + chunks[c].num_face_vertices.size();
+    degenerate_faces += chunks[c].degenerate_faces;
+  }
+
+  attrib->vertices.resize(3 * v_base[num_chunks]);
+  attrib->normals.resize(3 * vn_base[num_chunks]);
+  attrib->texcoords.resize(2 * vt_base[num_chunks]);
+  std::vector<index_t> indices(index_base[num_chunks]);
+  std::vector<unsigned char> num_face_vertices(face_base[num_chunks]);
+
+  // Copy and rebase in parallel, one chunk per thread again. A polygon with
+  // an invalid vertex index is dropped whole, and the faces after it move
+  // up within the chunk's part of the merged arrays.
+  {
+    struct merge_t {
+      static void run(obj_chunk_t *chunk, attrib_t *attrib,
+                      std::vector<index_t> *indices,
+                      std::vector<unsigned char> *num_face_vertices,
+                      size_t v_base, size_t vn_base, size_t vt_base,
+                      size_t index_base, size_t face_base) {
+        std::copy(chunk->vertices.begin(), chunk->vertices.end(),
+                  attrib->vertices.begin() + 3 * v_base);
+        std::copy(chunk->normals.begin(), chunk->normals.end(),
+                  attrib->normals.begin() + 3 * vn_base);
+        std::copy(chunk->texcoords.begin(), chunk->texcoords.end(),
+                  attrib->texcoords.begin() + 2 * vt_base);
+        const std::vector<unsigned char> &face_vertices =
+            chunk->num_face_vertices;
+        size_t face_count = face_vertices.size();
+        size_t in = 0, out = 0, kept = 0, counts = 0, starts = 0;
+        chunk->invalid_faces = 0;
+        for (size_t f = 0; f < face_count;) {
+          // The faces of one polygon: a face and the fan triangles after it.
+          size_t f_end = f + 1, in_end = in + face_vertices[f];
+          while (f_end < face_count &&
+                 (chunk->indices[in_end].relative & 8) != 0) {
+            in_end += face_vertices[f_end];
+            f_end++;
+          }
+          while (counts + 1 < chunk->counts.size() &&
+                 chunk->counts[counts + 1].face_offset <= f) {
+            counts++;
+          }
+          const chunk_counts_t &seen = chunk->counts[counts];
+          bool ok = true;
+          for (size_t i = in; i < in_end; i++) {
+            const chunk_index_t &idx = chunk->indices[i];
+            index_t &dst = (*indices)[index_base + out + (i - in)];
+            if (!rebaseIndex(idx.v_idx, (idx.relative & 1) != 0, v_base,
+                             seen.v, &dst.vertex_index) ||
+                dst.vertex_index < 0) {
+              ok = false;
+            }
+            if (!rebaseIndex(idx.vt_idx, (idx.relative & 2) != 0, vt_base,
+                             seen.vt, &dst.texcoord_index)) {
+              dst.texcoord_index = -1;
+            }
+            if (!rebaseIndex(idx.vn_idx, (idx.relative & 4) != 0, vn_base,
+                             seen.vn, &dst.normal_index)) {
+              dst.normal_index = -1;
+            }
+          }
+          // Shapes starting at this face now start at the next kept one.
+          while (starts < chunk->shape_starts.size() &&
+                 chunk->shape_starts[starts].face_offset <= f) {
+            chunk->shape_starts[starts++].face_offset = kept;
+          }
+          if (ok) {
+            std::copy(face_vertices.begin() + f, face_vertices.begin() + f_end,
+                      num_face_vertices->begin() + face_base + kept);
+            out += in_end - in;
+            kept += f_end - f;
+          } else {
+            chunk->invalid_faces++;
+          }
+          f = f_end;
+          in = in_end;
+        }
+        for (; starts < chunk->shape_starts.size(); starts++) {
+          chunk->shape_starts[starts].face_offset = kept;
+        }
+        chunk->kept_faces = kept;
+        chunk->kept_indices = out;
+        // Not needed any more
+        std::vector<chunk_index_t>().swap(chunk->indices);
+      }
+    };
+    std::vector<std::thread> workers;
+    for (size_t c = 1; c < num_chunks; c++) {
+      workers.push_back(std::thread(merge_t::run, &chunks[c], attrib,
+                                    &indices, &num_face_vertices, v_base[c],
+                                    vn_base[c], vt_base[c], index_base[c],
+                                    face_base[c]));
+    }
+    merge_t::run(&chunks[0], attrib, &indices, &num_face_vertices, v_base[0],
+                 vn_base[0], vt_base[0], index_base[0], face_base[0]);
+    for (size_t i = 0; i < workers.size(); i++) {
+      workers[i].join();
+    }
+  }
+
+  // Close the gaps the dropped faces left between the chunks.
+  size_t invalid_faces = 0;
+  for (size_t c = 0; c < num_chunks; c++) {
+    invalid_faces += chunks[c].invalid_faces;
+  }
+  if (invalid_faces > 0) {
+    size_t index_end = 0, face_end = 0;
+    for (size_t c = 0; c < num_chunks; c++) {
+      std::copy(indices.begin() + index_base[c],
+                indices.begin() + index_base[c] + chunks[c].kept_indices,
+                indices.begin() + index_end);
+      std::copy(num_face_vertices.begin() + face_base[c],
+                num_face_vertices.begin() + face_base[c] + chunks[c].kept_faces,
+                num_face_vertices.begin() + face_end);
+      index_base[c] = index_end;
+      face_base[c] = face_end;
+      index_end += chunks[c].kept_indices;
+      face_end += chunks[c].kept_faces;
+    }
+    index_base[num_chunks] = index_end;
+    face_base[num_chunks] = face_end;
+    indices.resize(index_end);
+    num_face_vertices.resize(face_end);
+  }
+  if (num_skipped_faces) {
+    (*num_skipped_faces) = degenerate_faces + invalid_faces;
+  } else if (warn) {
+    if (degenerate_faces > 0) {
+      (*warn) += "Degenerated face found\n.";
+    }
+    if (invalid_faces > 0) {
+      (*warn) += "Face with invalid vertex index found.\n";
+    }
+  }
+
+  // Split the faces into shapes at every `g`/`o` line that follows faces.
+  std::vector<shape_start_t> starts(1);
+  starts[0].face_offset = 0;
+  for (size_t c = 0; c < num_chunks; c++) {
+    for (size_t s = 0; s < chunks[c].shape_starts.size(); s++) {
+      shape_start_t start = chunks[c].shape_starts[s];
+      start.face_offset += face_base[c];
+      if (start.face_offset == starts.back().face_offset) {
+        starts.back().name = start.name;
+      } else {
+        starts.push_back(start);
+      }
+    }
+  }
+  size_t face_total = face_base[num_chunks];
+  if (starts.size() == 1) {
+    // The common case: hand over the merged arrays as they are.
+    shape_t shape;
+    shape.name = starts[0].name;
+    shape.mesh.indices.swap(indices);
+    shape.mesh.num_face_vertices.swap(num_face_vertices);
+    shape.mesh.material_ids.assign(face_total, -1);
+    shape.mesh.smoothing_group_ids.assign(face_total, 0);
+    if (face_total > 0) {
+      shapes->push_back(shape);
+    }
+    return true;
+  }
+  size_t index_offset = 0;
+  for (size_t s = 0; s < starts.size(); s++) {
+    size_t f0 = starts[s].face_offset;
+    size_t f1 = s + 1 < starts.size() ? starts[s + 1].face_offset : face_total;
+    size_t index_count = 0;
+    for (size_t f = f0; f < f1; f++) {
+      index_count += num_face_vertices[f];
+    }
+    if (f1 > f0) {
+      shape_t shape;
+      shape.name = starts[s].name;
+      shape.mesh.indices.assign(indices.begin() + index_offset,
+                                indices.begin() + index_offset + index_count);
+      shape.mesh.num_face_vertices.assign(num_face_vertices.begin() + f0,
+                                          num_face_vertices.begin() + f1);
+      shape.mesh.material_ids.assign(f1 - f0, -1);
+      shape.mesh.smoothing_group_ids.assign(f1 - f0, 0);
+      shapes->push_back(shape);
+    }
+    index_offset += index_count;
+  }
+  return true;
+}
+
 bool ObjReader::ParseFromFile(const std::string &filename,
                               const ObjReaderConfig &config) {
   std::string mtl_search_path;
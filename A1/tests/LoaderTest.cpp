@@ -0,0 +1,147 @@
+// Loads the same OBJ file, full of faces that have to be skipped, on the
+// streaming and on the parallel path (with one and with several chunks),
+// and checks that all of them give the same mesh and the same warning.
+//
+// Usage: A1_loadertest [scratch.obj]
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "Mesh.h"
+#include "MeshLoader.h"
+
+using namespace std;
+
+// Writes blocks of four vertices and a normal, each followed by good faces
+// and one kind of bad face. The file is a few MB so that the parallel path
+// splits it into several chunks, and relative indices cross the chunks.
+// Returns the number of faces the loaders have to skip.
+static size_t writeBadObj(const string &filename)
+{
+	ofstream out(filename.c_str());
+	const int blocks = 40000;
+	size_t bad = 0;
+	for(int b = 0; b < blocks; b++) {
+		int v = 4 * b + 1; // first vertex of the block
+		out << "v " << b << " 0 0\nv " << b << " 1 0\nv " << b + 1 << " 1 0\nv " << b + 1 << " 0 0\n";
+		out << "vn 0 0 " << (b % 2 ? 1 : -1) << "\n";
+		out << "f -4//-1 -3//-1 -2//-1\n";
+		out << "f " << v << " " << v + 2 << " " << v + 3 << "\n";
+		if(b % 50 == 0) {
+			out << "g block" << b << "\n";
+		}
+		switch(b % 8) {
+		case 0: // past the last vertex of the file
+			out << "f " << v << " " << v + 1 << " " << 4 * blocks + 1 << "\n";
+			bad++;
+			break;
+		case 1: // a vertex that only comes later
+			out << "f " << v << " " << v + 1 << " " << v + 4 << "\n";
+			bad++;
+			break;
+		case 2: // relative, before the first vertex
+			out << "f -1 -2 -" << v + 4 << "\n";
+			bad++;
+			break;
+		case 3: // index 0 stands for none
+			out << "f " << v << " 0 " << v + 2 << "\n";
+			bad++;
+			break;
+		case 4: // too few corners
+			out << "f " << v << " " << v + 1 << "\n";
+			bad++;
+			break;
+		case 5: // a quad with one bad corner goes as a whole
+			out << "f " << v << " " << v + 1 << " " << v + 2 << " " << 4 * blocks + 7 << "\n";
+			bad++;
+			break;
+		case 6: // a bad normal only costs the normal
+			out << "f " << v << "//9999999 " << v + 1 << "//-1 " << v + 2 << "//1\n";
+			break;
+		default: // a good quad from the previous block
+			if(b > 0) {
+				out << "f " << v - 4 << " " << v - 3 << " " << v + 1 << " " << v << "\n";
+			}
+			break;
+		}
+	}
+	return bad;
+}
+
+static bool sameArray(const float *a, const float *b, int n)
+{
+	for(int i = 0; i < n; i++) {
+		if(a[i] != b[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Compares the two meshes and warnings, and reports the first difference
+static bool sameMesh(const string &what, const Mesh &a, const string &warnA, const Mesh &b,
+	const string &warnB)
+{
+	int n = a.getVertexCount();
+	bool same = true;
+	if(warnA != warnB) {
+		cerr << what << ": warnings differ:\n" << warnA << "vs.\n" << warnB;
+		same = false;
+	}
+	if(n != b.getVertexCount() || a.getIndexCount() != b.getIndexCount()) {
+		cerr << what << ": " << n << " vertices and " << a.getIndexCount() << " indices vs. "
+			<< b.getVertexCount() << " and " << b.getIndexCount() << endl;
+		return false;
+	}
+	for(size_t i = 0; i < a.getIndexCount(); i++) {
+		if(a.getIndices()[i] != b.getIndices()[i]) {
+			cerr << what << ": index " << i << " differs" << endl;
+			return false;
+		}
+	}
+	if(!sameArray(a.getX(), b.getX(), n) || !sameArray(a.getY(), b.getY(), n)
+		|| !sameArray(a.getZ(), b.getZ(), n) || !sameArray(a.getNX(), b.getNX(), n)
+		|| !sameArray(a.getNY(), b.getNY(), n) || !sameArray(a.getNZ(), b.getNZ(), n)) {
+		cerr << what << ": vertices differ" << endl;
+		same = false;
+	}
+	return same;
+}
+
+int main(int argc, char **argv)
+{
+	string filename = argc > 1 ? argv[1] : "loadertest.obj";
+	size_t bad = writeBadObj(filename);
+
+	Mesh streamed;
+	string warn, err;
+	if(!loadObjFile(filename, streamed, warn, err, false)) {
+		cerr << "Streaming: " << err << endl;
+		remove(filename.c_str());
+		return 1;
+	}
+	bool ok = true;
+	string expected = "Skipped " + to_string(bad) + " faces with missing or invalid vertex indices\n";
+	if(warn != expected) {
+		cerr << "Streaming: expected the warning\n" << expected << "but got\n" << warn;
+		ok = false;
+	}
+	for(int threads : { 1, 4 }) {
+		Mesh parallel;
+		string parallelWarn, parallelErr;
+		string what = "Parallel on " + to_string(threads) + " threads";
+		if(!loadObjFile(filename, parallel, parallelWarn, parallelErr, true, threads)) {
+			cerr << what << ": " << parallelErr << endl;
+			ok = false;
+		} else if(!sameMesh(what, streamed, warn, parallel, parallelWarn)) {
+			ok = false;
+		}
+	}
+	remove(filename.c_str());
+	if(ok) {
+		cout << streamed.getTriangleCount() << " triangles, " << bad << " faces skipped on both paths" << endl;
+	}
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,67 @@
+// Writes a generated stress mesh (see MeshGenerator.h) as an OBJ file, and
+// with --cache also its .meshcache sidecar, so that A1 maps the binary mesh
+// instead of parsing the text. Both are only worth it to time the loader or
+// to hand the mesh to another program: A1 itself takes gen: names directly.
+//
+// Usage: A1_meshgen <sphere|grid|soup|stack> <triangles> <out.obj>
+//     [--seed N] [--size F] [--layers N] [--order far|near] [--cache]
+
+#include <iostream>
+#include <string>
+
+#include "Mesh.h"
+#include "MeshCache.h"
+#include "MeshGenerator.h"
+#include "MeshWriter.h"
+#include "Stopwatch.h"
+
+using namespace std;
+
+int main(int argc, char **argv)
+{
+	if(argc < 4) {
+		cerr << "Usage: A1_meshgen <sphere|grid|soup|stack> <triangles> <out.obj>"
+			<< " [--seed N] [--size F] [--layers N] [--order far|near] [--cache]" << endl;
+		return 1;
+	}
+	// The options become those of the equivalent gen: name
+	string name = string("gen:") + argv[1] + ":" + argv[2];
+	string outputName = argv[3];
+	bool cache = false;
+	for(int i = 4; i < argc; i++) {
+		string arg = argv[i];
+		if((arg == "--seed" || arg == "--size" || arg == "--layers" || arg == "--order") && i + 1 < argc) {
+			name += ":" + arg.substr(2) + "=" + argv[++i];
+		} else if(arg == "--cache") {
+			cache = true;
+		} else {
+			cerr << "Unknown option " << arg << endl;
+			return 1;
+		}
+	}
+
+	StressSpec spec;
+	string err;
+	Mesh mesh;
+	Stopwatch timer;
+	if(!parseStressMeshName(name, spec, err) || !generateStressMesh(spec, mesh, err)) {
+		cerr << err << endl;
+		return 1;
+	}
+	double generateMs = timer.lap().wallMs;
+	if(!writeObjMesh(outputName, mesh, err)) {
+		cerr << err << endl;
+		return 1;
+	}
+	double writeMs = timer.lap().wallMs;
+	cout << outputName << ": " << mesh.getTriangleCount() << " triangles, " << mesh.getVertexCount()
+		<< " vertices (generated in " << generateMs << " ms, written in " << writeMs << " ms)" << endl;
+	if(cache) {
+		if(!saveMeshCache(outputName, mesh)) {
+			cerr << "Failed to write the cache of " << outputName << endl;
+			return 1;
+		}
+		cout << outputName << ".meshcache written" << endl;
+	}
+	return 0;
+}
@@ -0,0 +1,221 @@
+#include "ObjBuffers.h"
+
+#include <algorithm>
+#include <fstream>
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "tiny_obj_loader.h"
+
+using namespace std;
+
+namespace {
+
+// Element counts of an OBJ file. Only used to size buffers, so lines the
+// scan misreads (leading whitespace, say) just cost a reallocation.
+struct ObjCounts {
+	size_t positions;
+	size_t normals;
+	size_t texcoords;
+	size_t corners; // triangle corners after splitting polygons into fans
+};
+
+void countObj(istream &in, ObjCounts &counts)
+{
+	counts = ObjCounts();
+	char buf[1 << 16];
+	size_t col = 0;
+	char c0 = 0, c1 = 0;
+	bool face = false, inToken = false;
+	size_t tokens = 0;
+	auto endLine = [&]() {
+		if(face && tokens >= 3) {
+			counts.corners += 3 * (tokens - 2);
+		}
+		col = 0;
+		face = inToken = false;
+		tokens = 0;
+	};
+	while(in) {
+		in.read(buf, sizeof(buf));
+		streamsize n = in.gcount();
+		for(streamsize i = 0; i < n; i++) {
+			char ch = buf[i];
+			if(ch == '\n') {
+				endLine();
+				continue;
+			}
+			bool space = ch == ' ' || ch == '\t' || ch == '\r';
+			if(col == 0) {
+				c0 = ch;
+			} else if(col == 1) {
+				c1 = ch;
+				if(c0 == 'v' && space) {
+					counts.positions++;
+				} else if(c0 == 'f' && space) {
+					face = true;
+				}
+			} else if(col == 2 && c0 == 'v' && space) {
+				if(c1 == 'n') {
+					counts.normals++;
+				} else if(c1 == 't') {
+					counts.texcoords++;
+				}
+			} else if(face) {
+				if(!space && !inToken) {
+					tokens++;
+				}
+				inToken = !space;
+			}
+			col++;
+		}
+	}
+	endLine();
+}
+
+// OBJ indices count from 1, negative ones from the end of the list so far,
+// and 0 means the index is missing. Returns -1 for missing or out of range.
+int resolveIndex(int index, size_t count)
+{
+	long long i = index > 0 ? index - 1 : (long long)count + index;
+	return (index != 0 && i >= 0 && i < (long long)count) ? (int)i : -1;
+}
+
+// Raw attribute lists of the file so far and the buffers being filled
+struct StreamState {
+	vector<float> positions;
+	vector<float> normals;
+	vector<float> texcoords;
+	vector<float> *posBuf;
+	vector<float> *norBuf; // NULL until the file has had a normal
+	vector<float> *texBuf; // NULL until the file has had a texture coord
+	vector<float> *norOut; // where norBuf and texBuf point once they are on
+	vector<float> *texOut;
+	size_t posStart; // size of posBuf before this file
+	size_t corners;  // expected corners of the file, to reserve for
+	size_t badFaces;
+};
+
+// Turns on a buffer once the file turns out to have its attribute, with
+// zeros for the corners emitted before. Whether a file has normals or
+// texture coords comes from the parser, not from the pre-scan.
+vector<float> *startBuffer(const StreamState &state, vector<float> *out, int width)
+{
+	size_t emitted = (state.posBuf->size() - state.posStart) / 3;
+	out->reserve(out->size() + width * max(state.corners, emitted));
+	out->resize(out->size() + width * emitted, 0.0f);
+	return out;
+}
+
+void vertexCallback(void *user, tinyobj::real_t x, tinyobj::real_t y, tinyobj::real_t z, tinyobj::real_t)
+{
+	vector<float> &p = static_cast<StreamState *>(user)->positions;
+	p.push_back(x);
+	p.push_back(y);
+	p.push_back(z);
+}
+
+void normalCallback(void *user, tinyobj::real_t x, tinyobj::real_t y, tinyobj::real_t z)
+{
+	StreamState &state = *static_cast<StreamState *>(user);
+	if(!state.norBuf) {
+		state.norBuf = startBuffer(state, state.norOut, 3);
+	}
+	vector<float> &n = state.normals;
+	n.push_back(x);
+	n.push_back(y);
+	n.push_back(z);
+}
+
+void texcoordCallback(void *user, tinyobj::real_t x, tinyobj::real_t y, tinyobj::real_t)
+{
+	StreamState &state = *static_cast<StreamState *>(user);
+	if(!state.texBuf) {
+		state.texBuf = startBuffer(state, state.texOut, 2);
+	}
+	vector<float> &t = state.texcoords;
+	t.push_back(x);
+	t.push_back(y);
+}
+
+// Appends one corner to the buffers. Missing normals and texture coords
+// are written as zeros so that the buffers stay in step.
+void addCorner(StreamState &state, const tinyobj::index_t &idx)
+{
+	int v = resolveIndex(idx.vertex_index, state.positions.size() / 3);
+	state.posBuf->push_back(state.positions[3*v + 0]);
+	state.posBuf->push_back(state.positions[3*v + 1]);
+	state.posBuf->push_back(state.positions[3*v + 2]);
+	if(state.norBuf) {
+		int n = resolveIndex(idx.normal_index, state.normals.size() / 3);
+		state.norBuf->push_back(n < 0 ? 0.0f : state.normals[3*n + 0]);
+		state.norBuf->push_back(n < 0 ? 0.0f : state.normals[3*n + 1]);
+		state.norBuf->push_back(n < 0 ? 0.0f : state.normals[3*n + 2]);
+	}
+	if(state.texBuf) {
+		int t = resolveIndex(idx.texcoord_index, state.texcoords.size() / 2);
+		state.texBuf->push_back(t < 0 ? 0.0f : state.texcoords[2*t + 0]);
+		state.texBuf->push_back(t < 0 ? 0.0f : state.texcoords[2*t + 1]);
+	}
+}
+
+void indexCallback(void *user, tinyobj::index_t *indices, int count)
+{
+	StreamState &state = *static_cast<StreamState *>(user);
+	bool valid = count >= 3;
+	for(int k = 0; k < count && valid; k++) {
+		valid = resolveIndex(indices[k].vertex_index, state.positions.size() / 3) >= 0;
+	}
+	if(!valid) {
+		state.badFaces++;
+		return;
+	}
+	// Split polygons into a fan around the first corner
+	for(int k = 2; k < count; k++) {
+		addCorner(state, indices[0]);
+		addCorner(state, indices[k - 1]);
+		addCorner(state, indices[k]);
+	}
+}
+
+}
+
+bool loadObjBuffers(const string &meshName, vector<float> &posBuf, vector<float> &norBuf,
+	vector<float> &texBuf, string &warn, string &err)
+{
+	ifstream in(meshName.c_str(), ios::binary);
+	if(!in) {
+		err = "Cannot open file [" + meshName + "]";
+		return false;
+	}
+	// A quick count of the file first sizes every buffer once so nothing
+	// gets reallocated while parsing.
+	ObjCounts counts;
+	countObj(in, counts);
+	in.clear();
+	in.seekg(0);
+
+	StreamState state;
+	state.positions.reserve(3 * counts.positions);
+	state.normals.reserve(3 * counts.normals);
+	state.texcoords.reserve(2 * counts.texcoords);
+	state.posBuf = &posBuf;
+	state.norBuf = NULL;
+	state.texBuf = NULL;
+	state.norOut = &norBuf;
+	state.texOut = &texBuf;
+	state.posStart = posBuf.size();
+	state.corners = counts.corners;
+	state.badFaces = 0;
+	posBuf.reserve(posBuf.size() + 3 * counts.corners);
+
+	tinyobj::callback_t callback;
+	callback.vertex_cb = vertexCallback;
+	callback.normal_cb = normalCallback;
+	callback.texcoord_cb = texcoordCallback;
+	callback.index_cb = indexCallback;
+	bool rc = tinyobj::LoadObjWithCallback(in, callback, &state, NULL, &warn, &err);
+	if(state.badFaces > 0) {
+		warn += "Skipped " + to_string(state.badFaces) + " faces with missing or invalid vertex indices\n";
+	}
+	return rc;
+}
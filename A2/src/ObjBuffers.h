@@ -0,0 +1,18 @@
+#pragma once
+#ifndef OBJBUFFERS_H
+#define OBJBUFFERS_H
+
+#include <string>
+#include <vector>
+
+// Streams an OBJ file straight onto the ends of posBuf, norBuf and texBuf,
+// three corners per triangle, with polygons split into fans. The faces are
+// de-indexed as they are parsed, so only the raw attribute lists are kept
+// around. norBuf and texBuf only grow if the file has normals and texture
+// coords at all; corners without one get zeros. Returns false and sets err
+// if the file cannot be read; warnings (faces skipped for bad indices, ...)
+// go to warn.
+bool loadObjBuffers(const std::string &meshName, std::vector<float> &posBuf,
+	std::vector<float> &norBuf, std::vector<float> &texBuf, std::string &warn, std::string &err);
+
+#endif
@@ -1,12 +1,14 @@
 #include "Shape.h"
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 
 #include "GLSL.h"
+#include "ObjBuffers.h"
 #include "Program.h"
 
-#define TINYOBJLOADER_IMPLEMENTATION
-#include "tiny_obj_loader.h"
-
 using namespace std;
 
 Shape::Shape() :
@@ -20,49 +22,147 @@ Shape::~Shape()
 {
 }
 
+namespace {
+
+// Sidecar cache of the buffers loadMesh builds from an OBJ file, stored as
+// <file>.shapecache: a header followed by posBuf, norBuf and texBuf as raw
+// floats. It only counts for the same source path, byte order, file size and
+// modification time.
+const char SHAPE_CACHE_MAGIC[8] = { 'S', 'H', 'A', 'P', 'E', 'B', 'U', 'F' };
+const uint32_t SHAPE_CACHE_VERSION = 2;
+const uint32_t SHAPE_CACHE_BYTE_ORDER = 0x01020304;
+
+struct ShapeCacheHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t byteOrder;
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	uint64_t pathHash;
+	uint64_t counts[3]; // floats in posBuf, norBuf, texBuf
+};
+
+// Everything in the header that depends on the source file
+bool shapeCacheKey(const string &meshName, ShapeCacheHeader &header)
+{
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, SHAPE_CACHE_MAGIC, sizeof(SHAPE_CACHE_MAGIC));
+	header.version = SHAPE_CACHE_VERSION;
+	header.byteOrder = SHAPE_CACHE_BYTE_ORDER;
+	error_code ec;
+	header.sourceSize = filesystem::file_size(meshName, ec);
+	if(ec) {
+		return false;
+	}
+	auto time = filesystem::last_write_time(meshName, ec);
+	if(ec) {
+		return false;
+	}
+	header.sourceTime = (int64_t)time.time_since_epoch().count();
+	string path = filesystem::absolute(meshName, ec).lexically_normal().string();
+	header.pathHash = 14695981039346656037ull;
+	for(char c : ec ? meshName : path) {
+		header.pathHash = (header.pathHash ^ (unsigned char)c) * 1099511628211ull;
+	}
+	return true;
+}
+
+// Appends the cached buffers of meshName. Returns false on a missing, stale
+// or damaged cache, leaving the buffers as they were.
+bool readShapeCache(const string &meshName, vector<float> *bufs[3])
+{
+	ShapeCacheHeader key, header;
+	if(!shapeCacheKey(meshName, key)) {
+		return false;
+	}
+	ifstream in((meshName + ".shapecache").c_str(), ios::binary | ios::ate);
+	if(!in) {
+		return false;
+	}
+	uint64_t fileSize = (uint64_t)in.tellg();
+	in.seekg(0);
+	if(!in.read(reinterpret_cast<char *>(&header), sizeof(header))) {
+		return false;
+	}
+	memcpy(key.counts, header.counts, sizeof(key.counts));
+	if(memcmp(&key, &header, sizeof(header)) != 0 ||
+		header.counts[0] > fileSize / sizeof(float) ||
+		header.counts[1] > fileSize / sizeof(float) ||
+		header.counts[2] > fileSize / sizeof(float) ||
+		sizeof(header) + (header.counts[0] + header.counts[1] + header.counts[2]) * sizeof(float) != fileSize) {
+		return false;
+	}
+	size_t old[3];
+	for(int k = 0; k < 3; k++) {
+		old[k] = bufs[k]->size();
+		bufs[k]->resize(old[k] + header.counts[k]);
+		in.read(reinterpret_cast<char *>(bufs[k]->data() + old[k]), header.counts[k] * sizeof(float));
+	}
+	if(!in) {
+		for(int k = 0; k < 3; k++) {
+			bufs[k]->resize(old[k]);
+		}
+		return false;
+	}
+	return true;
+}
+
+// Writes the buffers from the given offsets on as the cache of meshName,
+// under a temporary name first so a reader never sees half a file. Failure
+// is harmless: the next load just parses the OBJ again.
+void writeShapeCache(const string &meshName, vector<float> *bufs[3], const size_t start[3])
+{
+	ShapeCacheHeader header;
+	if(!shapeCacheKey(meshName, header)) {
+		return;
+	}
+	for(int k = 0; k < 3; k++) {
+		header.counts[k] = bufs[k]->size() - start[k];
+	}
+	string name = meshName + ".shapecache";
+	string tmpName = name + ".tmp";
+	error_code ec;
+	{
+		ofstream out(tmpName.c_str(), ios::binary | ios::trunc);
+		if(!out) {
+			return;
+		}
+		out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		for(int k = 0; k < 3; k++) {
+			out.write(reinterpret_cast<const char *>(bufs[k]->data() + start[k]), header.counts[k] * sizeof(float));
+		}
+		if(!out) {
+			out.close();
+			filesystem::remove(tmpName, ec);
+			return;
+		}
+	}
+	filesystem::rename(tmpName, name, ec);
+	if(ec) {
+		filesystem::remove(tmpName, ec);
+	}
+}
+
+}
+
 void Shape::loadMesh(const string &meshName)
 {
-	// Load geometry
-	tinyobj::attrib_t attrib;
-	std::vector<tinyobj::shape_t> shapes;
-	std::vector<tinyobj::material_t> materials;
+	// A valid sidecar cache holds exactly the buffers parsing would build
+	vector<float> *bufs[3] = { &posBuf, &norBuf, &texBuf };
+	if(readShapeCache(meshName, bufs)) {
+		return;
+	}
+	size_t start[3] = { posBuf.size(), norBuf.size(), texBuf.size() };
 	string warnStr, errStr;
-	bool rc = tinyobj::LoadObj(&attrib, &shapes, &materials, &warnStr, &errStr, meshName.c_str());
+	bool rc = loadObjBuffers(meshName, posBuf, norBuf, texBuf, warnStr, errStr);
 	if(!rc) {
 		cerr << errStr << endl;
-	} else {
-		// Some OBJ files have different indices for vertex positions, normals,
-		// and texture coordinates. For example, a cube corner vertex may have
-		// three different normals. Here, we are going to duplicate all such
-		// vertices.
-		// Loop over shapes
-		for(size_t s = 0; s < shapes.size(); s++) {
-			// Loop over faces (polygons)
-			size_t index_offset = 0;
-			for(size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++) {
-				size_t fv = shapes[s].mesh.num_face_vertices[f];
-				// Loop over vertices in the face.
-				for(size_t v = 0; v < fv; v++) {
-					// access to vertex
-					tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
-					posBuf.push_back(attrib.vertices[3*idx.vertex_index+0]);
-					posBuf.push_back(attrib.vertices[3*idx.vertex_index+1]);
-					posBuf.push_back(attrib.vertices[3*idx.vertex_index+2]);
-					if(!attrib.normals.empty()) {
-						norBuf.push_back(attrib.normals[3*idx.normal_index+0]);
-						norBuf.push_back(attrib.normals[3*idx.normal_index+1]);
-						norBuf.push_back(attrib.normals[3*idx.normal_index+2]);
-					}
-					if(!attrib.texcoords.empty()) {
-						texBuf.push_back(attrib.texcoords[2*idx.texcoord_index+0]);
-						texBuf.push_back(attrib.texcoords[2*idx.texcoord_index+1]);
-					}
-				}
-				index_offset += fv;
-				// per-face material (IGNORE)
-				shapes[s].mesh.material_ids[f];
-			}
-		}
+	}
+	if(!warnStr.empty()) {
+		cerr << warnStr;
+	}
+	if(rc) {
+		writeShapeCache(meshName, bufs, start);
 	}
 }
 
@@ -0,0 +1,86 @@
+// Checks that loadObjBuffers emits normals and texture coords whenever the
+// parser sees them: on indented vn/vt lines the pre-scan misses, on ones
+// that only come after the first faces, and not at all for a file without.
+//
+// Usage: <project>_objtest [scratch.obj]
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "ObjBuffers.h"
+
+using namespace std;
+
+struct Buffers {
+	vector<float> pos, nor, tex;
+};
+
+static bool load(const string &filename, const string &obj, Buffers &b)
+{
+	{
+		ofstream out(filename.c_str(), ios::binary);
+		out << obj;
+	}
+	string warn, err;
+	bool rc = loadObjBuffers(filename, b.pos, b.nor, b.tex, warn, err);
+	remove(filename.c_str());
+	if(!rc) {
+		cerr << err << endl;
+	}
+	return rc;
+}
+
+static bool expect(const string &what, const vector<float> &got, const vector<float> &want)
+{
+	if(got == want) {
+		return true;
+	}
+	cerr << what << ": got " << got.size() << " floats {";
+	for(float f : got) {
+		cerr << " " << f;
+	}
+	cerr << " }, expected " << want.size() << endl;
+	return false;
+}
+
+int main(int argc, char **argv)
+{
+	string filename = argc > 1 ? argv[1] : "objtest.obj";
+	bool ok = true;
+
+	// Leading spaces and tabs, as tinyobj accepts them
+	Buffers indented;
+	ok = load(filename,
+		"v 0 0 0\nv 1 0 0\nv 0 1 0\n"
+		"  vn 0 0 1\n\tvt 0.5 0.25\n"
+		"f 1/1/1 2/1/1 3/1/1\n", indented) && ok;
+	ok = expect("indented positions", indented.pos, { 0, 0, 0, 1, 0, 0, 0, 1, 0 }) && ok;
+	ok = expect("indented normals", indented.nor, { 0, 0, 1, 0, 0, 1, 0, 0, 1 }) && ok;
+	ok = expect("indented texcoords", indented.tex, { 0.5f, 0.25f, 0.5f, 0.25f, 0.5f, 0.25f }) && ok;
+
+	// The first normal and texture coord after a face: the face before
+	// gets zeros, so the buffers stay in step with posBuf
+	Buffers late;
+	ok = load(filename,
+		"v 0 0 0\nv 1 0 0\nv 0 1 0\n"
+		"f 1 2 3\n"
+		" vn 0 1 0\n vt 1 1\n"
+		"f 1/1/1 2/1/1 3/1/1\n", late) && ok;
+	ok = expect("late normals", late.nor, { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0 }) && ok;
+	ok = expect("late texcoords", late.tex, { 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1 }) && ok;
+
+	// Neither at all
+	Buffers plain;
+	ok = load(filename, "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n", plain) && ok;
+	ok = expect("plain positions", plain.pos, { 0, 0, 0, 1, 0, 0, 0, 1, 0 }) && ok;
+	ok = expect("plain normals", plain.nor, {}) && ok;
+	ok = expect("plain texcoords", plain.tex, {}) && ok;
+
+	if(ok) {
+		cout << "Normals and texture coords follow the parser" << endl;
+	}
+	return ok ? 0 : 1;
+}
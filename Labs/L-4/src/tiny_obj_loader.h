@@ -662,6 +662,14 @@ bool ParseTextureNameAndOption(std::string *texname, texture_option_t *texopt,
 #include <limits>
 #include <set>
 #include <sstream>
+// std::from_chars for floating point (C++17, libstdc++ 11+, MSVC 2019+) is
+// the correctly rounded fallback of tryParseRealFast.
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#include <charconv>
+#if defined(__cpp_lib_to_chars)
+#define TINYOBJLOADER_HAS_FROM_CHARS
+#endif
+#endif
 #include <utility>
 
 #ifdef TINYOBJLOADER_USE_MAPBOX_EARCUT
@@ -1020,9 +1028,111 @@ fail:
   return false;
 }
 
+// Parses [s, s_end) straight into real_t, without going through double.
+// Plain decimals whose digits fit the mantissa of real_t and whose exponent
+// is small (nearly everything exporters write) take Clinger's fast path: one
+// exact integer to real_t conversion and one correctly rounded multiply or
+// divide by an exact power of ten. Other plain decimals go to
+// std::from_chars where it is available. Returns false on anything else
+// (inf, nan, hex, trailing junk) so that tryParseDouble still handles it as
+// before.
+static inline bool tryParseRealFast(const char *s, const char *s_end,
+                                    real_t *result) {
+  static const real_t pow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                 1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                 1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                 1e18, 1e19, 1e20, 1e21, 1e22};
+  // Largest integer and power of ten real_t holds exactly
+  const bool is_float = sizeof(real_t) == sizeof(float);
+  const unsigned long long max_mantissa =
+      is_float ? (1ull << 24) : (1ull << 53);
+  const int max_exponent = is_float ? 10 : 22;
+
+  const char *p = s;
+  bool negative = false;
+  if (p < s_end && (*p == '+' || *p == '-')) {
+    negative = (*p == '-');
+    p++;
+  }
+  unsigned long long mantissa = 0;
+  int digits = 0;  // significant digits in mantissa, at most 19
+  int exponent = 0;
+  bool any_digit = false, truncated = false;
+  for (; p < s_end && static_cast<unsigned>(*p - '0') < 10u; p++) {
+    any_digit = true;
+    if (digits < 19) {
+      mantissa = mantissa * 10 + static_cast<unsigned>(*p - '0');
+      digits += mantissa != 0;
+    } else {
+      truncated = true;
+    }
+  }
+  if (p < s_end && *p == '.') {
+    p++;
+    for (; p < s_end && static_cast<unsigned>(*p - '0') < 10u; p++) {
+      any_digit = true;
+      if (digits < 19) {
+        mantissa = mantissa * 10 + static_cast<unsigned>(*p - '0');
+        digits += mantissa != 0;
+        exponent--;
+      } else {
+        truncated = true;
+      }
+    }
+  }
+  if (!any_digit) {
+    return false;
+  }
+  if (p < s_end && (*p == 'e' || *p == 'E')) {
+    p++;
+    bool exp_negative = false;
+    if (p < s_end && (*p == '+' || *p == '-')) {
+      exp_negative = (*p == '-');
+      p++;
+    }
+    if (p == s_end || static_cast<unsigned>(*p - '0') >= 10u) {
+      return false;
+    }
+    int e = 0;
+    for (; p < s_end && static_cast<unsigned>(*p - '0') < 10u; p++) {
+      e = (std::min)(e * 10 + (*p - '0'), 100000);
+    }
+    exponent += exp_negative ? -e : e;
+  }
+  if (p != s_end) {
+    return false;
+  }
+
+  if (!truncated && mantissa <= max_mantissa && exponent >= -max_exponent &&
+      exponent <= max_exponent) {
+    real_t value = static_cast<real_t>(mantissa);
+    value = exponent < 0 ? value / pow10[-exponent] : value * pow10[exponent];
+    (*result) = negative ? -value : value;
+    return true;
+  }
+#ifdef TINYOBJLOADER_HAS_FROM_CHARS
+  // from_chars does not take a leading '+'
+  if (*s == '+') {
+    s++;
+  }
+  real_t value;
+  std::from_chars_result r = std::from_chars(s, s_end, value);
+  if (r.ec == std::errc() && r.ptr == s_end) {
+    (*result) = value;
+    return true;
+  }
+#endif
+  return false;
+}
+
 static inline real_t parseReal(const char **token, double default_value = 0.0) {
   (*token) += strspn((*token), " \t");
   const char *end = (*token) + strcspn((*token), " \t\r");
+  real_t fast;
+  if (tryParseRealFast((*token), end, &fast)) {
+    (*token) = end;
+    return fast;
+  }
   double val = default_value;
   tryParseDouble((*token), end, &val);
   real_t f = static_cast<real_t>(val);
@@ -1033,6 +1143,10 @@ static inline real_t parseReal(const char **token, double default_value = 0.0) {
 static inline bool parseReal(const char **token, real_t *out) {
   (*token) += strspn((*token), " \t");
   const char *end = (*token) + strcspn((*token), " \t\r");
+  if (tryParseRealFast((*token), end, out)) {
+    (*token) = end;
+    return true;
+  }
   double val;
   bool ret = tryParseDouble((*token), end, &val);
   if (ret) {
@@ -1158,6 +1272,28 @@ static tag_sizes parseTagTriple(const char **token) {
 }
 
 // Parse triples with index offsets: i, i/j/k, i//k, i/j
+// Reads the (optionally signed) decimal index at *token and leaves *token
+// on the '/', whitespace or end of line that follows it. Same value as atoi
+// for well formed input, without a generic strcspn scan per index.
+static inline int parseIndex(const char **token) {
+  const char *p = (*token);
+  bool negative = false;
+  if (*p == '-' || *p == '+') {
+    negative = (*p == '-');
+    p++;
+  }
+  int value = 0;
+  while (static_cast<unsigned>(*p - '0') < 10u) {
+    value = value * 10 + (*p - '0');
+    p++;
+  }
+  if (*p != '/' && !IS_SPACE(*p) && !IS_NEW_LINE(*p)) {
+    p += strcspn(p, "/ \t\r");  // junk after the digits
+  }
+  (*token) = p;
+  return negative ? -value : value;
+}
+
 static bool parseTriple(const char **token, int vsize, int vnsize, int vtsize,
                         vertex_index_t *ret, const warning_context &context) {
   if (!ret) {
@@ -1166,11 +1302,10 @@ static bool parseTriple(const char **token, int vsize, int vnsize, int vtsize,
 
   vertex_index_t vi(-1);
 
-  if (!fixIndex(atoi((*token)), vsize, &vi.v_idx, false, context)) {
+  if (!fixIndex(parseIndex(token), vsize, &vi.v_idx, false, context)) {
     return false;
   }
 
-  (*token) += strcspn((*token), "/ \t\r");
   if ((*token)[0] != '/') {
     (*ret) = vi;
     return true;
@@ -1180,20 +1315,18 @@ static bool parseTriple(const char **token, int vsize, int vnsize, int vtsize,
   // i//k
   if ((*token)[0] == '/') {
     (*token)++;
-    if (!fixIndex(atoi((*token)), vnsize, &vi.vn_idx, true, context)) {
+    if (!fixIndex(parseIndex(token), vnsize, &vi.vn_idx, true, context)) {
       return false;
     }
-    (*token) += strcspn((*token), "/ \t\r");
     (*ret) = vi;
     return true;
   }
 
   // i/j/k or i/j
-  if (!fixIndex(atoi((*token)), vtsize, &vi.vt_idx, true, context)) {
+  if (!fixIndex(parseIndex(token), vtsize, &vi.vt_idx, true, context)) {
     return false;
   }
 
-  (*token) += strcspn((*token), "/ \t\r");
   if ((*token)[0] != '/') {
     (*ret) = vi;
     return true;
@@ -1201,10 +1334,9 @@ static bool parseTriple(const char **token, int vsize, int vnsize, int vtsize,
 
   // i/j/k
   (*token)++;  // skip '/'
-  if (!fixIndex(atoi((*token)), vnsize, &vi.vn_idx, true, context)) {
+  if (!fixIndex(parseIndex(token), vnsize, &vi.vn_idx, true, context)) {
     return false;
   }
-  (*token) += strcspn((*token), "/ \t\r");
 
   (*ret) = vi;
 
@@ -1215,8 +1347,7 @@ static bool parseTriple(const char **token, int vsize, int vnsize, int vtsize,
 static vertex_index_t parseRawTriple(const char **token) {
   vertex_index_t vi(static_cast<int>(0));  // 0 is an invalid index in OBJ
 
-  vi.v_idx = atoi((*token));
-  (*token) += strcspn((*token), "/ \t\r");
+  vi.v_idx = parseIndex(token);
   if ((*token)[0] != '/') {
     return vi;
   }
@@ -1225,22 +1356,19 @@ static vertex_index_t parseRawTriple(const char **token) {
   // i//k
   if ((*token)[0] == '/') {
     (*token)++;
-    vi.vn_idx = atoi((*token));
-    (*token) += strcspn((*token), "/ \t\r");
+    vi.vn_idx = parseIndex(token);
     return vi;
   }
 
   // i/j/k or i/j
-  vi.vt_idx = atoi((*token));
-  (*token) += strcspn((*token), "/ \t\r");
+  vi.vt_idx = parseIndex(token);
   if ((*token)[0] != '/') {
     return vi;
   }
 
   // i/j/k
   (*token)++;  // skip '/'
-  vi.vn_idx = atoi((*token));
-  (*token) += strcspn((*token), "/ \t\r");
+  vi.vn_idx = parseIndex(token);
   return vi;
 }
 